@@ -0,0 +1,54 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Multi-rate partition of the generated BLDC controller (BLDC_MULTIRATE in config.h), see
+ * BLDC_controller_mr.c. The PWM interrupt runs BLDC_controller_step_fast(), PendSV runs
+ * BLDC_controller_step_slow() when the fast step returned 1.
+ */
+
+// Define to prevent recursive inclusion
+#ifndef BLDC_CONTROLLER_MR_H
+#define BLDC_CONTROLLER_MR_H
+
+#include "BLDC_controller.h"
+
+// SlowPart.z_state
+#define SLOW_IDLE                      0U
+#define SLOW_PENDING                   1U
+#define SLOW_DONE                      2U
+
+typedef struct {
+  DW dw;                               /* states of the slow partition */
+  ExtU u;                              /* inputs latched by the fast step */
+  ExtY y;                              /* z_errCode */
+  int16_T Switch2;                     /* '<S13>/Switch2' (n_mot in fixdt(1,16,4)) latched */
+  int16_T Abs5;                        /* '<S13>/Abs5' latched */
+  int16_T DataTypeConversion2;         /* '<S1>/Data Type Conversion2' latched */
+  uint8_T Sum;                         /* '<S11>/Sum' latched */
+  uint8_T z_div;                       /* slot 1 periods per slow run */
+  uint8_T z_cnt;
+  uint8_T z_state;                     /* SLOW_IDLE, SLOW_PENDING, SLOW_DONE */
+  boolean_T b_spdAct;                  /* speed PI ran, its output is committed */
+  uint16_T n_skip;                     /* latches dropped, slow run not finished in time */
+} SlowPart;
+
+boolean_T BLDC_controller_step_fast(RT_MODEL *const rtM, SlowPart *sp);
+void      BLDC_controller_step_slow(RT_MODEL *const rtM, SlowPart *sp);
+void      BLDC_controller_slow_init(RT_MODEL *const rtM, SlowPart *sp, uint8_T z_div);
+
+#endif // BLDC_CONTROLLER_MR_H
@@ -0,0 +1,95 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Build-time specialisation of the generated BLDC controller (BLDC_SPECIALISE in config.h).
+ * BLDC_controller.c reads the selector parameters below through these macros. By default
+ * they read rtP as generated. With BLDC_SPECIALISE they are replaced by the values that
+ * BLDC_Init() would load from config.h, so the compiler removes the unused control types
+ * (COM / SIN with FOC and vice versa) and the disabled features from the step function.
+ * Parameters that are changed at runtime stay runtime reads:
+ *   b_cruiseCtrlEna with the standstill hold (see standstillHold() in util.c)
+ * The control mode is an input (rtU->z_ctrlModReq) and stays a runtime selection: OPEN
+ * mode is the timeout reaction and protocol v2 can request any mode.
+ * The register map makes fwEna (b_fieldWeakEna) read only in this build.
+ * The degraded mode diagnostics (ISR_DEGRADE_DIAG) do not touch rtP: the PWM interrupt sets
+ * bldcDiagDiv for the step, read by BLDC_P_DIAG_ENA and BLDC_P_ERR_QUAL / BLDC_P_ERR_DEQUAL.
+ * Measured on the host (hover_replay / hover_replay_spec -r vec.bin -n 50, FOC): the step
+ * text shrinks from 8544 to 7738 bytes, the step time by 2 .. 3 %, about the size of the
+ * run-to-run noise. There is no on-target figure: compare PROF_LEFT / PROF_RIGHT.
+ * Bit-exact check against the generic step: 'make sil', then build/sil/hover_replay -?
+ */
+
+// Define to prevent recursive inclusion
+#ifndef BLDC_CONTROLLER_SPEC_H
+#define BLDC_CONTROLLER_SPEC_H
+
+#include <stdint.h>
+#include "config.h"
+
+// Standstill hold drives b_cruiseCtrlEna at runtime, decided before the control modes are undefined below
+#if defined(BLDC_SPECIALISE) && defined(STANDSTILL_HOLD_ENABLE) && (CTRL_TYP_SEL == FOC_CTRL) && (CTRL_MOD_REQ != SPD_MODE)
+  #define BLDC_SPEC_CRUISE_RUNTIME
+#endif
+
+// BLDC_controller.c defines the control modes itself (same values as config.h)
+#undef OPEN_MODE
+#undef VLT_MODE
+#undef SPD_MODE
+#undef TRQ_MODE
+
+// Degraded mode diagnostics, set by the PWM interrupt for each step (bldc.c): 1 = normal operation,
+// 0 = diagnostics skipped, ISR_DEGRADE_DIAG = qualification times divided by ISR_DEGRADE_DIAG (at least 1)
+#if defined(ISR_DEGRADE_DIAG) && !defined(BLDC_MULTIRATE)
+  extern uint8_t bldcDiagDiv;
+
+  static inline uint16_t bldcDiagTime(uint16_t t) {
+    uint16_t q;
+    if (bldcDiagDiv <= 1) {
+      return t;
+    }
+    q = t / bldcDiagDiv;
+    return q ? q : 1;
+  }
+  #define BLDC_DIAG_RUN             (bldcDiagDiv != 0)
+  #define BLDC_P_ERR_QUAL(p)        bldcDiagTime((p)->t_errQual)
+  #define BLDC_P_ERR_DEQUAL(p)      bldcDiagTime((p)->t_errDequal)
+#else
+  #define BLDC_DIAG_RUN             1
+  #define BLDC_P_ERR_QUAL(p)        ((p)->t_errQual)
+  #define BLDC_P_ERR_DEQUAL(p)      ((p)->t_errDequal)
+#endif
+
+#ifdef BLDC_SPECIALISE
+  #define BLDC_P_CTRL_TYP(p)        ((uint8_T)CTRL_TYP_SEL)
+  #define BLDC_P_FIELD_WEAK_ENA(p)  ((boolean_T)FIELD_WEAK_ENA)
+  #define BLDC_P_ANGLE_MEAS_ENA(p)  ((boolean_T)0)          // BLDC_Init(): estimated angle
+  #define BLDC_P_DIAG_ENA(p)        ((boolean_T)DIAG_ENA && BLDC_DIAG_RUN)
+  #ifdef BLDC_SPEC_CRUISE_RUNTIME
+    #define BLDC_P_CRUISE_ENA(p)    ((p)->b_cruiseCtrlEna)
+  #else
+    #define BLDC_P_CRUISE_ENA(p)    ((boolean_T)0)
+  #endif
+#else
+  #define BLDC_P_CTRL_TYP(p)        ((p)->z_ctrlTypSel)
+  #define BLDC_P_FIELD_WEAK_ENA(p)  ((p)->b_fieldWeakEna)
+  #define BLDC_P_ANGLE_MEAS_ENA(p)  ((p)->b_angleMeasEna)
+  #define BLDC_P_DIAG_ENA(p)        ((p)->b_diagEna && BLDC_DIAG_RUN)
+  #define BLDC_P_CRUISE_ENA(p)      ((p)->b_cruiseCtrlEna)
+#endif
+
+#endif // BLDC_CONTROLLER_SPEC_H
@@ -4,9 +4,45 @@
 
 #include "stm32f1xx_hal.h"
 
+// ############################### CLOCK PROFILE ###############################
+/* Core clock, selected at boot by SystemClock_Config() (main.c) for the detected MCU:
+ *  - STM32F103: 64 MHz from the internal oscillator (HSI/2 x 16), 72 MHz with CLOCK_HSE (8 MHz crystal x 9)
+ *  - GD32F103 with CLOCK_GD32_108: 108 MHz (HSI/2 x 27, with CLOCK_HSE crystal/2 x 27), ~70 % more cycles per
+ *    control period. Without it the GD32F103 runs at the STM32F103 clock
+ * A GD32F103 is recognized by its Cortex-M3 revision r2p1 in SCB->CPUID (STM32F103: r1p1). Clones reporting r2p1 as
+ * well would be overclocked, so 108 MHz is opt-in: enable CLOCK_GD32_108 only for genuine GD32F103 boards. If the
+ * crystal does not start, CLOCK_HSE falls back to the internal oscillator. The timers always run at the core clock
+ * (APB1 /2 with x2 timer clock, APB2 /1), one timer tick is one core cycle. PWM period, dead time, current sampling
+ * window, ISR latency limit, buzzer prescaler and profiler budget are derived from SystemCoreClock at boot, the UART
+ * baud rates through the HAL. The ADC clock is kept at or below 16 MHz: /4 at 64 MHz, /6 at 72 MHz, /8 at 108 MHz (13.5 MHz).
+ * The boot report on USART3 prints the active clock: "Boot: ready in 412 ms, 108 MHz, ADC offsets stored".
+*/
+// #define CLOCK_GD32_108               // uncomment to run GD32F103 boards at 108 MHz (default: the STM32F103 clock)
+// #define CLOCK_HSE                    // uncomment to clock the PLL from an 8 MHz crystal (only on boards that have one)
+#define CLOCK_ADC_MAX           16000000  // [Hz] highest ADC clock selected
+// ########################### END OF CLOCK PROFILE ############################
+
+// ############################### CONTROL RATE ###############################
+/* The PWM interrupt and the controller step run at CTRL_FREQ, the bridges switch at PWM_FREQ, a multiple of it: the TIM8
+ * repetition counter triggers the ADC only every PWM_CTRL_DIV-th PWM period (e.g. 32 kHz PWM for quieter motors,
+ * 16 kHz control). The controller parameters in BLDC_controller_data.c are generated for BLDC_GEN_FREQ. At another
+ * CTRL_FREQ, BLDC_RateScale() rescales the rate dependent ones at boot: error qualification times, hall counter limits
+ * and speed coefficient, OPEN mode voltage rate, current filter, integrator and back-calculation gains. Registers written
+ * with the register map are in these rescaled per-step units. The controller outputs are scaled from BLDC_GEN_PWM_RES
+ * to the PWM resolution of PWM_FREQ. The current sampling window (pwm_margin) stays 1.7 us long, so the usable
+ * modulation drops from 89 % at 16 kHz PWM to 78 % at 32 kHz: less top speed at the same battery voltage.
+ * CTRL_FREQ: 8000 .. 24000 Hz (the speed estimation coefficient overflows above). PWM_FREQ: up to 128 * CTRL_FREQ.
+ * ADC_INJ_ENABLE triggers on every PWM period and needs PWM_FREQ = CTRL_FREQ.
+*/
+#define PWM_FREQ               16000     // [Hz] PWM frequency
+#define CTRL_FREQ              16000     // [Hz] control rate: PWM interrupt, controller step and time base (buzzerTimer)
+#define PWM_CTRL_DIV           (PWM_FREQ / CTRL_FREQ)   // [-] PWM periods per control period
+#define BLDC_GEN_FREQ          16000     // [Hz] DO NOT TOUCH: rate the controller parameters were generated for
+#define BLDC_GEN_PWM_RES       2000      // [timer ticks] DO NOT TOUCH: half PWM period the controller outputs DC_phaX (+-1000) are scaled for
+// ########################### END OF CONTROL RATE ############################
+
 // ############################### DO-NOT-TOUCH SETTINGS ###############################
-#define PWM_FREQ               16000     // PWM frequency in Hz / is also used for buzzer
-#define DEAD_TIME              48     // PWM deadtime
+#define DEAD_TIME              48     // [timer ticks at 64 MHz] PWM deadtime (750 ns), scaled to the core clock
 #define DELAY_IN_MAIN_LOOP     5
 #define TIMEOUT                20     // number of wrong / missing input commands before emergency off
 #define A2BIT_CONV             50     // A to bit for current conversion on ADC. Example: 1 A = 50, 2 A = 100, etc
@@ -26,8 +62,9 @@
 // This parameter needs to be the same as the ADC conversion for Current Phase of the FIRST Motor in setup.c
 #define ADC_CONV_CLOCK_CYCLES   (ADC_CONV_TIME_7C5)
 
-// Set the configured ADC divider. This parameter needs to be the same ADC divider as PeriphClkInit.AdcClockSelection (see main.c)
-#define ADC_CLOCK_DIV           (4)
+// ADC divider of the active clock profile, the one SystemClock_Config() selects (see main.c): 4 at 64 MHz, 6 at 72 MHz, 8 at 108 MHz
+#define ADC_CLOCK_DIV_AT(hz)    (((hz) + 2 * CLOCK_ADC_MAX - 1) / (2 * CLOCK_ADC_MAX) * 2)
+#define ADC_CLOCK_DIV           ADC_CLOCK_DIV_AT(SystemCoreClock)
 
 // ADC Total conversion time: this will be used to offset TIM8 in advance of TIM1 to align the Phase current ADC measurement
 // This parameter is used in setup.c
@@ -124,6 +161,9 @@
 #define CTRL_TYP_SEL    FOC_CTRL        // [-] Control type selection: COM_CTRL, SIN_CTRL, FOC_CTRL (default)
 #define CTRL_MOD_REQ    SPD_MODE        // [-] Control mode request: OPEN_MODE, VLT_MODE (default), SPD_MODE, TRQ_MODE. Note: SPD_MODE and TRQ_MODE are only available for CTRL_FOC!
 #define DIAG_ENA        1               // [-] Motor Diagnostics enable flag: 0 = Disabled, 1 = Enabled (default)
+// #define BLDC_SPECIALISE                // [-] Build BLDC_controller_step() for CTRL_TYP_SEL, FIELD_WEAK_ENA and DIAG_ENA only: the other control types and disabled features are compiled out. Parameter changes of these at runtime are then ignored. See BLDC_controller_spec.h
+// #define BLDC_MULTIRATE                 // [-] Multi-rate controller: the PWM interrupt runs the fast partition (estimation, FOC, modulation), the slow tasks (F02 diagnostics, F03 control mode manager, F04 field weakening, motor limitations, speed PI) run in PendSV at the lowest priority. See BLDC_controller_mr.c
+#define BLDC_SLOW_DIV   1               // [-] With BLDC_MULTIRATE: slow tasks every BLDC_SLOW_DIV * 3 control periods. 1 = generated rate (CTRL_FREQ / 3). Their time constants are rescaled by BLDC_SlowScale(). 1 .. 4 meet the tolerances of 'hover_replay -r vec.bin -s <div>'
 
 // Limitation settings
 #define I_MOT_MAX       15              // [A] Maximum single motor current limit
@@ -203,8 +243,203 @@
 */
 
 // #define DEBUG_SERIAL_PROTOCOL        // uncomment this to send user commands to the board, change parameters and print specific signals (see comms.c for the user commands)
+
+/* printf() does not wait for the UART: the text is queued in a ring buffer and sent by the USART3 Tx DMA.
+ * At 115200 baud the line carries ~11.5 bytes/ms, i.e. ~57 bytes per 5 ms main loop. When the buffer is full the
+ * message is dropped and counted; a change of the counters is reported as:
+ * // "Log overflow:2 dropped:160\r\n"
+*/
+#define LOG_BUFFER_SIZE         512     // [bytes] debug log ring buffer, must be a power of two
+#define LOG_DROP_POLICY         LOG_DROP_MSG  // LOG_DROP_MSG = drop the whole message, LOG_DROP_TAIL = send the part that fits
 // ########################### END OF DEBUG SERIAL ############################
 
+
+// ############################### PROFILER ###############################
+/* Execution time profiler of the PWM interrupt (DMA1_Channel1_IRQHandler, ADC1_2_IRQHandler with ADC_INJ_ENABLE), based on the DWT cycle counter.
+ * Min/max/mean cycles and a histogram per section (isr, io, buzzer, left, right, ctrl, slow) are printed on USART3,
+ * one section every PROF_PRINT_LOOPS main loops:
+ * // "prof left n:3200 min:1012 max:1254 avg:1090 maxload:31% bin:250 hist:0,0,0,0,3165,35,0,0,0,0,0,0,0,0,0,0\r\n"
+ * The control period (budget) is SystemCoreClock / CTRL_FREQ = 4000 cycles at 64 MHz, maxload is the worst case in percent of it.
+*/
+// #define PROFILER_ENABLE              // uncomment this to profile the PWM interrupt. Costs ~20 cycles per section
+#define PROF_PRINT_LOOPS        40      // [-] main loops between two printed sections: 40 * 5 ms = 200 ms
+// ########################### END OF PROFILER ############################
+
+
+
+// ############################### MAIN LOOP SCHEDULER ###############################
+/* The main loop tasks (Src/main.c) run from a cooperative scheduler, see Inc/sched.h: periodic tasks on the PWM period
+ * counter, the USART3 command task on the IDLE line interrupt. Run time and start jitter per task are printed with
+ * the profiler, one task per PROF_PRINT_LOOPS * DELAY_IN_MAIN_LOOP ms, load = time outside WFI:
+ * // "sched ctrl n:200 max:5120 avg:2310 cyc jit:0/62 us late:0\r\n"
+ * // "sched load:7%\r\n"
+ * SCHED_IDLE_WFI: sleep between the tasks. The core wakes on every interrupt (PWM interrupt at CTRL_FREQ).
+ *                 Some debug probes lose the connection in sleep mode, comment out for debugging if needed
+*/
+#define SCHED_IDLE_WFI                  // comment out to busy-wait between the main loop tasks
+// ########################### END OF MAIN LOOP SCHEDULER ############################
+
+
+
+// ############################### RAM EXECUTION ###############################
+/* Placement of the PWM interrupt hot path in SRAM, see Inc/ramfunc.h.
+ * At 64 MHz and above the flash runs with 2 wait states; the prefetch buffer hides them for straight code only,
+ * every taken branch and every table read from flash pays them. Copies in SRAM run without wait states.
+ * RAMFUNC_ENABLE: the PWM interrupt, the controller step and its helpers, the rate limiter, the low pass
+ *                 filter and the main loop exchange are linked into .ramfunc
+ * RAMDATA_ENABLE: the controller lookup tables (rtConstP: sine, hall position, field weakening maps) are linked into .ramdata
+ * The build prints the SRAM cost of both sections, 'make ramreport' lists the placed symbols with their sizes.
+ * The cycles saved are read from the "isr" and "ctrl" profiler sections (PROFILER_ENABLE) with and without.
+*/
+// #define RAMFUNC_ENABLE               // uncomment this to execute the PWM interrupt hot path from SRAM
+// #define RAMDATA_ENABLE               // uncomment this to read the controller lookup tables from SRAM
+// ########################### END OF RAM EXECUTION ############################
+
+
+// ############################### TELEMETRY ###############################
+/* Binary telemetry stream on USART3 (interleaved with the debug printf text). Every TELEM_DIV PWM periods the selected
+ * signals are sampled in the PWM interrupt and packed into frames of up to TELEM_FRAME_SAMPLES samples:
+ *   start(0xA55A) | mask | tick | div | seq | nSamp | samples (int16) | CRC16      -> see telemetry.h
+ * The selection and rate can be changed at runtime with a configuration frame on USART3:
+ *   start(0xA55B) | mask | div | CRC16
+ * Decode on the PC with 'make sil && build/sil/hover_telem < capture.bin > trace.csv'.
+ * Link budget: (2 * signals + 12 / TELEM_FRAME_SAMPLES) bytes per sample. 4 signals at 1 kHz = 9.5 kB/s fit in 115200 baud
+ * (11.5 kB/s, ~2 % of the samples are lost around each debug line), all 12 signals at 1 kHz need USART3_BAUD >= 460800.
+ * Samples that do not fit are dropped and counted. Benchmark on the PC: 'build/sil/hover_telem -b -?'.
+*/
+// #define TELEMETRY_ENABLE             // uncomment this to enable the binary telemetry stream on USART3
+#define TELEM_MASK              0x000F  // [-] default signals: bit 0..15 = iqL, idL, nL, angL, errL, iqR, idR, nR, angR, errR, dcCurr, batV, ocL, ocR, ocPerL, ocPerR. 0 = off
+#define TELEM_DIV               (CTRL_FREQ / 1000)  // [control periods] default sample period: 1 ms. Minimum TELEM_DIV_MIN (1 kHz)
+#define TELEM_FRAME_SAMPLES     8       // [-] samples per frame (fewer if TELEM_PAYLOAD_WORDS is reached)
+#define TELEM_PAYLOAD_WORDS     96      // [int16] frame payload capacity, two frames are kept in RAM
+// ########################### END OF TELEMETRY ############################
+
+
+// ############################### REGISTER MAP ###############################
+/* Controller parameters (PI gains, current filter, i_max, n_max, field weakening) and signals are read and written at
+ * runtime with binary register frames on USART3, see Inc/regmap.h for the registers and the frame layout:
+ *   start(0xA55C) | op | n | items | CRC16                   request,  item = id (read) or id | value (write)
+ *   start(0xA55D) | op | n | status | index | items | CRC16  response, item = id | value
+ * A write batch is checked completely (register, range) before anything is written, then copied into rtP_Left and
+ * rtP_Right with the interrupts off for ~1 us: every control step uses either all values of the batch or none.
+ * With the REG_OP_SAVE flag the parameters are saved to EEPROM as one batch and loaded at the next boot, on top of the
+ * configuration from config.h and the input calibration. The saved gains and times are in the units rescaled for
+ * CTRL_FREQ and BLDC_SLOW_DIV, a build with another rate ignores them. Saving is refused while the motors are enabled:
+ * the flash stalls the CPU, and the PWM interrupt with it, while it programs and erases.
+ * With BLDC_SPECIALISE fwEna is read only. Requests and responses on the PC, e.g.:
+ *   build/sil/hover_reg -w iqKp=1300,nKi=200 -r nL > request.bin      build/sil/hover_reg -d < capture.bin
+ * This replaces the parameter commands of DEBUG_SERIAL_PROTOCOL, whose comms.c is not part of this firmware.
+*/
+// #define REGMAP_ENABLE                // uncomment this to enable the register map on USART3
+#define REG_BATCH_MAX           16      // [-] registers per request
+#define FLASH_REG_KEY           0x2E61  // key of the saved parameters, combined with CTRL_FREQ and BLDC_SLOW_DIV. Change this key to ignore the parameters saved in EEPROM
+// ########################### END OF REGISTER MAP ############################
+
+
+// ############################### ISR OVERRUN ###############################
+/* The PWM interrupt records the worst-case completion time after the start of the PWM period and counts the periods
+ * in which it finished after the next ADC sample was already available (overrun). Both are printed on USART3 when the
+ * overrun count changes:
+ * // "ISR overrun:3 latMax:3925 degraded:15998\r\n"
+ * A late period (overrun or completion later than ISR_LATENCY_MAX) switches to degraded mode for ISR_DEGRADE_HOLD
+ * periods: the buzzer is muted and, with ISR_DEGRADE_DIAG, the controller diagnostics run at a reduced rate. The two
+ * control steps and the current chopping always run.
+ * The speed loop of the second motor is not decimated: in the single rate step its PI sets the q-axis voltage in the
+ * same generated FOC slot as the current loops, so it cannot run less often alone; with BLDC_MULTIRATE it runs in PendSV.
+*/
+#define ISR_LATENCY_MAX         (SystemCoreClock / CTRL_FREQ * 39 / 40)  // [timer ticks] latest accepted ISR completion (97.5 % of the period). 1 tick = 1 core cycle, control period = 4000 ticks at 64 MHz
+#define ISR_DEGRADE_HOLD        CTRL_FREQ // [control periods] time in degraded mode after the last late period: 1 s
+// #define ISR_DEGRADE_DIAG        4       // [-] uncomment to run the controller diagnostics (hall / blocked motor errors) in only every 4th scheduler period in degraded mode, with the qualification times divided by 4. No effect with BLDC_MULTIRATE (diagnostics in PendSV)
+// ########################### END OF ISR OVERRUN ############################
+
+
+// ############################### FAST COMMAND PATH ###############################
+/* Protocol v2 frames with the SERIAL_V2_FAST flag (see util.h) set the motor targets of the next PWM interrupt directly
+ * from the USART2 receive interrupt, instead of waiting for the main loop (up to DELAY_IN_MAIN_LOOP ms + filter delay).
+ * The targets are clamped to the input limits and rate limited in the PWM interrupt with the same acceleration as the
+ * main loop (RATE). Without a new fast frame for FAST_CMD_TIMEOUT the main loop targets take over again.
+ * The latency from frame accept to the control step using it is printed on USART3:
+ * // "Fast cmd:1200 lat:23 max:61 us\r\n"
+*/
+// #define FAST_CMD_ENABLE                 // uncomment this to enable the fast command path
+#define FAST_CMD_TIMEOUT        (CTRL_FREQ / 10)  // [control periods] fast targets are used for 100 ms after the last frame
+#define FAST_CMD_RATE           ((RATE << 10) / (DELAY_IN_MAIN_LOOP * CTRL_FREQ / 1000))  // [-] RATE per control period instead of per main loop, fixdt(1,32,14): 10 more fraction bits than RATE, a small RATE does not round down to 0
+// ########################### END OF FAST COMMAND PATH ############################
+
+
+
+// ############################### ADC CURRENT OFFSETS ###############################
+/* The phase and DC link current offsets are measured by the PWM interrupt at boot, before the controller starts:
+ * the mean of ADC_OFFSET_CAL samples. They are saved to EEPROM at power off when they moved by more than ADC_OFFSET_SAVE.
+ * FAST_BOOT_ENABLE: the saved offsets are checked against the mean of a short burst of ADC_OFFSET_BURST samples and used
+ *                   when all six agree within ADC_OFFSET_TOL. Otherwise the measurement continues to ADC_OFFSET_CAL samples.
+ * ADC_OFFSET_TRACK: while the motors are disabled and (nearly) standing still, the offsets follow slow drift (temperature).
+ * The time from power on to the controller start is printed once on USART3:
+ * // "Boot: ready in 68 ms, ADC offsets calibrated\r\n"
+*/
+// #define FAST_BOOT_ENABLE                // uncomment this to start with the offsets saved in EEPROM
+#define ADC_OFFSET_CAL          1024      // [control periods] full offset measurement: 64 ms at 16 kHz
+#define ADC_OFFSET_BURST        64        // [control periods] check of the saved offsets: 4 ms at 16 kHz
+#define ADC_OFFSET_TOL          30        // [ADC counts] max deviation of the burst mean from a saved offset
+#define ADC_OFFSET_SAVE         4         // [ADC counts] min change of an offset to save the offsets again
+#define ADC_OFFSET_TRACK                  // comment out to keep the boot offsets
+#define ADC_OFFSET_TRACK_COEF   66        // [-] fixdt(0,16,16): time constant ~1 s, filtered every 1 ms
+#define ADC_OFFSET_TRACK_NMAX   20        // [rpm] tracking only below this speed of both motors (no back-EMF currents)
+#define FLASH_OFFSET_KEY        0x0FF5    // check word of the saved offsets: key ^ sum of the offsets
+// ########################### END OF ADC CURRENT OFFSETS ############################
+
+
+// ############################### ADC INJECTED CURRENTS ###############################
+/* Default: one regular scan of 5 conversions per PWM period (currents, battery, temperature, analog inputs), the PWM
+ * interrupt (DMA1_Channel1_IRQHandler) starts at the end of the scan: 326 ADC cycles = 20.4 us after the trigger,
+ * the temperature sensor alone takes 252 of them.
+ * ADC_INJ_ENABLE: the six currents are converted in the injected group of ADC1/ADC2, triggered by TIM8 CC4 at the same
+ *                 instant as the regular trigger before. The PWM interrupt (ADC1_2_IRQHandler, end of the injected
+ *                 group) starts 54 ADC cycles = 3.4 us after the trigger. Battery, temperature and the analog inputs
+ *                 are converted by a regular scan started every ADC_SLOW_DIV PWM periods from the PWM interrupt,
+ *                 in the otherwise idle ADC time; the DMA copies them to adc_buffer without an interrupt.
+ *                 The 4th injected rank is free, e.g. for a second sample of the currents.
+*/
+// #define ADC_INJ_ENABLE                  // uncomment this to sample the currents with the injected ADC group
+#define ADC_SLOW_DIV            (CTRL_FREQ / 1000)  // [control periods] battery, temperature and analog input scan: every 1 ms
+// ########################### END OF ADC INJECTED CURRENTS ############################
+
+
+// ############################### OVERCURRENT TRIP ###############################
+/* Level 2 current protection: a DC link current above I_DC_MAX switches the bridge off (MOE) for the rest of the control
+ * period. In software (always active, also the fallback of the options below) the PWM interrupt compares the current
+ * after the ADC scan, 20 us after the sample without ADC_INJ_ENABLE, plus the interrupt latency.
+ * OC_TRIP_AWD:  the analog watchdogs of ADC1/ADC2 watch the two DC link channels, window = offset +- I_DC_MAX. A sample
+ *               outside of it clears MOE from ADC1_2_IRQHandler right after its conversion, ~1 us after the sample.
+ *               The window follows the offsets. Still one sample per control period.
+ * OC_TRIP_BKIN: the break inputs of TIM1/TIM8 clear MOE in hardware, within the timer clock, for an external
+ *               comparator on the DC link current (not fitted on the stock boards): PB12 (TIM1, right bridge) and
+ *               PA6 (TIM8, left bridge), active low with pull-up.
+ * The PWM interrupt switches the bridge on again in the next control period below the limit (cycle by cycle chopping).
+ * ocTripCntL / ocTripCntR count the trips of any source (a trip over several periods counts once), ocTripPerL /
+ * ocTripPerR the control periods with a trip, streamed as telemetry signals ocL / ocR and ocPerL / ocPerR (see TELEMETRY).
+*/
+// #define OC_TRIP_AWD                     // uncomment to trip with the ADC analog watchdogs
+// #define OC_TRIP_BKIN                    // uncomment to trip with the timer break inputs (external comparator needed)
+// ########################### END OF OVERCURRENT TRIP ############################
+
+
+// ############################### PWM PHASE SHIFT ###############################
+/* TIM8 (left bridge) runs ADC_TOTAL_CONV_TIME ahead of TIM1 (right bridge), so both bridges switch nearly in phase and
+ * the DC link capacitors carry the sum of the two ripple currents. PWM_PHASE_SHIFT moves TIM8 further ahead by a part
+ * of the PWM period (180 deg = one counter ramp): the current pulses of the two bridges interleave and the RMS ripple
+ * current in the capacitors drops. Center-aligned PWM draws two pulses per period, so 90 deg interleaves best and
+ * 180 deg is no better than 0: -32 % capacitor RMS at 90 deg in the SIL benchmark ('hover_sil -m spd -c 800 -L 8 -R').
+ * Each bridge is sampled at the top of its own counter (low side on): ADC1 samples the right bridge on TIM1 CC4,
+ * ADC2 the left bridge on TIM8 CC4, as independent ADCs. The PWM interrupt starts at the end of the right sample and
+ * uses the latest left sample. The left bridge takes the new duty cycles at the next update of TIM8, PWM_LEFT_LEAD()
+ * before the right bridge, or one control period later when the interrupt is still running then.
+ * Requires ADC_INJ_ENABLE. 0 = in phase, as before.
+*/
+#define PWM_PHASE_SHIFT         0       // [deg] 0..180, phase lead of the left bridge PWM
+#define PWM_LEFT_LEAD(res, deg) MIN(ADC_TOTAL_CONV_TIME + (res) * (deg) / 180, (res))  // [timer ticks] TIM8 counter start ahead of TIM1, res = ARR
+// ########################### END OF PWM PHASE SHIFT ############################
+
 #define PRI_INPUT1             3, -1000, 0, 1000, 0     // TYPE, MIN, MID, MAX, DEADBAND. See INPUT FORMAT section
 #define PRI_INPUT2             3, -1000, 0, 1000, 0     // TYPE, MIN, MID, MAX, DEADBAND. See INPUT FORMAT section
 #define FLASH_WRITE_KEY      0x1002  // Flash memory writing key. Change this key to ignore the input calibrations from the flash memory and use the ones in config.h
@@ -219,6 +454,8 @@
 
 // ########################### UART SETIINGS ############################
 #define SERIAL_START_FRAME      0xABCD                  // [-] Start frame definition for serial commands
+#define SERIAL_START_FRAME_V2   0xACCD                  // [-] Start frame of protocol v2 commands and feedback (CRC16, sequence number, per motor targets, see util.h)
+#define SERIAL_PROTOCOL_V2      2                       // [-] Protocol v2 version field
 #define SERIAL_BUFFER_SIZE      64                      // [bytes] Size of Serial Rx buffer. Make sure it is always larger than the structure size
 #define SERIAL_TIMEOUT          160                     // [-] Serial timeout duration for the received data. 160 ~= 0.8 sec. Calculation: 0.8 sec / 0.005 sec
 
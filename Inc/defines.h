@@ -125,6 +125,16 @@
 #define BUZZER_PORT GPIOC
 #endif
 
+// Buzzer square wave and pattern sequencer: basic timer counting half buzzer periods, update interrupt at the lowest priority.
+// The buzzer period is fixed at 1 / BUZZER_TIM_FREQ, independent of PWM_FREQ and CTRL_FREQ: buzzerFreq and the melodies are in it
+#define BUZZER_TIM TIM6
+#define BUZZER_TIM_IRQn TIM6_IRQn
+#define BUZZER_TIM_FREQ 16000       // [Hz] buzzer period rate, the former PWM rate the tones were written for
+#define BUZZER_TIM_IDLE 16          // [buzzer periods] update period while silent: 1 ms
+#define BUZZER_TIM_SLOT 5000        // [buzzer periods] pattern slot, see beepCount()
+#define BEEP_QUEUE_LEN 16           // [-] queued beeps and melody notes, power of two, see beepQueue()
+#define BEEP_WAIT_MARGIN 50         // [ms] beepWait() gives up this long after the queued notes should have ended
+
 // UNUSED/REDUNDANT
 //#define SWITCH_PIN GPIO_PIN_1
 //#define SWITCH_PORT GPIOA
@@ -173,6 +183,14 @@
 #define PWM_PORT_CH2        GPIOB
 #endif
 
+#if defined(OC_TRIP_BKIN)
+// Break inputs: TIM8_BKIN (left), TIM1_BKIN (right)
+#define LEFT_OC_BKIN_PIN    GPIO_PIN_6
+#define LEFT_OC_BKIN_PORT   GPIOA
+#define RIGHT_OC_BKIN_PIN   GPIO_PIN_12
+#define RIGHT_OC_BKIN_PORT  GPIOB
+#endif
+
 #define DELAY_TIM_FREQUENCY_US 1000000
 
 #define MILLI_R (R * 1000)
@@ -217,6 +235,20 @@ typedef struct {
   uint16_t l_rx2;
 } adc_buf_t;
 
+// ADC current offsets (zero current readings), see bldcOffsetLoad()
+typedef struct {
+  int16_t rlA;
+  int16_t rlB;
+  int16_t rrB;
+  int16_t rrC;
+  int16_t dcl;
+  int16_t dcr;
+} adc_offset_t;
+
+#define OFFSET_NONE   0             // offsets not ready, the controller does not run yet
+#define OFFSET_CAL    1             // measured at boot
+#define OFFSET_STORED 2             // from EEPROM, confirmed by the boot burst
+
 typedef enum {
   NUNCHUK_CONNECTING,
   NUNCHUK_DISCONNECTED,
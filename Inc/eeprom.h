@@ -183,11 +183,11 @@
 /* Pages 0 and 1 base and end addresses */
 #define PAGE0_BASE_ADDRESS    ((uint32_t)(EEPROM_START_ADDRESS + 0x0000))
 #define PAGE0_END_ADDRESS     ((uint32_t)(EEPROM_START_ADDRESS + (PAGE_SIZE - 1)))
-#define PAGE0_ID               ADDR_FLASH_PAGE_64
+#define PAGE0_ID               PAGE0_BASE_ADDRESS
 
 #define PAGE1_BASE_ADDRESS    ((uint32_t)(EEPROM_START_ADDRESS + 0x10000))
 #define PAGE1_END_ADDRESS     ((uint32_t)(EEPROM_START_ADDRESS + 0x10000 + PAGE_SIZE - 1))
-#define PAGE1_ID               ADDR_FLASH_PAGE_96
+#define PAGE1_ID               PAGE1_BASE_ADDRESS  /* erase address, the ADDR_FLASH_PAGE_x table assumes 1 Kbyte pages */
 
 /* Used Flash pages for EEPROM emulation */
 #define PAGE0                 ((uint16_t)0x0000)
@@ -205,18 +205,45 @@
 #define READ_FROM_VALID_PAGE  ((uint8_t)0x00)
 #define WRITE_IN_VALID_PAGE   ((uint8_t)0x01)
 
+/* Second half-word of the page header: page written with commit markers, see eeprom.c */
+#define PAGE_FORMAT           ((uint16_t)0x5458)
+
+/* Virtual address of a commit marker record: its data is the number of records it commits.
+   Reserved like 0xFFFF, must not be used in VirtAddVarTab. A program cut by a power loss only
+   clears part of the bits, so no other virtual address can turn into 0x0000 */
+#define COMMIT_ADDRESS        ((uint16_t)0x0000)
+
 /* Page full define */
 #define PAGE_FULL             ((uint8_t)0x80)
 
 /* Variables' number */
-#define NB_OF_VAR             ((uint8_t)0x13)       /* 19 Variables */
+#define NB_OF_VAR             ((uint8_t)0x29)       /* 41 Variables: 19 configuration, 7 ADC current offsets, 15 register map */
+
+/* Initializer of VirtAddVarTab, shared by util.c and the host models of the EEPROM (sil/Src).
+   0: write key, 1..18: configuration, 19: offsets check word, 20..25: ADC current offsets,
+   26: register map key, 27..40: register map parameters. eeprom.c checks that it has NB_OF_VAR entries */
+#define VIRT_ADDR_TAB         {1000, 1001, 1002, 1003, 1004, 1005, 1006, 1007, 1008, 1009, \
+                               1010, 1011, 1012, 1013, 1014, 1015, 1016, 1017, 1018, 1019, \
+                               1020, 1021, 1022, 1023, 1024, 1025, 1026, 1027, 1028, 1029, \
+                               1030, 1031, 1032, 1033, 1034, 1035, 1036, 1037, 1038, 1039, \
+                               1040}
 
 /* Exported types ------------------------------------------------------------*/
 /* Exported macro ------------------------------------------------------------*/
+/* Flash read access: memory mapped on target, the flash model of the host tools with EE_HOST */
+#ifdef EE_HOST
+  uint16_t EE_HostRead16(uint32_t Address);
+  #define EE_READ16(Address)  EE_HostRead16(Address)
+#else
+  #define EE_READ16(Address)  (*(__IO uint16_t*)(Address))
+#endif
+
 /* Exported functions ------------------------------------------------------- */
 uint16_t EE_Init(void);
 uint16_t EE_ReadVariable(uint16_t VirtAddress, uint16_t* Data);
 uint16_t EE_WriteVariable(uint16_t VirtAddress, uint16_t Data);
+void     EE_WriteBegin(void);
+uint16_t EE_WriteCommit(void);
 
 #endif /* __EEPROM_H */
 
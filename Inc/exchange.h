@@ -0,0 +1,62 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Define to prevent recursive inclusion
+#ifndef EXCHANGE_H
+#define EXCHANGE_H
+
+#include <stdint.h>
+
+// Two-slot sequence lock ("latch"): one writer, any number of readers, no interrupt locking
+typedef struct {
+  uint32_t  seq;                    // [-] incremented twice per publish, odd while slot 0 is written
+  uint16_t  size;                   // [bytes] snapshot size
+  uint16_t  retries;                // [-] reads repeated because the writer published meanwhile (saturating, statistics only)
+  void     *slot;                   // 2 * size bytes
+} ExchLatch;
+
+// Define a latch for snapshots of the given type
+#define EXCH_LATCH(name, type)      static type name##_slot[2]; ExchLatch name = { 0, sizeof(type), 0, name##_slot }
+
+// Main loop -> PWM interrupt, published once per main loop
+typedef struct {
+  int16_t   pwml;                   // left motor target, INPUT_MIN to INPUT_MAX
+  int16_t   pwmr;                   // right motor target
+  uint8_t   enable;                 // motor enable, released together with the first targets
+  uint8_t   ctrlModReq;             // control mode request: OPEN_MODE, VLT_MODE, SPD_MODE, TRQ_MODE
+} ExchSetpoint;
+
+// PWM interrupt -> main loop, published after every control step
+typedef struct {
+  uint32_t  tick;                   // [control periods] buzzerTimer of the control step
+  int16_t   n_motL;                 // [rpm] measured speed
+  int16_t   n_motR;
+  int16_t   iqL;                    // q-axis current
+  int16_t   iqR;
+  int16_t   i_DCLinkL;              // DC link current input of the controller
+  int16_t   i_DCLinkR;
+  uint8_t   errCodeL;               // controller error code
+  uint8_t   errCodeR;
+} ExchState;
+
+extern ExchLatch exchSetpoint;
+extern ExchLatch exchState;
+
+void     Exch_Publish(ExchLatch *l, const void *src);
+uint16_t Exch_Read(ExchLatch *l, void *dst);
+
+#endif // EXCHANGE_H
@@ -0,0 +1,43 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Define to prevent recursive inclusion
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdint.h>
+#include "stm32f1xx_hal.h"
+#include "config.h"
+
+// Drop policy when a message does not fit in the free part of the ring buffer
+#define LOG_DROP_MSG        0       // drop the complete message, the log only ever contains whole lines
+#define LOG_DROP_TAIL       1       // keep the part that fits and drop the rest of the message
+
+typedef struct {
+  uint32_t  overflowCnt;            // [-] messages that did not (completely) fit in the buffer
+  uint32_t  dropBytes;              // [bytes] bytes discarded because of overflow
+  uint32_t  txBytes;                // [bytes] bytes handed to the DMA
+  uint16_t  fillMax;                // [bytes] highest buffer fill level seen
+} LogStats;
+
+void Log_Init(void);
+int  Log_Write(const char *data, int len);
+int  Log_SubmitBlock(const uint8_t *data, uint16_t len, void (*done)(void));
+void Log_TxCplt(UART_HandleTypeDef *huart);
+void Log_GetStats(LogStats *out);
+
+#endif // LOGGER_H
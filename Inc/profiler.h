@@ -0,0 +1,72 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Define to prevent recursive inclusion
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include "stm32f1xx_hal.h"
+#include "config.h"
+
+// Profiled sections of the PWM interrupt (DMA1_Channel1_IRQHandler, ADC1_2_IRQHandler with ADC_INJ_ENABLE)
+typedef enum {
+  PROF_ISR,             // complete interrupt
+  PROF_IO,              // battery filter, current readout, current chopping
+  PROF_BUZZER,          // buzzer square wave and pattern sequencer (own timer interrupt, not part of isr)
+  PROF_LEFT,            // left motor controller step
+  PROF_RIGHT,           // right motor controller step
+  PROF_CTRL,            // both controller steps
+  PROF_SLOW,            // slow controller tasks in PendSV (BLDC_MULTIRATE), wall time incl. preemption
+  PROF_SECTIONS
+} ProfSection;
+
+#define PROF_HIST_BINS      16                                                  // [-] histogram bins, the last bin collects everything above
+#define PROF_BUDGET_CYC     (SystemCoreClock / CTRL_FREQ)                       // [cycles] one control period = 4000 cycles at 64 MHz
+#define PROF_BIN_CYC        ((PROF_BUDGET_CYC + PROF_HIST_BINS - 1) / PROF_HIST_BINS) // [cycles] histogram bin width
+
+typedef struct {
+  uint32_t  cnt;                        // number of samples
+  uint32_t  min;                        // [cycles]
+  uint32_t  max;                        // [cycles]
+  uint64_t  sum;                        // [cycles]
+  uint32_t  hist[PROF_HIST_BINS];       // [-] samples per PROF_BIN_CYC wide bin
+} ProfStat;
+
+// Time base: DWT cycle counter on target, host clock in SystemCoreClock cycles for the SIL build
+#ifdef PROF_HOST
+  uint32_t Prof_HostCycles(void);
+  #define PROF_CYCLES()     Prof_HostCycles()
+#else
+  #define PROF_CYCLES()     (DWT->CYCCNT)
+#endif
+
+#ifdef PROFILER_ENABLE
+  #define PROF_START(s)     uint32_t prof_t0_##s = PROF_CYCLES()
+  #define PROF_STOP(s)      Prof_Record((s), PROF_CYCLES() - prof_t0_##s)
+#else
+  #define PROF_START(s)
+  #define PROF_STOP(s)
+#endif
+
+void Prof_Init(void);
+void Prof_Reset(void);
+void Prof_Record(ProfSection s, uint32_t cyc);
+void Prof_Snapshot(ProfSection s, ProfStat *out);
+void Prof_PrintNext(void);
+
+#endif // PROFILER_H
@@ -0,0 +1,46 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * SRAM placement of the PWM interrupt hot path (RAMFUNC_ENABLE / RAMDATA_ENABLE in config.h).
+ * RAMFUNC marks a function definition for the .ramfunc section, RAMDATA a constant table for
+ * the .ramdata section. STM32F103RCTx_FLASH.ld links both into RAM with their load image in
+ * flash, the Reset_Handler in startup_stm32f103xe.s copies them before main().
+ * Calls between flash and SRAM are out of BL range: RAMFUNC functions are called with long_call,
+ * the linker adds veneers for callers that only see the plain prototype.
+ * Without the options, and in the host (SIL) build, the macros are empty.
+ */
+
+// Define to prevent recursive inclusion
+#ifndef RAMFUNC_H
+#define RAMFUNC_H
+
+#include "config.h"
+
+#if defined(RAMFUNC_ENABLE) && defined(__arm__)
+  #define RAMFUNC   __attribute__((section(".ramfunc"), long_call))
+#else
+  #define RAMFUNC
+#endif
+
+#if defined(RAMDATA_ENABLE) && defined(__arm__)
+  #define RAMDATA   __attribute__((section(".ramdata")))
+#else
+  #define RAMDATA
+#endif
+
+#endif // RAMFUNC_H
@@ -0,0 +1,104 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Define to prevent recursive inclusion
+#ifndef REGMAP_H
+#define REGMAP_H
+
+#include <stdint.h>
+#include "config.h"
+
+// Registers. The id on the wire is the enum value. Parameters come first: they are written to rtP_Left
+// and rtP_Right with the same value and can be saved to EEPROM. The signals after them are read only.
+// Values are in the raw controller units, the gains and filter defaults are in BLDC_controller_data.c.
+typedef enum {
+  REG_IQ_KP,            // cf_iqKp                 [-]
+  REG_IQ_KI,            // cf_iqKi                 [-]
+  REG_ID_KP,            // cf_idKp                 [-]
+  REG_ID_KI,            // cf_idKi                 [-]
+  REG_N_KP,             // cf_nKp                  [-]
+  REG_N_KI,             // cf_nKi                  [-]
+  REG_CURR_FILT,        // cf_currFilt             [-] > 0
+  REG_I_MAX,            // i_max                   [A * A2BIT_CONV] fixdt(1,16,4), up to I_MOT_MAX
+  REG_N_MAX,            // n_max                   [rpm] fixdt(1,16,4)
+  REG_FW_ENA,           // b_fieldWeakEna          [-] 0 / 1, read only with BLDC_SPECIALISE
+  REG_FW_MAX,           // id_fieldWeakMax         [A * A2BIT_CONV] fixdt(1,16,4), up to I_MOT_MAX
+  REG_PHA_ADV_MAX,      // a_phaAdvMax             [deg] fixdt(1,16,4), up to 60 deg
+  REG_FW_HI,            // r_fieldWeakHi           [-] fixdt(1,16,4), (1000, 1500]
+  REG_FW_LO,            // r_fieldWeakLo           [-] fixdt(1,16,4), ( 500, 1000]
+  REG_IQ_L,             // rtY_Left.iq             [A * A2BIT_CONV]
+  REG_ID_L,             // rtY_Left.id             [A * A2BIT_CONV]
+  REG_N_L,              // rtY_Left.n_mot          [rpm]
+  REG_ERR_L,            // rtY_Left.z_errCode      [-]
+  REG_IQ_R,             // rtY_Right.iq
+  REG_ID_R,             // rtY_Right.id
+  REG_N_R,              // rtY_Right.n_mot
+  REG_ERR_R,            // rtY_Right.z_errCode
+  REG_DC_CURR,          // dc_curr                 [A * 100], updated by the main loop
+  REG_BAT_V,            // batVoltage              [ADC counts], filtered in the PWM interrupt
+  REGS
+} RegId;
+
+#define REG_PARAMS          (REG_FW_LO + 1)     // [-] registers 0 .. REG_PARAMS-1 are parameters
+#define REG_EE_KEY          26                  // [-] VirtAddVarTab index of the key word, parameters follow at REG_EE_KEY + 1 + id
+
+#define REG_START_FRAME     0xA55C      // [-] start of a register request (host -> board)
+#define REG_RESP_FRAME      0xA55D      // [-] start of a register response (board -> host)
+#define REG_HDR_SIZE        4           // [bytes] start | op | n
+#define REG_RESP_HDR_SIZE   6           // [bytes] start | op | n | status | index
+#define REG_ITEM_SIZE       3           // [bytes] id | value
+
+// Request operations
+#define REG_OP_READ         0x01        // request items: id
+#define REG_OP_WRITE        0x02        // request items: id | value
+#define REG_OP_SAVE         0x80        // flag with REG_OP_WRITE: then save all parameters to EEPROM (n = 0: save only)
+
+// Response status
+typedef enum {
+  REG_OK,
+  REG_ERR_ID,           // unknown register
+  REG_ERR_RO,           // write to a signal or a read only parameter
+  REG_ERR_RANGE,        // value outside the accepted range of the register
+  REG_ERR_OP,           // REG_OP_SAVE with REG_OP_READ
+  REG_ERR_BUSY,         // save refused: the motors are enabled
+  REG_ERR_EEPROM        // save failed
+} RegStatus;
+
+/*
+ * Frames on the wire (little endian). The CRC (calcCRC16, start value 0xFFFF) covers everything before it.
+ *   request:  start(0xA55C) | op | n | n items | CRC16
+ *             READ item = id (uint8), WRITE item = id (uint8) | value (uint16)
+ *   response: start(0xA55D) | op | n | status | index | n items | CRC16
+ *             item = id (uint8) | value (uint16)
+ * A batch is all or nothing: on an error nothing is written, index is the first rejected item (n when
+ * the batch was refused as a whole) and no items follow. Otherwise the items hold the registers read, or written, all taken in one control
+ * period. REG_ERR_EEPROM is the exception: the values were applied, only the save failed.
+ * Signed registers are sent as their uint16 bit pattern.
+ */
+typedef struct {
+  uint16_t  start;                              // REG_START_FRAME
+  uint8_t   op;                                 // REG_OP_READ or REG_OP_WRITE [| REG_OP_SAVE]
+  uint8_t   n;                                  // items, up to REG_BATCH_MAX
+} RegHeader;
+
+extern const char *const regName[REGS];
+
+void Reg_Load(void);
+void Reg_Command(const uint8_t *data, uint32_t len);
+uint16_t Reg_FrameSize(uint8_t op, uint8_t n);
+
+#endif // REGMAP_H
@@ -0,0 +1,64 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Define to prevent recursive inclusion
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+#include "stm32f1xx_hal.h"
+#include "config.h"
+
+// Main loop tasks, in priority order: when several are ready the first one in the list runs first
+typedef enum {
+  SCHED_RX,             // USART3 debug / telemetry commands, event from the USART3 IDLE interrupt
+  SCHED_CTRL,           // inputs, filters, mixer, hand over to the PWM interrupt, measurements
+  SCHED_FEEDBACK,       // USART2 feedback frame
+  SCHED_PROTECT,        // poweroff, motor errors, timeouts, warnings and their beeps
+  SCHED_DEBUG,          // debug serial output
+  SCHED_REPORT,         // ISR overrun, log overflow, fast command and slow task reports
+  SCHED_PROF,           // profiler and scheduler statistics (PROFILER_ENABLE)
+  SCHED_TASKS
+} SchedTaskId;
+
+// Time base: buzzerTimer, one tick per control period
+#define SCHED_MS(ms)        ((uint32_t)(ms) * CTRL_FREQ / 1000)                 // [control periods]
+#define SCHED_TICK_US(t)    ((uint32_t)(t) * 1000 / (CTRL_FREQ / 1000))         // [us]
+
+typedef struct {
+  const char *name;
+  void      (*fcn)(void);
+  uint32_t    period;                   // [control periods] 0 = runs on Sched_Signal() only
+  uint32_t    offset;                   // [control periods] phase of the first release, spreads tasks with the same period
+} SchedTask;
+
+typedef struct {
+  uint32_t  cnt;                        // number of runs
+  uint32_t  cycMax;                     // [cycles] worst-case run time
+  uint64_t  cycSum;                     // [cycles]
+  uint32_t  jitMax;                     // [control periods] worst-case start delay after the release
+  uint64_t  jitSum;                     // [control periods]
+  uint32_t  late;                       // periodic releases dropped because the task started more than one period late
+} SchedStat;
+
+void Sched_Init(const SchedTask *tasks);
+void Sched_Signal(SchedTaskId id);
+void Sched_Run(void);
+void Sched_Snapshot(SchedTaskId id, SchedStat *out);
+void Sched_PrintNext(void);
+
+#endif // SCHED_H
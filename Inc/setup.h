@@ -27,6 +27,7 @@
 
 void MX_GPIO_Init(void);
 void MX_TIM_Init(void);
+void MX_BUZZER_TIM_Init(void);
 void MX_ADC1_Init(void);
 void MX_ADC2_Init(void);
 void UART2_Init(void);
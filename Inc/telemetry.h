@@ -0,0 +1,93 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Define to prevent recursive inclusion
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include "config.h"
+
+// Signals that can be streamed. The bit position in the selection mask is the enum value.
+typedef enum {
+  TELEM_IQ_L,           // rtY_Left.iq             [A * A2BIT_CONV]
+  TELEM_ID_L,           // rtY_Left.id             [A * A2BIT_CONV]
+  TELEM_N_L,            // rtY_Left.n_mot          [rpm]
+  TELEM_ANG_L,          // rtY_Left.a_elecAngle    [deg * 16]
+  TELEM_ERR_L,          // rtY_Left.z_errCode      [-]
+  TELEM_IQ_R,           // rtY_Right.iq
+  TELEM_ID_R,           // rtY_Right.id
+  TELEM_N_R,            // rtY_Right.n_mot
+  TELEM_ANG_R,          // rtY_Right.a_elecAngle
+  TELEM_ERR_R,          // rtY_Right.z_errCode
+  TELEM_DC_CURR,        // dc_curr                 [A * 100], updated by the main loop
+  TELEM_BAT_V,          // batVoltage              [ADC counts], filtered in the PWM interrupt
+  TELEM_OC_L,           // ocTripCntL              [-] overcurrent trips, wraps
+  TELEM_OC_R,           // ocTripCntR
+  TELEM_OCP_L,          // ocTripPerL              [control periods] with an overcurrent trip, wraps
+  TELEM_OCP_R,          // ocTripPerR
+  TELEM_SIGNALS
+} TelemSignal;
+
+#define TELEM_SIG(s)        (1U << (s))
+#define TELEM_MASK_ALL      (TELEM_SIG(TELEM_SIGNALS) - 1U)
+
+#define TELEM_START_FRAME   0xA55A      // [-] start of a telemetry frame (board -> host)
+#define TELEM_CFG_FRAME     0xA55B      // [-] start of a configuration frame (host -> board)
+#define TELEM_HDR_SIZE      10          // [bytes] frame header, up to and excluding data[]
+#define TELEM_DIV_MIN       (CTRL_FREQ / 1000)  // [control periods] fastest sample period: 1 kHz
+
+/*
+ * Frame on the wire (little endian), nSig = number of bits set in mask:
+ *   start | mask | tick | div | seq | nSamp | nSamp * nSig samples | CRC16
+ * Samples are stored sample by sample, signals in ascending bit order. The CRC
+ * (calcCRC16, start value 0xFFFF) covers everything before it.
+ */
+typedef struct {
+  uint16_t  start;                              // TELEM_START_FRAME
+  uint16_t  mask;                               // selected signals
+  uint16_t  tick;                               // [control periods] time stamp of the first sample, wraps around
+  uint16_t  div;                                // [control periods] sample period
+  uint8_t   seq;                                // frame counter, gaps mean lost frames
+  uint8_t   nSamp;                              // samples in this frame
+  int16_t   data[TELEM_PAYLOAD_WORDS + 1];      // samples followed by the CRC16
+} TelemFrame;
+
+// Configuration frame, accepted on USART3
+typedef struct {
+  uint16_t  start;                              // TELEM_CFG_FRAME
+  uint16_t  mask;                               // selected signals, 0 = stop streaming
+  uint16_t  div;                                // [control periods] sample period, >= TELEM_DIV_MIN
+  uint16_t  crc;                                // calcCRC16 over the 6 bytes above
+} TelemConfig;
+
+typedef struct {
+  uint32_t  frames;                             // [-] frames handed to the DMA
+  uint32_t  dropSamples;                        // [-] samples lost because both buffers were busy
+  uint16_t  cfgErrors;                          // [-] rejected configuration frames
+} TelemStats;
+
+extern const char *const telemSigName[TELEM_SIGNALS];
+
+void Telem_Init(void);
+int  Telem_Config(uint16_t mask, uint16_t div);
+void Telem_Command(const uint8_t *data, uint32_t len);
+void Telem_Sample(void);
+void Telem_GetStats(TelemStats *out);
+uint16_t Telem_FrameSize(uint16_t mask, uint8_t nSamp);
+
+#endif // TELEMETRY_H
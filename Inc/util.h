@@ -22,6 +22,8 @@
 #define UTIL_H
 
 #include <stdint.h>
+#include "defines.h"
+#include "exchange.h"
 
 
 // Rx Structures USART
@@ -32,6 +34,40 @@ typedef struct{
   uint16_t  checksum;
 } SerialCommand;
 
+// Rx Structure USART, protocol v2 (SERIAL_START_FRAME_V2)
+#define SERIAL_V2_MOTOR   0x01          // flags: cmd1/cmd2 are the left/right motor targets, mixerFcn is bypassed
+#define SERIAL_V2_FAST    0x02          // flags: like SERIAL_V2_MOTOR, targets go straight to the PWM interrupt (FAST_CMD_ENABLE)
+typedef struct{
+  uint16_t  start;      // SERIAL_START_FRAME_V2
+  uint8_t   version;    // SERIAL_PROTOCOL_V2
+  uint8_t   ctrlMod;    // control mode request: OPEN_MODE, VLT_MODE, SPD_MODE, TRQ_MODE -> ctrlModReq
+  uint16_t  seq;        // sequence number, echoed in the feedback
+  uint16_t  stamp;      // [ms] sender time stamp, echoed in the feedback
+  uint8_t   flags;      // SERIAL_V2_MOTOR, SERIAL_V2_FAST
+  uint8_t   reserved;
+  int16_t   cmd1;       // steer, or left motor target with SERIAL_V2_MOTOR
+  int16_t   cmd2;       // speed, or right motor target with SERIAL_V2_MOTOR
+  uint16_t  crc;        // calcCRC16 over all bytes above
+} SerialCommandV2;
+
+// State of the last accepted command, for the feedback and the main loop
+typedef struct {
+  uint8_t   ver;        // protocol of the last accepted command: 1 = legacy, 2 = v2
+  uint8_t   motorMode;  // 1 = per motor targets, mixerFcn bypassed
+  uint16_t  seq;        // sequence number of the last accepted v2 command
+  uint16_t  stamp;      // time stamp of the last accepted v2 command
+  uint32_t  rxTick;     // [ms] HAL_GetTick() when it was accepted
+  uint32_t  seqGaps;    // [-] sequence numbers missed (lost v2 commands)
+} SerialCmdState;
+
+// Rx statistics of the USART command parser
+typedef struct {
+  uint32_t  frames;     // valid frames
+  uint32_t  crcErr;     // complete frames with a wrong checksum
+  uint32_t  frameErr;   // losses of synchronisation (bytes outside a frame)
+  uint32_t  skipped;    // bytes discarded while searching the start frame
+} SerialRxStats;
+
 // Input Structure
 typedef struct {
   int16_t   raw;    // raw input
@@ -44,8 +80,15 @@ typedef struct {
   int16_t   dband;  // deadband
 } InputStruct;
 
+typedef struct {
+  uint8_t   freq;                       // buzzerFreq scale, 0 = silence
+  uint16_t  dur;                        // [buzzer periods] remaining duration
+} BeepNote;
+
 // Initialization Functions
 void BLDC_Init(void);
+void BLDC_SlowScale(uint8_t div);
+void BLDC_RateScale(uint16_t freq);
 void Input_Lim_Init(void);
 void Input_Init(void);
 void UART_DisableRxErrors(UART_HandleTypeDef *huart);
@@ -53,10 +96,14 @@ void UART_DisableRxErrors(UART_HandleTypeDef *huart);
 // General Functions
 void poweronMelody(void);
 void beepCount(uint8_t cnt, uint8_t freq, uint8_t pattern);
+uint8_t beepQueue(uint8_t freq, uint16_t ms);
+uint8_t beepBusy(void);
+void beepWait(void);
+uint8_t beepTick(uint16_t elapsed, uint8_t *freq);
 void beepLong(uint8_t freq);
 void beepShort(uint8_t freq);
 void beepShortMany(uint8_t cnt, int8_t dir);
-void calcAvgSpeed(void);
+void calcAvgSpeed(const ExchState *st);
 void adcCalibLim(void);
 void updateCurSpdLim(void);
 void standstillHold(void);
@@ -72,7 +119,8 @@ void readCommand(void);
 void usart2_rx_check(void);
 void usart3_rx_check(void);
 void usart_process_debug(uint8_t *userCommand, uint32_t len);
-void usart_process_command(SerialCommand *command_in, SerialCommand *command_out, uint8_t usart_idx);
+uint8_t usart_process_command(SerialCommand *command_in, SerialCommand *command_out, uint8_t usart_idx);
+uint8_t usart_process_command_v2(SerialCommandV2 *command_in, SerialCommand *command_out, uint8_t usart_idx);
 
 // Poweroff Functions
 void saveConfig(void);
@@ -93,5 +141,15 @@ typedef struct {
 } MultipleTap;
 void multipleTapDet(int16_t u, uint32_t timeNow, MultipleTap *x);
 
+// CRC Function
+uint16_t calcCRC16(uint16_t crc, const uint8_t *data, uint32_t len);
+
+// PWM Interrupt Functions (bldc.c)
+void    bldcClockInit(void);
+void    bldcOffsetLoad(const adc_offset_t *stored);
+uint8_t bldcOffsetGet(adc_offset_t *out);
+void    fastCmdSet(int16_t cmdL, int16_t cmdR);
+void    bldcSlowTask(void);
+
 #endif
 
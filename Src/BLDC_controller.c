@@ -18,6 +18,8 @@
  */
 
 #include "BLDC_controller.h"
+#include "BLDC_controller_spec.h"     /* build-time parameter folding, hand-written */
+#include "ramfunc.h"                   /* SRAM placement of the step, hand-written */
 
 /* Named constants for Chart: '<S5>/F03_02_Control_Mode_Manager' */
 #define IN_ACTIVE                      ((uint8_T)1U)
@@ -134,7 +136,7 @@ extern void PI_clamp_fixdt_g_Reset(DW_PI_clamp_fixdt_g *localDW);
 extern void PI_clamp_fixdt_k(int16_T rtu_err, uint16_T rtu_P, uint16_T rtu_I,
   int16_T rtu_init, int16_T rtu_satMax, int16_T rtu_satMin, int32_T
   rtu_ext_limProt, int16_T *rty_out, DW_PI_clamp_fixdt_g *localDW);
-uint8_T plook_u8s16_evencka(int16_T u, int16_T bp0, uint16_T bpSpace, uint32_T
+RAMFUNC uint8_T plook_u8s16_evencka(int16_T u, int16_T bp0, uint16_T bpSpace, uint32_T
   maxIndex)
 {
   uint8_T bpIndex;
@@ -161,7 +163,7 @@ uint8_T plook_u8s16_evencka(int16_T u, int16_T bp0, uint16_T bpSpace, uint32_T
   return bpIndex;
 }
 
-uint8_T plook_u8u16_evencka(uint16_T u, uint16_T bp0, uint16_T bpSpace, uint32_T
+RAMFUNC uint8_T plook_u8u16_evencka(uint16_T u, uint16_T bp0, uint16_T bpSpace, uint32_T
   maxIndex)
 {
   uint8_T bpIndex;
@@ -188,7 +190,7 @@ uint8_T plook_u8u16_evencka(uint16_T u, uint16_T bp0, uint16_T bpSpace, uint32_T
   return bpIndex;
 }
 
-int32_T div_nde_s32_floor(int32_T numerator, int32_T denominator)
+RAMFUNC int32_T div_nde_s32_floor(int32_T numerator, int32_T denominator)
 {
   return (((numerator < 0) != (denominator < 0)) && (numerator % denominator !=
            0) ? -1 : 0) + numerator / denominator;
@@ -202,7 +204,7 @@ void Counter_Init(DW_Counter *localDW, int16_T rtp_z_cntInit)
 }
 
 /* Output and update for atomic system: '<S13>/Counter' */
-int16_T Counter(int16_T rtu_inc, int16_T rtu_max, boolean_T rtu_rst, DW_Counter *
+RAMFUNC int16_T Counter(int16_T rtu_inc, int16_T rtu_max, boolean_T rtu_rst, DW_Counter *
                 localDW)
 {
   int16_T rtu_rst_0;
@@ -245,7 +247,7 @@ void Low_Pass_Filter_Reset(DW_Low_Pass_Filter *localDW)
 }
 
 /* Output and update for atomic system: '<S50>/Low_Pass_Filter' */
-void Low_Pass_Filter(const int16_T rtu_u[2], uint16_T rtu_coef, int16_T rty_y[2],
+RAMFUNC void Low_Pass_Filter(const int16_T rtu_u[2], uint16_T rtu_coef, int16_T rty_y[2],
                      DW_Low_Pass_Filter *localDW)
 {
   int32_T rtb_Sum3_g;
@@ -317,7 +319,7 @@ void Counter_b_Init(DW_Counter_b *localDW, uint16_T rtp_z_cntInit)
  *    '<S25>/Counter'
  *    '<S24>/Counter'
  */
-void Counter_n(uint16_T rtu_inc, uint16_T rtu_max, boolean_T rtu_rst, uint16_T
+RAMFUNC void Counter_n(uint16_T rtu_inc, uint16_T rtu_max, boolean_T rtu_rst, uint16_T
                *rty_cnt, DW_Counter_b *localDW)
 {
   uint16_T rtu_rst_0;
@@ -354,7 +356,7 @@ void Counter_n(uint16_T rtu_inc, uint16_T rtu_max, boolean_T rtu_rst, uint16_T
  *    '<S21>/either_edge'
  *    '<S20>/either_edge'
  */
-void either_edge(boolean_T rtu_u, boolean_T *rty_y, DW_either_edge *localDW)
+RAMFUNC void either_edge(boolean_T rtu_u, boolean_T *rty_y, DW_either_edge *localDW)
 {
   /* RelationalOperator: '<S26>/Relational Operator' incorporates:
    *  UnitDelay: '<S26>/UnitDelay'
@@ -388,7 +390,7 @@ void Debounce_Filter_Init(DW_Debounce_Filter *localDW)
 }
 
 /* Output and update for atomic system: '<S20>/Debounce_Filter' */
-void Debounce_Filter(boolean_T rtu_u, uint16_T rtu_tAcv, uint16_T rtu_tDeacv,
+RAMFUNC void Debounce_Filter(boolean_T rtu_u, uint16_T rtu_tAcv, uint16_T rtu_tDeacv,
                      boolean_T *rty_y, DW_Debounce_Filter *localDW)
 {
   uint16_T rtb_Sum1_n;
@@ -493,7 +495,7 @@ void I_backCalc_fixdt_Reset(DW_I_backCalc_fixdt *localDW, int32_T rtp_yInit)
  *    '<S83>/I_backCalc_fixdt1'
  *    '<S82>/I_backCalc_fixdt'
  */
-void I_backCalc_fixdt(int16_T rtu_err, uint16_T rtu_I, uint16_T rtu_Kb, int16_T
+RAMFUNC void I_backCalc_fixdt(int16_T rtu_err, uint16_T rtu_I, uint16_T rtu_Kb, int16_T
                       rtu_satMax, int16_T rtu_satMin, int16_T *rty_out,
                       DW_I_backCalc_fixdt *localDW)
 {
@@ -570,7 +572,7 @@ void PI_clamp_fixdt_Reset(DW_PI_clamp_fixdt *localDW)
 }
 
 /* Output and update for atomic system: '<S63>/PI_clamp_fixdt' */
-void PI_clamp_fixdt(int16_T rtu_err, uint16_T rtu_P, uint16_T rtu_I, int32_T
+RAMFUNC void PI_clamp_fixdt(int16_T rtu_err, uint16_T rtu_P, uint16_T rtu_I, int32_T
                     rtu_init, int16_T rtu_satMax, int16_T rtu_satMin, int32_T
                     rtu_ext_limProt, int16_T *rty_out, DW_PI_clamp_fixdt
                     *localDW)
@@ -719,7 +721,7 @@ void PI_clamp_fixdt_b_Reset(DW_PI_clamp_fixdt_m *localDW)
 }
 
 /* Output and update for atomic system: '<S61>/PI_clamp_fixdt' */
-void PI_clamp_fixdt_l(int16_T rtu_err, uint16_T rtu_P, uint16_T rtu_I, int16_T
+RAMFUNC void PI_clamp_fixdt_l(int16_T rtu_err, uint16_T rtu_P, uint16_T rtu_I, int16_T
                       rtu_init, int16_T rtu_satMax, int16_T rtu_satMin, int32_T
                       rtu_ext_limProt, int16_T *rty_out, DW_PI_clamp_fixdt_m
                       *localDW)
@@ -868,7 +870,7 @@ void PI_clamp_fixdt_g_Reset(DW_PI_clamp_fixdt_g *localDW)
 }
 
 /* Output and update for atomic system: '<S62>/PI_clamp_fixdt' */
-void PI_clamp_fixdt_k(int16_T rtu_err, uint16_T rtu_P, uint16_T rtu_I, int16_T
+RAMFUNC void PI_clamp_fixdt_k(int16_T rtu_err, uint16_T rtu_P, uint16_T rtu_I, int16_T
                       rtu_init, int16_T rtu_satMax, int16_T rtu_satMin, int32_T
                       rtu_ext_limProt, int16_T *rty_out, DW_PI_clamp_fixdt_g
                       *localDW)
@@ -999,7 +1001,7 @@ void PI_clamp_fixdt_k(int16_T rtu_err, uint16_T rtu_P, uint16_T rtu_I, int16_T
 }
 
 /* Model step function */
-void BLDC_controller_step(RT_MODEL *const rtM)
+RAMFUNC void BLDC_controller_step(RT_MODEL *const rtM)
 {
   P *rtP = ((P *) rtM->defaultParam);
   DW *rtDW = ((DW *) rtM->dwork);
@@ -1251,7 +1253,7 @@ void BLDC_controller_step(RT_MODEL *const rtM)
    *  Logic: '<S13>/Logical Operator2'
    *  Relay: '<S13>/n_commDeacv'
    */
-  rtb_LogicalOperator = (rtP->b_angleMeasEna || (rtDW->n_commDeacv_Mode &&
+  rtb_LogicalOperator = (BLDC_P_ANGLE_MEAS_ENA(rtP) || (rtDW->n_commDeacv_Mode &&
     (!rtDW->dz_cntTrnsDet)));
 
   /* UnitDelay: '<S2>/UnitDelay2' */
@@ -1296,7 +1298,7 @@ void BLDC_controller_step(RT_MODEL *const rtM)
   /* If: '<S3>/If1' incorporates:
    *  Constant: '<S3>/b_angleMeasEna'
    */
-  if (!rtP->b_angleMeasEna) {
+  if (!BLDC_P_ANGLE_MEAS_ENA(rtP)) {
     /* Outputs for IfAction SubSystem: '<S3>/F01_05_Electrical_Angle_Estimation' incorporates:
      *  ActionPort: '<S14>/Action Port'
      */
@@ -1399,7 +1401,7 @@ void BLDC_controller_step(RT_MODEL *const rtM)
    */
   rtb_Sum2_h = rtDW->If1_ActiveSubsystem;
   UnitDelay3 = -1;
-  if (rtP->z_ctrlTypSel == 2) {
+  if (BLDC_P_CTRL_TYP(rtP) == 2) {
     UnitDelay3 = 0;
   }
 
@@ -1670,7 +1672,7 @@ void BLDC_controller_step(RT_MODEL *const rtM)
      *  Constant: '<S4>/b_diagEna'
      *  RelationalOperator: '<S20>/Relational Operator2'
      */
-    if (rtP->b_diagEna) {
+    if (BLDC_P_DIAG_ENA(rtP)) {
       /* Outputs for IfAction SubSystem: '<S4>/Diagnostics_Enabled' incorporates:
        *  ActionPort: '<S20>/Action Port'
        */
@@ -1721,8 +1723,8 @@ void BLDC_controller_step(RT_MODEL *const rtM)
         + (rtb_RelationalOperator1_mv << 2));
 
       /* Outputs for Atomic SubSystem: '<S20>/Debounce_Filter' */
-      Debounce_Filter(rtb_a_elecAngle_XA_g != 0, rtP->t_errQual,
-                      rtP->t_errDequal, &rtDW->Merge_p, &rtDW->Debounce_Filter_k);
+      Debounce_Filter(rtb_a_elecAngle_XA_g != 0, BLDC_P_ERR_QUAL(rtP),
+                      BLDC_P_ERR_DEQUAL(rtP), &rtDW->Merge_p, &rtDW->Debounce_Filter_k);
 
       /* End of Outputs for SubSystem: '<S20>/Debounce_Filter' */
 
@@ -1778,7 +1780,7 @@ void BLDC_controller_step(RT_MODEL *const rtM)
      *  Inport: '<Root>/z_ctrlModReq'
      *  RelationalOperator: '<S31>/Relational Operator1'
      */
-    rtb_LogicalOperator1_j = ((rtU->z_ctrlModReq == 2) || rtP->b_cruiseCtrlEna);
+    rtb_LogicalOperator1_j = ((rtU->z_ctrlModReq == 2) || BLDC_P_CRUISE_ENA(rtP));
 
     /* Logic: '<S31>/Logical Operator2' incorporates:
      *  Constant: '<S1>/b_cruiseCtrlEna'
@@ -1787,7 +1789,7 @@ void BLDC_controller_step(RT_MODEL *const rtM)
      *  Logic: '<S31>/Logical Operator5'
      *  RelationalOperator: '<S31>/Relational Operator4'
      */
-    rtb_LogicalOperator2_p = ((rtU->z_ctrlModReq == 3) && (!rtP->b_cruiseCtrlEna));
+    rtb_LogicalOperator2_p = ((rtU->z_ctrlModReq == 3) && (!BLDC_P_CRUISE_ENA(rtP)));
 
     /* Chart: '<S5>/F03_02_Control_Mode_Manager' incorporates:
      *  Constant: '<S31>/constant5'
@@ -1879,7 +1881,7 @@ void BLDC_controller_step(RT_MODEL *const rtM)
      *  Inport: '<S34>/r_inpTgt'
      *  Saturate: '<S33>/Saturation'
      */
-    if (rtP->z_ctrlTypSel == 2) {
+    if (BLDC_P_CTRL_TYP(rtP) == 2) {
       /* Outputs for IfAction SubSystem: '<S33>/FOC_Control_Type' incorporates:
        *  ActionPort: '<S36>/Action Port'
        */
@@ -2087,7 +2089,7 @@ void BLDC_controller_step(RT_MODEL *const rtM)
     /* If: '<S6>/If3' incorporates:
      *  Constant: '<S6>/b_fieldWeakEna'
      */
-    if (rtP->b_fieldWeakEna) {
+    if (BLDC_P_FIELD_WEAK_ENA(rtP)) {
       /* Outputs for IfAction SubSystem: '<S6>/Field_Weakening_Enabled' incorporates:
        *  ActionPort: '<S42>/Action Port'
        */
@@ -2185,7 +2187,7 @@ void BLDC_controller_step(RT_MODEL *const rtM)
        *  Constant: '<S42>/id_fieldWeakMax'
        *  RelationalOperator: '<S42>/Relational Operator1'
        */
-      if (rtP->z_ctrlTypSel == 2) {
+      if (BLDC_P_CTRL_TYP(rtP) == 2) {
         rtb_Saturation1 = rtP->id_fieldWeakMax;
       } else {
         rtb_Saturation1 = rtP->a_phaAdvMax;
@@ -2210,7 +2212,7 @@ void BLDC_controller_step(RT_MODEL *const rtM)
      */
     rtb_Sum2_h = rtDW->If1_ActiveSubsystem_o;
     UnitDelay3 = -1;
-    if (rtP->z_ctrlTypSel == 2) {
+    if (BLDC_P_CTRL_TYP(rtP) == 2) {
       UnitDelay3 = 0;
     }
 
@@ -2432,7 +2434,7 @@ void BLDC_controller_step(RT_MODEL *const rtM)
        */
       rtb_Sum2_h = rtDW->If1_ActiveSubsystem_j;
       UnitDelay3 = -1;
-      if (rtP->z_ctrlTypSel == 2) {
+      if (BLDC_P_CTRL_TYP(rtP) == 2) {
         UnitDelay3 = 0;
       }
 
@@ -2558,7 +2560,7 @@ void BLDC_controller_step(RT_MODEL *const rtM)
            *  Logic: '<S61>/Logical Operator1'
            *  RelationalOperator: '<S61>/Relational Operator3'
            */
-          if (rtP->b_cruiseCtrlEna && (rtb_Saturation != 0)) {
+          if (BLDC_P_CRUISE_ENA(rtP) && (rtb_Saturation != 0)) {
             /* Switch: '<S61>/Switch3' incorporates:
              *  MinMax: '<S61>/MinMax4'
              */
@@ -2595,7 +2597,7 @@ void BLDC_controller_step(RT_MODEL *const rtM)
           /* Switch: '<S61>/Switch2' incorporates:
            *  Constant: '<S1>/b_cruiseCtrlEna'
            */
-          if (!rtP->b_cruiseCtrlEna) {
+          if (!BLDC_P_CRUISE_ENA(rtP)) {
             rtb_Saturation = rtDW->Merge1;
           }
 
@@ -2809,7 +2811,7 @@ void BLDC_controller_step(RT_MODEL *const rtM)
    */
   rtb_Sum2_h = rtDW->If2_ActiveSubsystem;
   UnitDelay3 = -1;
-  if (rtP->z_ctrlTypSel == 2) {
+  if (BLDC_P_CTRL_TYP(rtP) == 2) {
     rtb_Saturation = rtDW->Merge;
     UnitDelay3 = 0;
   } else {
@@ -3007,7 +3009,7 @@ void BLDC_controller_step(RT_MODEL *const rtM)
    * About '<S94>/z_commutMap_M1':
    *  2-dimensional Direct Look-Up returning a Column
    */
-  if (rtb_LogicalOperator && (rtP->z_ctrlTypSel == 2)) {
+  if (rtb_LogicalOperator && (BLDC_P_CTRL_TYP(rtP) == 2)) {
     /* Outputs for IfAction SubSystem: '<S8>/FOC_Method' incorporates:
      *  ActionPort: '<S95>/Action Port'
      */
@@ -3016,7 +3018,7 @@ void BLDC_controller_step(RT_MODEL *const rtM)
     rtb_Merge1 = rtDW->Gain4_e[2];
 
     /* End of Outputs for SubSystem: '<S8>/FOC_Method' */
-  } else if (rtb_LogicalOperator && (rtP->z_ctrlTypSel == 1)) {
+  } else if (rtb_LogicalOperator && (BLDC_P_CTRL_TYP(rtP) == 1)) {
     /* Outputs for IfAction SubSystem: '<S8>/SIN_Method' incorporates:
      *  ActionPort: '<S96>/Action Port'
      */
@@ -3026,7 +3028,7 @@ void BLDC_controller_step(RT_MODEL *const rtM)
      *  Product: '<S98>/Divide3'
      *  Sum: '<S98>/Sum3'
      */
-    if (rtP->b_fieldWeakEna) {
+    if (BLDC_P_FIELD_WEAK_ENA(rtP)) {
       /* Sum: '<S97>/Sum3' incorporates:
        *  Product: '<S97>/Product2'
        */
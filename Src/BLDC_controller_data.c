@@ -18,9 +18,10 @@
  */
 
 #include "BLDC_controller.h"
+#include "ramfunc.h"                   /* SRAM placement of the tables, hand-written */
 
 /* Constant parameters (auto storage) */
-const ConstP rtConstP = {
+RAMDATA const ConstP rtConstP = {
   /* Computed Parameter: r_sin_M1_Table
    * Referenced by: '<S52>/r_sin_M1'
    */
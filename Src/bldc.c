@@ -27,10 +27,15 @@
 #include "setup.h"
 #include "config.h"
 #include "util.h"
+#include "profiler.h"
+#include "telemetry.h"
+#include "exchange.h"
+#include "ramfunc.h"
 
 // Matlab includes and defines - from auto-code generation
 // ###############################################################################
 #include "BLDC_controller.h"           /* Model's header file */
+#include "BLDC_controller_mr.h"        /* multi-rate partition */
 #include "rtwtypes.h"
 
 extern RT_MODEL *const rtM_Left;
@@ -44,64 +49,351 @@ extern P    rtP_Left;
 extern DW   rtDW_Right;                 /* Observable states */
 extern ExtU rtU_Right;                  /* External inputs */
 extern ExtY rtY_Right;                  /* External outputs */
+extern P    rtP_Right;
+
+#ifdef BLDC_MULTIRATE
+extern SlowPart slowLeft;               /* Slow partition of the controllers, run by PendSV_Handler */
+extern SlowPart slowRight;
+#endif
 // ###############################################################################
 
 static int16_t pwm_margin;              /* This margin allows to have a window in the PWM signal for proper FOC Phase currents measurement */
 
-extern uint8_t ctrlModReq;
 static int16_t curDC_max = (I_DC_MAX * A2BIT_CONV);
 int16_t curL_phaA = 0, curL_phaB = 0, curL_DC = 0;
 int16_t curR_phaB = 0, curR_phaC = 0, curR_DC = 0;
-
-volatile int pwml = 0;
+volatile uint16_t ocTripCntL = 0;       // [-] DC link overcurrent trips of the left bridge (periods without a trip before), any source, wraps
+volatile uint16_t ocTripCntR = 0;       // [-] same for the right bridge
+volatile uint16_t ocTripPerL = 0;       // [control periods] with the left bridge switched off for DC link overcurrent, wraps
+volatile uint16_t ocTripPerR = 0;       // [control periods] same for the right bridge
+static uint8_t    ocPrevL    = 0;       // trip in the previous control period
+static uint8_t    ocPrevR    = 0;
+#ifdef OC_TRIP_AWD
+static volatile uint8_t ocTripAwdL = 0; // analog watchdog trip since the last control period
+static volatile uint8_t ocTripAwdR = 0;
+#endif
+
+volatile int pwml = 0;                  // main loop targets, handed over with exchSetpoint
 volatile int pwmr = 0;
 
+static ExchSetpoint isrSetpoint;        // consistent copy of the main loop setpoint for this period
+static ExchState    isrState;           // control step results, published to the main loop
+
 extern volatile adc_buf_t adc_buffer;
 
 uint8_t buzzerFreq          = 0;
 uint8_t buzzerPattern       = 0;
 uint8_t buzzerCount         = 0;
-volatile uint32_t buzzerTimer = 0;
+volatile uint32_t buzzerTimer = 0;     // [control periods] time base, advanced by the PWM interrupt
 static uint8_t  buzzerPrev  = 0;
 static uint8_t  buzzerIdx   = 0;
+static uint8_t  buzzerNote  = 0;        // a queued note played in the last period
+static uint8_t  buzzerSlot  = 0;        // pattern slot, sounds in slot 0 of buzzerPattern + 1
+static uint16_t buzzerSlotTick = 0;     // [buzzer periods] elapsed in the current slot
+static uint16_t buzzerPerRun  = BUZZER_TIM_IDLE;  // [buzzer periods] timer period running now
+static uint16_t buzzerPerNext = BUZZER_TIM_IDLE;  // [buzzer periods] timer period loaded for the next update
 
 uint8_t        enable       = 0;        // initially motors are disabled for SAFETY
 static uint8_t enableFin    = 0;
 
-static const uint16_t pwm_res  = 64000000 / 2 / PWM_FREQ; // = 2000
+static uint16_t pwm_res        = 64000000 / 2 / PWM_FREQ; // [timer ticks] half PWM period, 2000 at 64 MHz, set for the active core clock by bldcClockInit()
+static int32_t  pwm_scale      = 1L << 16;  // [Q16] pwm_res / BLDC_GEN_PWM_RES, exact 1.0 at 64 MHz and 1.6875 at 108 MHz
+static int16_t  pwm_marginFoc  = 110;  // [timer ticks] FOC current sampling window: 1.7 us
+static uint16_t isrLatencyLim  = 64000000 / CTRL_FREQ * 39 / 40;  // [timer ticks] ISR_LATENCY_MAX at the active core clock
 
-static uint16_t offsetcount = 0;
+static uint16_t offsetcount  = 0;
+static uint16_t offsetTarget = ADC_OFFSET_CAL;  // [control periods] samples of the running offset measurement
 static int16_t offsetrlA    = 2000;
 static int16_t offsetrlB    = 2000;
 static int16_t offsetrrB    = 2000;
 static int16_t offsetrrC    = 2000;
 static int16_t offsetdcl    = 2000;
 static int16_t offsetdcr    = 2000;
+static struct { int32_t rlA, rlB, rrB, rrC, dcl, dcr; } offsetSum;     // sums of the offset measurement
+static struct { int32_t rlA, rlB, rrB, rrC, dcl, dcr; } offsetFixdt;   // drift tracking filter states, fixdt(1,32,16)
+static adc_offset_t offsetStored;                                      // from EEPROM, see bldcOffsetLoad()
+volatile uint8_t    offsetSrc     = OFFSET_NONE;                       // OFFSET_CAL or OFFSET_STORED once the offsets are ready
+volatile uint32_t   bootReadyTick = 0;                                 // [ms] HAL tick at the controller start
 
 int16_t        batVoltage       = (400 * BAT_CELLS * BAT_CALIB_ADC) / BAT_CALIB_REAL_VOLTAGE;
 static int32_t batVoltageFixdt  = (400 * BAT_CELLS * BAT_CALIB_ADC) / BAT_CALIB_REAL_VOLTAGE << 16;  // Fixed-point filter output initialized at 400 V*100/cell = 4 V/cell converted to fixed-point
 
+volatile uint32_t isrOverrunCnt = 0;    // control periods in which the control step finished after the next ADC sample was ready (late or dropped cycle)
+volatile uint16_t isrLatencyMax = 0;    // [timer ticks] worst-case ISR completion time after the control period start. 1 tick = 1 core cycle, period = 2 * pwm_res * PWM_CTRL_DIV
+volatile uint16_t isrDegradeCnt = 0;    // [control periods] remaining time in degraded mode, 0 = normal operation
+#if defined(ISR_DEGRADE_DIAG) && !defined(BLDC_MULTIRATE)
+uint8_t bldcDiagDiv = 1;                // degraded mode diagnostics for the next step, see BLDC_controller_spec.h
+#endif
+static uint16_t   isrPhaseTrig  = 0;    // [timer ticks] PWM period phase of the ADC trigger
+static uint16_t   isrTrigLead   = 0;    // [timer ticks] lead of LEFT_TIM over the timer of the ADC trigger, PWM_PHASE_SHIFT: TIM1
+#if PWM_CTRL_DIV > 1
+static volatile uint32_t isrEntryStamp; // [timer ticks] isrTimeNow() at the ISR entry
+static volatile uint32_t isrEntryTick;  // SysTick->VAL at the ISR entry
+#endif
+
+#define CTRL_TICKS          (2 * pwm_res * PWM_CTRL_DIV)  // [timer ticks] control period
+
+// PWM interrupt: end of the injected current conversions or end of the regular scan DMA transfer
+#ifdef ADC_INJ_ENABLE
+  #define PWM_IRQHandler      ADC1_2_IRQHandler
+  #define PWM_IRQ_PENDING()   (ADC1->SR & ADC_SR_JEOC)
+#else
+  #define PWM_IRQHandler      DMA1_Channel1_IRQHandler
+  #define PWM_IRQ_PENDING()   (DMA1->ISR & DMA_ISR_TCIF1)
+#endif
+
+// Position of the LEFT_TIM center-aligned counter within one PWM period: [0, 2 * pwm_res)
+static inline uint16_t isrPhase(void) {
+  uint16_t cnt = (uint16_t)LEFT_TIM->CNT;
+  return (LEFT_TIM->CR1 & TIM_CR1_DIR) ? (uint16_t)(2 * pwm_res - cnt) : cnt;
+}
+
+// Phase within the PWM period after the ADC trigger: [0, 2 * pwm_res)
+static inline uint16_t isrTrigPhase(void) {
+  return (uint16_t)((isrPhase() + 2 * pwm_res - isrPhaseTrig) % (2 * pwm_res));
+}
+
+#if PWM_CTRL_DIV > 1
+// [timer ticks] since the last ISR entry. The PWM counter wraps PWM_CTRL_DIV times per control period,
+// SysTick (HCLK = timer clock, 1 ms reload) does not
+static inline uint32_t isrSinceEntry(void) {
+  uint32_t load = SysTick->LOAD + 1;
+  return (isrEntryTick + load - SysTick->VAL) % load;
+}
+#endif
+
+#ifdef FAST_CMD_ENABLE
+static volatile uint32_t fastCmdLR;                      // targets of the last fast command, direction already applied: left in the low, right in the high half
+static volatile uint16_t fastCmdAge = FAST_CMD_TIMEOUT;   // [control periods] since the last fast command
+static volatile uint8_t  fastCmdNew = 0;                  // 1 = not yet used by a control step
+static volatile uint32_t fastCmdStamp;                    // [timer ticks] isrTimeNow() when the command was accepted
+static int32_t           fastRateL, fastRateR;            // rate limited targets, fixdt(1,32,14)
+volatile uint16_t        fastCmdLat    = 0;               // [timer ticks] last latency from command accept to control step
+volatile uint16_t        fastCmdLatMax = 0;               // [timer ticks] worst-case latency
+volatile uint32_t        fastCmdCnt    = 0;               // [-] fast commands used by a control step
+
+/*
+ * Time base for latency measurements: [timer ticks] since power on (wraps after 67 s at 64 MHz, 40 s at 108 MHz).
+ * Control periods counted by the interrupt plus the phase after the ADC trigger. Also valid
+ * from other interrupts: a period whose interrupt is still pending is counted.
+ * With PWM_CTRL_DIV > 1: the time of the last ISR entry plus the SysTick time since then.
+ */
+RAMFUNC static uint32_t isrTimeNow(void) {
+  #if PWM_CTRL_DIV > 1
+  uint32_t stamp, since;
+  do {                                  // the PWM interrupt may renew the entry in between
+    stamp = isrEntryStamp;
+    since = isrSinceEntry();
+  } while (stamp != isrEntryStamp);
+  return stamp + since;
+  #else
+  uint32_t periods = buzzerTimer;
+  uint16_t phase   = isrTrigPhase();
+  if (PWM_IRQ_PENDING() && phase < pwm_res) {   // triggered before the phase was read, interrupt not yet served
+    periods++;
+  }
+  return periods * CTRL_TICKS + phase;
+  #endif
+}
+
+/*
+ * Fast command path: set the motor targets for the next control step, bypassing the main loop.
+ * Called by the serial command parser (interrupt context) for accepted SERIAL_V2_FAST frames.
+ */
+void fastCmdSet(int16_t cmdL, int16_t cmdR) {
+  fastCmdStamp = isrTimeNow();
+  fastCmdLR    = (uint16_t)cmdL | ((uint32_t)(uint16_t)cmdR << 16);   // one store: the interrupt never sees a left/right pair of two frames
+  fastCmdNew   = 1;
+  fastCmdAge   = 0;
+}
+
+#if FAST_CMD_RATE < 1
+  #error FAST_CMD_RATE is 0: RATE too small for DELAY_IN_MAIN_LOOP * CTRL_FREQ
+#endif
+
+/*
+ * rateLimiter16() at the control rate: rate and output in fixdt(1,32,14), see FAST_CMD_RATE
+ */
+RAMFUNC static inline void fastRateLimit(int16_t u, int32_t *y) {
+  int32_t d = ((int32_t)u << 14) - *y;
+  *y += CLAMP(d, -FAST_CMD_RATE, FAST_CMD_RATE);
+}
+#endif
+
+#ifdef OC_TRIP_AWD
+/*
+ * Analog watchdog window around the DC link offsets: ABS(curX_DC) > curDC_max trips right after the conversion
+ */
+static void ocTripWindow(void) {
+  ADC1->HTR = (uint32_t)CLAMP(offsetdcr + curDC_max, 0, 0xFFF);   // ADC1: right DC link current
+  ADC1->LTR = (uint32_t)CLAMP(offsetdcr - curDC_max, 0, 0xFFF);
+  ADC2->HTR = (uint32_t)CLAMP(offsetdcl + curDC_max, 0, 0xFFF);   // ADC2: left DC link current
+  ADC2->LTR = (uint32_t)CLAMP(offsetdcl - curDC_max, 0, 0xFFF);
+}
+
+/*
+ * Analog watchdog trip: bridge off now, the next control period counts the trip and switches it on again below the limit
+ */
+RAMFUNC static inline void ocTripAwd(void) {
+  if (ADC1->SR & ADC_SR_AWD) {
+    RIGHT_TIM->BDTR &= ~TIM_BDTR_MOE;
+    ADC1->SR   = ~ADC_SR_AWD;
+    ocTripAwdR = 1;
+  }
+  if (ADC2->SR & ADC_SR_AWD) {
+    LEFT_TIM->BDTR &= ~TIM_BDTR_MOE;
+    ADC2->SR   = ~ADC_SR_AWD;
+    ocTripAwdL = 1;
+  }
+}
+
+#ifndef ADC_INJ_ENABLE
+RAMFUNC void ADC1_2_IRQHandler(void) {
+  ocTripAwd();
+}
+#endif
+#endif
+
+/*
+ * Timer based constants for the core clock selected by SystemClock_Config(), see CLOCK PROFILE in config.h.
+ * Called before the timers start.
+ */
+void bldcClockInit(void) {
+  pwm_res       = (uint16_t)(SystemCoreClock / 2 / PWM_FREQ);
+  pwm_scale     = ((int32_t)pwm_res << 16) / BLDC_GEN_PWM_RES;
+  pwm_marginFoc = (int16_t)(110 * (SystemCoreClock / 1000000) / 64);
+  isrLatencyLim = (uint16_t)ISR_LATENCY_MAX;
+  #if PWM_PHASE_SHIFT > 0
+  isrTrigLead   = (uint16_t)PWM_LEFT_LEAD(pwm_res, PWM_PHASE_SHIFT);
+  #endif
+}
+
+/*
+ * Stored offsets for the fast boot, called before the ADC is started. With FAST_BOOT_ENABLE the PWM interrupt
+ * first measures a short burst and uses the stored offsets if the burst confirms them.
+ */
+void bldcOffsetLoad(const adc_offset_t *stored) {
+  offsetStored = *stored;
+  #ifdef FAST_BOOT_ENABLE
+  offsetTarget = ADC_OFFSET_BURST;
+  #endif
+}
+
+/*
+ * Current offsets, returns the source: OFFSET_NONE while they are measured
+ */
+uint8_t bldcOffsetGet(adc_offset_t *out) {
+  __disable_irq();
+  out->rlA = offsetrlA;
+  out->rlB = offsetrlB;
+  out->rrB = offsetrrB;
+  out->rrC = offsetrrC;
+  out->dcl = offsetdcl;
+  out->dcr = offsetdcr;
+  __enable_irq();
+  return offsetSrc;
+}
+
+/*
+ * End of an offset measurement in the PWM interrupt: the mean of the samples, or the stored offsets when the
+ * fast boot burst confirms them. A burst that does not confirm them is extended to the full measurement.
+ */
+static void offsetDone(void) {
+  int16_t rlA = (int16_t)(offsetSum.rlA / offsetcount);
+  int16_t rlB = (int16_t)(offsetSum.rlB / offsetcount);
+  int16_t rrB = (int16_t)(offsetSum.rrB / offsetcount);
+  int16_t rrC = (int16_t)(offsetSum.rrC / offsetcount);
+  int16_t dcl = (int16_t)(offsetSum.dcl / offsetcount);
+  int16_t dcr = (int16_t)(offsetSum.dcr / offsetcount);
+
+  if (offsetTarget < ADC_OFFSET_CAL) {
+    if (ABS(rlA - offsetStored.rlA) > ADC_OFFSET_TOL || ABS(rlB - offsetStored.rlB) > ADC_OFFSET_TOL ||
+        ABS(rrB - offsetStored.rrB) > ADC_OFFSET_TOL || ABS(rrC - offsetStored.rrC) > ADC_OFFSET_TOL ||
+        ABS(dcl - offsetStored.dcl) > ADC_OFFSET_TOL || ABS(dcr - offsetStored.dcr) > ADC_OFFSET_TOL) {
+      offsetTarget = ADC_OFFSET_CAL;    // keep the sums, the burst is part of the full measurement
+      return;
+    }
+    offsetrlA = offsetStored.rlA;  offsetrlB = offsetStored.rlB;
+    offsetrrB = offsetStored.rrB;  offsetrrC = offsetStored.rrC;
+    offsetdcl = offsetStored.dcl;  offsetdcr = offsetStored.dcr;
+    offsetSrc = OFFSET_STORED;
+  } else {
+    offsetrlA = rlA;  offsetrlB = rlB;
+    offsetrrB = rrB;  offsetrrC = rrC;
+    offsetdcl = dcl;  offsetdcr = dcr;
+    offsetSrc = OFFSET_CAL;
+  }
+
+  offsetFixdt.rlA = offsetrlA << 16;  offsetFixdt.rlB = offsetrlB << 16;
+  offsetFixdt.rrB = offsetrrB << 16;  offsetFixdt.rrC = offsetrrC << 16;
+  offsetFixdt.dcl = offsetdcl << 16;  offsetFixdt.dcr = offsetdcr << 16;
+  // Nothing else is running yet: the ISR starts right after the trigger, at a half period of the triggering timer
+  uint16_t trigTimPhase = (uint16_t)((isrPhase() + 2 * pwm_res - isrTrigLead) % (2 * pwm_res));
+  isrPhaseTrig  = (uint16_t)(((trigTimPhase < pwm_res ? 0 : pwm_res) + isrTrigLead) % (2 * pwm_res));
+  #ifdef OC_TRIP_AWD
+  ocTripWindow();
+  #endif
+  bootReadyTick = HAL_GetTick();
+}
+
 // =================================
-// DMA interrupt frequency =~ 16 kHz
+// PWM interrupt frequency = CTRL_FREQ =~ 16 kHz
 // =================================
-void DMA1_Channel1_IRQHandler(void) {
+RAMFUNC void PWM_IRQHandler(void) {
 
+  #if defined(ADC_INJ_ENABLE) && defined(OC_TRIP_AWD)
+  ocTripAwd();                          // same interrupt line as the end of the injected group
+  if (!(ADC1->SR & ADC_SR_JEOC)) {
+    return;
+  }
+  #endif
+  PROF_START(PROF_ISR);
+  #if PWM_CTRL_DIV > 1
+  isrEntryTick  = SysTick->VAL;
+  isrEntryStamp = buzzerTimer * CTRL_TICKS + isrTrigPhase();  // the ISR starts in the first PWM period of the control period
+  #endif
+  #ifdef ADC_INJ_ENABLE
+  ADC1->SR = ~ADC_SR_JEOC;
+  #if PWM_PHASE_SHIFT > 0
+  adc_buffer.dcr = (uint16_t)ADC1->JDR1;  // right bridge, sampled just now
+  adc_buffer.rrB = (uint16_t)ADC1->JDR2;
+  adc_buffer.rrC = (uint16_t)ADC1->JDR3;
+  adc_buffer.dcl = (uint16_t)ADC2->JDR1;  // left bridge, sampled PWM_LEFT_LEAD earlier at the top of LEFT_TIM
+  adc_buffer.rlA = (uint16_t)ADC2->JDR2;
+  adc_buffer.rlB = (uint16_t)ADC2->JDR3;
+  #else
+  adc_buffer.dcr = (uint16_t)ADC1->JDR1;
+  adc_buffer.rlA = (uint16_t)ADC1->JDR2;
+  adc_buffer.rrB = (uint16_t)ADC1->JDR3;
+  adc_buffer.dcl = (uint16_t)ADC2->JDR1;
+  adc_buffer.rlB = (uint16_t)ADC2->JDR2;
+  adc_buffer.rrC = (uint16_t)ADC2->JDR3;
+  #endif
+  if (buzzerTimer % ADC_SLOW_DIV == 0) {
+    ADC1->CR2 |= ADC_CR2_SWSTART;       // slow scan (battery, temperature, analog inputs) until the next injected trigger
+  }
+  #else
   DMA1->IFCR = DMA_IFCR_CTCIF1;
+  #endif
   // HAL_GPIO_WritePin(LED_PORT, LED_PIN, 1);
   // HAL_GPIO_TogglePin(LED_PORT, LED_PIN);
 
-  if(offsetcount < 2000) {  // calibrate ADC offsets
+  if(offsetcount < offsetTarget) {  // measure ADC offsets: mean of offsetTarget samples
     offsetcount++;
-    offsetrlA = (adc_buffer.rlA + offsetrlA) / 2;
-    offsetrlB = (adc_buffer.rlB + offsetrlB) / 2;
-    offsetrrB = (adc_buffer.rrB + offsetrrB) / 2;
-    offsetrrC = (adc_buffer.rrC + offsetrrC) / 2;
-    offsetdcl = (adc_buffer.dcl + offsetdcl) / 2;
-    offsetdcr = (adc_buffer.dcr + offsetdcr) / 2;
+    offsetSum.rlA += adc_buffer.rlA;
+    offsetSum.rlB += adc_buffer.rlB;
+    offsetSum.rrB += adc_buffer.rrB;
+    offsetSum.rrC += adc_buffer.rrC;
+    offsetSum.dcl += adc_buffer.dcl;
+    offsetSum.dcr += adc_buffer.dcr;
+    if (offsetcount == offsetTarget) {
+      offsetDone();
+    }
     return;
   }
 
-  if (buzzerTimer % 1000 == 0) {  // Filter battery voltage at a slower sampling rate
+  PROF_START(PROF_IO);
+  if (buzzerTimer % (CTRL_FREQ / 16) == 0) {  // Filter battery voltage at a slower sampling rate: 16 Hz
     filtLowPass32(adc_buffer.batt1, BAT_FILT_COEF, &batVoltageFixdt);
     batVoltage = (int16_t)(batVoltageFixdt >> 16);  // convert fixed-point to integer
   }
@@ -118,38 +410,70 @@ void DMA1_Channel1_IRQHandler(void) {
 
   // Disable PWM when current limit is reached (current chopping)
   // This is the Level 2 of current protection. The Level 1 should kick in first given by I_MOT_MAX
-  if(ABS(curL_DC) > curDC_max || enable == 0) {
+  // A hardware trip (OC_TRIP_AWD, OC_TRIP_BKIN) has already switched the bridge off, this is its fallback and re-enable
+  uint8_t ocL = ABS(curL_DC) > curDC_max;
+  uint8_t ocR = ABS(curR_DC) > curDC_max;
+  #ifdef OC_TRIP_AWD
+  ocL |= ocTripAwdL;  ocTripAwdL = 0;
+  ocR |= ocTripAwdR;  ocTripAwdR = 0;
+  #endif
+  #ifdef OC_TRIP_BKIN
+  if (LEFT_TIM->SR & TIM_SR_BIF) {      // break flag, MOE cleared by the break input
+    LEFT_TIM->SR = ~TIM_SR_BIF;
+    ocL = 1;
+  }
+  if (RIGHT_TIM->SR & TIM_SR_BIF) {
+    RIGHT_TIM->SR = ~TIM_SR_BIF;
+    ocR = 1;
+  }
+  #endif
+  ocTripCntL += ocL & !ocPrevL;         // a trip lasting several periods is one event
+  ocTripCntR += ocR & !ocPrevR;
+  ocTripPerL += ocL;
+  ocTripPerR += ocR;
+  ocPrevL     = ocL;
+  ocPrevR     = ocR;
+
+  if(ocL || enable == 0) {
     LEFT_TIM->BDTR &= ~TIM_BDTR_MOE;
   } else {
     LEFT_TIM->BDTR |= TIM_BDTR_MOE;
   }
 
-  if(ABS(curR_DC)  > curDC_max || enable == 0) {
+  if(ocR || enable == 0) {
     RIGHT_TIM->BDTR &= ~TIM_BDTR_MOE;
   } else {
     RIGHT_TIM->BDTR |= TIM_BDTR_MOE;
   }
 
-  // Create square wave for buzzer
-  buzzerTimer++;
-  if (buzzerFreq != 0 && (buzzerTimer / 5000) % (buzzerPattern + 1) == 0) {
-    if (buzzerPrev == 0) {
-      buzzerPrev = 1;
-      if (++buzzerIdx > (buzzerCount + 2)) {    // pause 2 periods
-        buzzerIdx = 1;
-      }
-    }
-    if (buzzerTimer % buzzerFreq == 0 && (buzzerIdx <= buzzerCount || buzzerCount == 0)) {
-      HAL_GPIO_TogglePin(BUZZER_PORT, BUZZER_PIN);
-    }
-  } else if (buzzerPrev) {
-      HAL_GPIO_WritePin(BUZZER_PORT, BUZZER_PIN, GPIO_PIN_RESET);
-      buzzerPrev = 0;
+  #ifdef ADC_OFFSET_TRACK
+  // Follow the offset drift while no current can flow: bridges off, motors (nearly) standing still
+  if (enable == 0 && buzzerTimer % (CTRL_FREQ / 1000) == 0 &&
+      ABS(rtY_Left.n_mot) < ADC_OFFSET_TRACK_NMAX && ABS(rtY_Right.n_mot) < ADC_OFFSET_TRACK_NMAX) {
+    filtLowPass32(adc_buffer.rlA, ADC_OFFSET_TRACK_COEF, &offsetFixdt.rlA);
+    filtLowPass32(adc_buffer.rlB, ADC_OFFSET_TRACK_COEF, &offsetFixdt.rlB);
+    filtLowPass32(adc_buffer.rrB, ADC_OFFSET_TRACK_COEF, &offsetFixdt.rrB);
+    filtLowPass32(adc_buffer.rrC, ADC_OFFSET_TRACK_COEF, &offsetFixdt.rrC);
+    filtLowPass32(adc_buffer.dcl, ADC_OFFSET_TRACK_COEF, &offsetFixdt.dcl);
+    filtLowPass32(adc_buffer.dcr, ADC_OFFSET_TRACK_COEF, &offsetFixdt.dcr);
+    offsetrlA = (int16_t)(offsetFixdt.rlA >> 16);
+    offsetrlB = (int16_t)(offsetFixdt.rlB >> 16);
+    offsetrrB = (int16_t)(offsetFixdt.rrB >> 16);
+    offsetrrC = (int16_t)(offsetFixdt.rrC >> 16);
+    offsetdcl = (int16_t)(offsetFixdt.dcl >> 16);
+    offsetdcr = (int16_t)(offsetFixdt.dcr >> 16);
+    #ifdef OC_TRIP_AWD
+    ocTripWindow();
+    #endif
   }
+  #endif
+  PROF_STOP(PROF_IO);
+
+  buzzerTimer++;                        // time base of the main loop scheduler and the buzzer timer
 
   // Adjust pwm_margin depending on the selected Control Type
   if (rtP_Left.z_ctrlTypSel == FOC_CTRL) {
-    pwm_margin = 110;
+    pwm_margin = pwm_marginFoc;
   } else {
     pwm_margin = 0;
   }
@@ -158,16 +482,43 @@ void DMA1_Channel1_IRQHandler(void) {
 
   int ul, vl, wl;
   int ur, vr, wr;
-  static boolean_T OverrunFlag = false;
 
-  /* Check for overrun */
-  if (OverrunFlag) {
-    return;
+  /* Take the latest complete setpoint of the main loop, never a half-written one */
+  Exch_Read(&exchSetpoint, &isrSetpoint);
+
+  /* Make sure to stop BOTH motors in case of an error. Clearing the global enable stops the motors at once */
+  enableFin = enable && isrSetpoint.enable && !rtY_Left.z_errCode && !rtY_Right.z_errCode;
+
+  /* Motor targets: main loop setpoint or fast command path */
+  int16_t inpTgtL, inpTgtR;
+  #ifdef FAST_CMD_ENABLE
+  if (fastCmdAge < FAST_CMD_TIMEOUT) {  // fast commands arriving: take them directly, fall back to the main loop on timeout
+    uint32_t cmdLR = fastCmdLR;
+    fastCmdAge++;
+    inpTgtL = (int16_t)(cmdLR & 0xFFFFU);
+    inpTgtR = (int16_t)(cmdLR >> 16);
+    if (fastCmdNew) {
+      fastCmdNew = 0;
+      fastCmdCnt++;
+      fastCmdLat = (uint16_t)MIN(isrTimeNow() - fastCmdStamp, 0xFFFFU);
+      if (fastCmdLat > fastCmdLatMax) {
+        fastCmdLatMax = fastCmdLat;
+      }
+    }
+    fastRateLimit(inpTgtL, &fastRateL);   // same acceleration limit as the main loop, applied every period
+    fastRateLimit(inpTgtR, &fastRateR);
+    inpTgtL = (int16_t)(fastRateL >> 14);
+    inpTgtR = (int16_t)(fastRateR >> 14);
+  } else {                              // already rate limited by the main loop, the fast path starts from these targets
+    inpTgtL   = isrSetpoint.pwml;
+    inpTgtR   = isrSetpoint.pwmr;
+    fastRateL = (int32_t)inpTgtL << 14;
+    fastRateR = (int32_t)inpTgtR << 14;
   }
-  OverrunFlag = true;
-
-  /* Make sure to stop BOTH motors in case of an error */
-  enableFin = enable && !rtY_Left.z_errCode && !rtY_Right.z_errCode;
+  #else
+  inpTgtL = isrSetpoint.pwml;
+  inpTgtR = isrSetpoint.pwmr;
+  #endif
  
   // ========================= LEFT MOTOR ============================ 
     // Get hall sensors values
@@ -177,8 +528,8 @@ void DMA1_Channel1_IRQHandler(void) {
 
     /* Set motor inputs here */
     rtU_Left.b_motEna     = enableFin;
-    rtU_Left.z_ctrlModReq = ctrlModReq;  
-    rtU_Left.r_inpTgt     = pwml;
+    rtU_Left.z_ctrlModReq = isrSetpoint.ctrlModReq;
+    rtU_Left.r_inpTgt     = inpTgtL;
     rtU_Left.b_hallA      = hall_ul;
     rtU_Left.b_hallB      = hall_vl;
     rtU_Left.b_hallC      = hall_wl;
@@ -186,24 +537,6 @@ void DMA1_Channel1_IRQHandler(void) {
     rtU_Left.i_phaBC      = curL_phaB;
     rtU_Left.i_DCLink     = curL_DC;
     // rtU_Left.a_mechAngle   = ...; // Angle input in DEGREES [0,360] in fixdt(1,16,4) data type. If `angle` is float use `= (int16_t)floor(angle * 16.0F)` If `angle` is integer use `= (int16_t)(angle << 4)`
-    
-    /* Step the controller */
-    #ifdef MOTOR_LEFT_ENA    
-    BLDC_controller_step(rtM_Left);
-    #endif
-
-    /* Get motor outputs here */
-    ul            = rtY_Left.DC_phaA;
-    vl            = rtY_Left.DC_phaB;
-    wl            = rtY_Left.DC_phaC;
-  // errCodeLeft  = rtY_Left.z_errCode;
-  // motSpeedLeft = rtY_Left.n_mot;
-  // motAngleLeft = rtY_Left.a_elecAngle;
-
-    /* Apply commands */
-    LEFT_TIM->LEFT_TIM_U    = (uint16_t)CLAMP(ul + pwm_res / 2, pwm_margin, pwm_res-pwm_margin);
-    LEFT_TIM->LEFT_TIM_V    = (uint16_t)CLAMP(vl + pwm_res / 2, pwm_margin, pwm_res-pwm_margin);
-    LEFT_TIM->LEFT_TIM_W    = (uint16_t)CLAMP(wl + pwm_res / 2, pwm_margin, pwm_res-pwm_margin);
   // =================================================================
   
 
@@ -215,8 +548,8 @@ void DMA1_Channel1_IRQHandler(void) {
 
     /* Set motor inputs here */
     rtU_Right.b_motEna      = enableFin;
-    rtU_Right.z_ctrlModReq  = ctrlModReq;
-    rtU_Right.r_inpTgt      = pwmr;
+    rtU_Right.z_ctrlModReq  = isrSetpoint.ctrlModReq;
+    rtU_Right.r_inpTgt      = inpTgtR;
     rtU_Right.b_hallA       = hall_ur;
     rtU_Right.b_hallB       = hall_vr;
     rtU_Right.b_hallC       = hall_wr;
@@ -224,29 +557,195 @@ void DMA1_Channel1_IRQHandler(void) {
     rtU_Right.i_phaBC       = curR_phaC;
     rtU_Right.i_DCLink      = curR_DC;
     // rtU_Right.a_mechAngle   = ...; // Angle input in DEGREES [0,360] in fixdt(1,16,4) data type. If `angle` is float use `= (int16_t)floor(angle * 16.0F)` If `angle` is integer use `= (int16_t)(angle << 4)`
-    
-    /* Step the controller */
-    #ifdef MOTOR_RIGHT_ENA
-    BLDC_controller_step(rtM_Right);
+  // =================================================================
+
+
+  // ========================= CONTROLLERS ===========================
+    /* Step the controllers. The new duty cycles are preloaded, they take effect at the next update event either way */
+    #if defined(ISR_DEGRADE_DIAG) && !defined(BLDC_MULTIRATE)
+    /* Degraded mode: the diagnostics run in one of ISR_DEGRADE_DIAG Task_Scheduler slot 1 periods only (a window of 3
+     * periods every 3 * ISR_DEGRADE_DIAG holds exactly one), with the qualification times divided by ISR_DEGRADE_DIAG,
+     * so a fault is qualified after the same time as in normal operation. Outside the window they keep their states
+     * and error code. rtP is not touched, runtime changes of the parameters take effect as usual */
+    static uint8_t diagCnt = 0;
+    if (isrDegradeCnt > 0) {
+      diagCnt     = (diagCnt + 1 < 3 * ISR_DEGRADE_DIAG) ? diagCnt + 1 : 0;
+      bldcDiagDiv = (diagCnt >= 3) ? 0 : ISR_DEGRADE_DIAG;
+    } else {
+      bldcDiagDiv = 1;
+    }
+    #endif
+    PROF_START(PROF_CTRL);
+    #if defined(BLDC_MULTIRATE)
+      /* Fast partition only, the slow tasks are handed to PendSV_Handler */
+      uint8_t slowPend = 0;
+      #ifdef MOTOR_LEFT_ENA
+      PROF_START(PROF_LEFT);
+      slowPend |= BLDC_controller_step_fast(rtM_Left, &slowLeft);
+      PROF_STOP(PROF_LEFT);
+      #endif
+      #ifdef MOTOR_RIGHT_ENA
+      PROF_START(PROF_RIGHT);
+      slowPend |= BLDC_controller_step_fast(rtM_Right, &slowRight);
+      PROF_STOP(PROF_RIGHT);
+      #endif
+      if (slowPend) {
+        SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;       // runs when no other interrupt is active
+      }
+    #else
+      #ifdef MOTOR_LEFT_ENA
+      PROF_START(PROF_LEFT);
+      BLDC_controller_step(rtM_Left);
+      PROF_STOP(PROF_LEFT);
+      #endif
+      #ifdef MOTOR_RIGHT_ENA
+      PROF_START(PROF_RIGHT);
+      BLDC_controller_step(rtM_Right);
+      PROF_STOP(PROF_RIGHT);
+      #endif
     #endif
+    PROF_STOP(PROF_CTRL);
+  // =================================================================
 
+
+  // ========================= PWM OUTPUTS ===========================
     /* Get motor outputs here */
-    ur            = rtY_Right.DC_phaA;
-    vr            = rtY_Right.DC_phaB;
-    wr            = rtY_Right.DC_phaC;
- // errCodeRight  = rtY_Right.z_errCode;
- // motSpeedRight = rtY_Right.n_mot;
- // motAngleRight = rtY_Right.a_elecAngle;
+    ul            = (rtY_Left.DC_phaA  * pwm_scale) >> 16;   // identity at PWM_FREQ = 16 kHz and 64 MHz
+    vl            = (rtY_Left.DC_phaB  * pwm_scale) >> 16;
+    wl            = (rtY_Left.DC_phaC  * pwm_scale) >> 16;
+    ur            = (rtY_Right.DC_phaA * pwm_scale) >> 16;
+    vr            = (rtY_Right.DC_phaB * pwm_scale) >> 16;
+    wr            = (rtY_Right.DC_phaC * pwm_scale) >> 16;
+  // errCodeLeft  = rtY_Left.z_errCode;
+  // motSpeedLeft = rtY_Left.n_mot;
+  // motAngleLeft = rtY_Left.a_elecAngle;
 
     /* Apply commands */
+    LEFT_TIM->LEFT_TIM_U    = (uint16_t)CLAMP(ul + pwm_res / 2, pwm_margin, pwm_res-pwm_margin);
+    LEFT_TIM->LEFT_TIM_V    = (uint16_t)CLAMP(vl + pwm_res / 2, pwm_margin, pwm_res-pwm_margin);
+    LEFT_TIM->LEFT_TIM_W    = (uint16_t)CLAMP(wl + pwm_res / 2, pwm_margin, pwm_res-pwm_margin);
     RIGHT_TIM->RIGHT_TIM_U  = (uint16_t)CLAMP(ur + pwm_res / 2, pwm_margin, pwm_res-pwm_margin);
     RIGHT_TIM->RIGHT_TIM_V  = (uint16_t)CLAMP(vr + pwm_res / 2, pwm_margin, pwm_res-pwm_margin);
     RIGHT_TIM->RIGHT_TIM_W  = (uint16_t)CLAMP(wr + pwm_res / 2, pwm_margin, pwm_res-pwm_margin);
   // =================================================================
 
-  /* Indicate task complete */
-  OverrunFlag = false;
+  /* Publish the results of both control steps as one snapshot */
+  isrState.tick       = buzzerTimer;
+  isrState.n_motL     = rtY_Left.n_mot;
+  isrState.n_motR     = rtY_Right.n_mot;
+  isrState.iqL        = rtY_Left.iq;
+  isrState.iqR        = rtY_Right.iq;
+  isrState.i_DCLinkL  = rtU_Left.i_DCLink;
+  isrState.i_DCLinkR  = rtU_Right.i_DCLink;
+  isrState.errCodeL   = rtY_Left.z_errCode;
+  isrState.errCodeR   = rtY_Right.z_errCode;
+  Exch_Publish(&exchState, &isrState);
+
+  #ifdef TELEMETRY_ENABLE
+  Telem_Sample();                       // sample the selected signals, send a full frame
+  #endif
+
+  // ############################### OVERRUN ACCOUNTING ###############################
+  // Late completion or a new ADC sample already waiting -> enter (or stay in) degraded mode for ISR_DEGRADE_HOLD periods
+  #if PWM_CTRL_DIV > 1
+  uint16_t isrLatency = (uint16_t)(isrEntryStamp - buzzerTimer * CTRL_TICKS + CTRL_TICKS + isrSinceEntry());  // buzzerTimer advanced since the entry
+  #else
+  uint16_t isrLatency = isrTrigPhase();
+  #endif
+  uint8_t  isrLate    = PWM_IRQ_PENDING() != 0;
+  if (isrLatency > isrLatencyMax) {
+    isrLatencyMax = isrLatency;
+  }
+  if (isrLate) {
+    isrOverrunCnt++;
+  }
+  if (isrLate || isrLatency > isrLatencyLim) {
+    isrDegradeCnt = ISR_DEGRADE_HOLD;
+  } else if (isrDegradeCnt > 0) {
+    isrDegradeCnt--;
+  }
+  PROF_STOP(PROF_ISR);
  
  // ###############################################################################
 
 }
+
+#ifdef BLDC_MULTIRATE
+// =================================
+// Slow controller tasks, PendSV at the lowest interrupt priority
+// =================================
+// Pended by the PWM interrupt when it latched the slow inputs; the PWM interrupt preempts it.
+// The results are committed by the next BLDC_controller_step_fast() after the run.
+void bldcSlowTask(void) {
+  PROF_START(PROF_SLOW);                // wall time, includes the PWM interrupts that preempted it
+  #ifdef MOTOR_LEFT_ENA
+  BLDC_controller_step_slow(rtM_Left, &slowLeft);
+  #endif
+  #ifdef MOTOR_RIGHT_ENA
+  BLDC_controller_step_slow(rtM_Right, &slowRight);
+  #endif
+  PROF_STOP(PROF_SLOW);
+}
+#endif
+
+// =================================
+// Buzzer square wave and pattern sequencer, timer update interrupt at the lowest priority
+// =================================
+// The timer counts half buzzer periods; each update toggles the pin and sets the time to the next update:
+// buzzerFreq buzzer periods while sounding, BUZZER_TIM_IDLE while silent. The period is preloaded, so the
+// period set here starts after the one already running.
+// Queued beeps and melodies (beepQueue() in util.c) play first, as a continuous tone per note.
+// Pattern: slots of BUZZER_TIM_SLOT periods, the buzzer sounds in one slot of every buzzerPattern + 1;
+// with buzzerCount > 0 it sounds in buzzerCount slots followed by 2 silent ones. No buzzer in degraded mode.
+void TIM6_IRQHandler(void) {
+  PROF_START(PROF_BUZZER);
+  uint8_t freq = buzzerFreq;
+  uint8_t note;
+  uint8_t noteOn;
+
+  BUZZER_TIM->SR = ~TIM_SR_UIF;         // clear the update flag
+
+  noteOn          = beepTick(buzzerPerRun, &note);
+  buzzerSlotTick += buzzerPerRun;       // the period that just ended
+  buzzerPerRun    = buzzerPerNext;
+  while (buzzerSlotTick >= BUZZER_TIM_SLOT) {
+    buzzerSlotTick -= BUZZER_TIM_SLOT;
+    if (++buzzerSlot > buzzerPattern) {
+      buzzerSlot = 0;
+    }
+  }
+
+  if (!noteOn && buzzerNote) {          // the queue has played out, leave the pin low
+    HAL_GPIO_WritePin(BUZZER_PORT, BUZZER_PIN, GPIO_PIN_RESET);
+  }
+  buzzerNote = noteOn;
+
+  if (noteOn) {
+    if (note != 0 && isrDegradeCnt == 0) {
+      HAL_GPIO_TogglePin(BUZZER_PORT, BUZZER_PIN);
+      buzzerPerNext = note;
+    } else {
+      HAL_GPIO_WritePin(BUZZER_PORT, BUZZER_PIN, GPIO_PIN_RESET);
+      buzzerPerNext = BUZZER_TIM_IDLE;
+    }
+  } else if (freq != 0 && isrDegradeCnt == 0 && buzzerSlot == 0) {
+    if (buzzerPrev == 0) {
+      buzzerPrev = 1;
+      if (++buzzerIdx > (buzzerCount + 2)) {    // pause 2 periods
+        buzzerIdx = 1;
+      }
+    }
+    if (buzzerIdx <= buzzerCount || buzzerCount == 0) {
+      HAL_GPIO_TogglePin(BUZZER_PORT, BUZZER_PIN);
+    }
+    buzzerPerNext = freq;
+  } else {
+    if (buzzerPrev) {
+      HAL_GPIO_WritePin(BUZZER_PORT, BUZZER_PIN, GPIO_PIN_RESET);
+      buzzerPrev = 0;
+    }
+    buzzerPerNext = BUZZER_TIM_IDLE;
+  }
+  BUZZER_TIM->ARR = 2 * buzzerPerNext - 1;  // two counts per buzzer period
+  PROF_STOP(PROF_BUZZER);
+}
@@ -39,31 +39,72 @@
   * @{
   */
 
+/*
+ * Page layout: a 4 byte header (status half-word, PAGE_FORMAT) followed by 4 byte records
+ * {data, virtual address}, appended in order. Variables are written in batches: the records
+ * of a batch are followed by one commit marker {number of records, COMMIT_ADDRESS}, and only
+ * committed records count. A batch cut by a reset is dropped as a whole at the next EE_Init.
+ * EE_Init scans the active page once into a RAM index (last committed value per VirtAddVarTab
+ * entry and the first free record), reads are served from it and writes append without a
+ * search. A batch that does not fit any more moves the merged values to the other page in one
+ * page transfer; values that did not change are not written at all.
+ */
+
 /* Includes ------------------------------------------------------------------*/
 #include "eeprom.h"
 
 /* Private typedef -----------------------------------------------------------*/
+typedef uint64_t ee_mask_t;                     /* one bit per variable of VirtAddVarTab */
+
 /* Private define ------------------------------------------------------------*/
+#define RECORD_SIZE           ((uint32_t)4)         /* data half-word + virtual address half-word */
+
 /* Private macro -------------------------------------------------------------*/
+#define VAR_BIT(idx)          ((ee_mask_t)1 << (idx))
+
 /* Private variables ---------------------------------------------------------*/
 
+_Static_assert(NB_OF_VAR <= 64, "one bit per variable in the index masks");
+_Static_assert(sizeof((uint16_t[])VIRT_ADDR_TAB) == NB_OF_VAR * sizeof(uint16_t), "one VIRT_ADDR_TAB entry per variable");
+
 /* Global variable used to store variable value in read sequence */
 uint16_t DataVar = 0;
 
-/* Virtual address defined by the user: 0xFFFF value is prohibited */
+/* Virtual address defined by the user: 0xFFFF and COMMIT_ADDRESS values are prohibited */
 extern uint16_t VirtAddVarTab[NB_OF_VAR];
 
+/* RAM index of the active page */
+static uint16_t eePage = NO_VALID_PAGE;         /* active page: PAGE0, PAGE1 or NO_VALID_PAGE */
+static uint32_t eeNextAddress;                  /* first free record of the active page */
+static uint16_t eeValue[NB_OF_VAR];             /* last committed value of VirtAddVarTab[i] */
+static ee_mask_t eeValid;                       /* bit i: VirtAddVarTab[i] has a committed value */
+
+/* Open batch */
+static uint16_t eeStage[NB_OF_VAR];             /* values written since EE_WriteBegin() */
+static ee_mask_t eeStaged;                      /* bit i: eeStage[i] is set */
+static uint8_t  eeBatch;                        /* EE_WriteBegin() called, EE_WriteCommit() pending */
+
 /* Private function prototypes -----------------------------------------------*/
 /* Private functions ---------------------------------------------------------*/
 static HAL_StatusTypeDef EE_Format(void);
-static uint16_t EE_FindValidPage(uint8_t Operation);
-static uint16_t EE_VerifyPageFullWriteVariable(uint16_t VirtAddress, uint16_t Data);
-static uint16_t EE_PageTransfer(uint16_t VirtAddress, uint16_t Data);
+static HAL_StatusTypeDef EE_ErasePage(uint16_t Page);
 static uint16_t EE_VerifyPageFullyErased(uint32_t Address);
+static uint32_t EE_PageAddress(uint16_t Page);
+static int16_t  EE_FindIndex(uint16_t VirtAddress);
+static uint16_t EE_BuildIndex(uint16_t Page, uint16_t *Commits);
+static uint8_t  EE_TransferComplete(uint16_t Page);
+static HAL_StatusTypeDef EE_ProgramRecord(uint32_t Address, uint16_t VirtAddress, uint16_t Data);
+static HAL_StatusTypeDef EE_AppendBatch(ee_mask_t Mask, const uint16_t *Values);
+static HAL_StatusTypeDef EE_PageTransfer(ee_mask_t Mask, const uint16_t *Values);
 
 /**
-  * @brief  Restore the pages to a known good state in case of page's status
-  *   corruption after a power loss.
+  * @brief  Restore the pages to a known good state if necessary and build the RAM
+  *   index of the active page.
+  * @note   A page transfer cut by a reset is completed if its batch was committed
+  *   on the new page, whatever state the old page was left in, otherwise it is
+  *   dropped. A batch cut by a reset is closed by an empty commit marker, so its
+  *   records are never committed later. A page written without commit markers
+  *   (PAGE_FORMAT missing) is moved to the other page once.
   * @param  None.
   * @retval - Flash error code: on write Flash error
   *         - FLASH_COMPLETE: on success
@@ -71,244 +112,79 @@ static uint16_t EE_VerifyPageFullyErased(uint32_t Address);
 uint16_t EE_Init(void)
 {
   uint16_t pagestatus0 = 6, pagestatus1 = 6;
-  uint16_t varidx = 0;
-  uint16_t eepromstatus = 0, readstatus = 0;
-  int16_t x = -1;
-  HAL_StatusTypeDef  flashstatus;
-  uint32_t page_error = 0;
-  FLASH_EraseInitTypeDef s_eraseinit;
+  uint16_t pending = 0, commits = 0;
+  HAL_StatusTypeDef flashstatus = HAL_OK;
 
+  eePage   = NO_VALID_PAGE;
+  eeBatch  = 0;
+  eeStaged = 0;
 
   /* Get Page0 status */
-  pagestatus0 = (*(__IO uint16_t*)PAGE0_BASE_ADDRESS);
+  pagestatus0 = EE_READ16(PAGE0_BASE_ADDRESS);
   /* Get Page1 status */
-  pagestatus1 = (*(__IO uint16_t*)PAGE1_BASE_ADDRESS);
+  pagestatus1 = EE_READ16(PAGE1_BASE_ADDRESS);
 
-  /* Fill EraseInit structure*/
-  s_eraseinit.TypeErase   = FLASH_TYPEERASE_PAGES;
-  s_eraseinit.PageAddress = PAGE0_ID;
-  s_eraseinit.NbPages     = 1;
+  /* A page that received all values of a transfer wins over the old page */
+  if (EE_TransferComplete(PAGE0))
+  {
+    eePage = PAGE0;
+  }
+  else if (EE_TransferComplete(PAGE1))
+  {
+    eePage = PAGE1;
+  }
 
   /* Check for invalid header states and repair if necessary */
-  switch (pagestatus0)
+  if (eePage != NO_VALID_PAGE)
   {
-    case ERASED:
-      if (pagestatus1 == VALID_PAGE) /* Page0 erased, Page1 valid */
-      {
-          /* Erase Page0 */
-        if(!EE_VerifyPageFullyErased(PAGE0_BASE_ADDRESS))
-        {
-          flashstatus = HAL_FLASHEx_Erase(&s_eraseinit, &page_error);
-          /* If erase operation was failed, a Flash error code is returned */
-          if (flashstatus != HAL_OK)
-          {
-            return flashstatus;
-          }
-        }
-      }
-      else if (pagestatus1 == RECEIVE_DATA) /* Page0 erased, Page1 receive */
-      {
-        /* Erase Page0 */
-        if(!EE_VerifyPageFullyErased(PAGE0_BASE_ADDRESS))
-        {
-          flashstatus = HAL_FLASHEx_Erase(&s_eraseinit, &page_error);
-          /* If erase operation was failed, a Flash error code is returned */
-          if (flashstatus != HAL_OK)
-          {
-            return flashstatus;
-          }
-        }
-        /* Mark Page1 as valid */
-        flashstatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, PAGE1_BASE_ADDRESS, VALID_PAGE);
-        /* If program operation was failed, a Flash error code is returned */
-        if (flashstatus != HAL_OK)
-        {
-          return flashstatus;
-        }
-      }
-      else /* First EEPROM access (Page0&1 are erased) or invalid state -> format EEPROM */
-      {
-        /* Erase both Page0 and Page1 and set Page0 as valid page */
-        flashstatus = EE_Format();
-        /* If erase/program operation was failed, a Flash error code is returned */
-        if (flashstatus != HAL_OK)
-        {
-          return flashstatus;
-        }
-      }
-      break;
-
-    case RECEIVE_DATA:
-      if (pagestatus1 == VALID_PAGE) /* Page0 receive, Page1 valid */
-      {
-        /* Transfer data from Page1 to Page0 */
-        for (varidx = 0; varidx < NB_OF_VAR; varidx++)
-        {
-          if (( *(__IO uint16_t*)(PAGE0_BASE_ADDRESS + 6)) == VirtAddVarTab[varidx])
-          {
-            x = varidx;
-          }
-          if (varidx != x)
-          {
-            /* Read the last variables' updates */
-            readstatus = EE_ReadVariable(VirtAddVarTab[varidx], &DataVar);
-            /* In case variable corresponding to the virtual address was found */
-            if (readstatus != 0x1)
-            {
-              /* Transfer the variable to the Page0 */
-              eepromstatus = EE_VerifyPageFullWriteVariable(VirtAddVarTab[varidx], DataVar);
-              /* If program operation was failed, a Flash error code is returned */
-              if (eepromstatus != HAL_OK)
-              {
-                return eepromstatus;
-              }
-            }
-          }
-        }
-        /* Mark Page0 as valid */
-        flashstatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, PAGE0_BASE_ADDRESS, VALID_PAGE);
-        /* If program operation was failed, a Flash error code is returned */
-        if (flashstatus != HAL_OK)
-        {
-          return flashstatus;
-        }
-        s_eraseinit.TypeErase   = FLASH_TYPEERASE_PAGES;
-        s_eraseinit.PageAddress = PAGE1_ID;
-        s_eraseinit.NbPages     = 1;
-        /* Erase Page1 */
-        if(!EE_VerifyPageFullyErased(PAGE1_BASE_ADDRESS))
-        {
-          flashstatus = HAL_FLASHEx_Erase(&s_eraseinit, &page_error);
-          /* If erase operation was failed, a Flash error code is returned */
-          if (flashstatus != HAL_OK)
-          {
-            return flashstatus;
-          }
-        }
-      }
-      else if (pagestatus1 == ERASED) /* Page0 receive, Page1 erased */
-      {
-        s_eraseinit.TypeErase   = FLASH_TYPEERASE_PAGES;
-        s_eraseinit.PageAddress = PAGE1_ID;
-        s_eraseinit.NbPages     = 1;
-        /* Erase Page1 */
-        if(!EE_VerifyPageFullyErased(PAGE1_BASE_ADDRESS))
-        {
-          flashstatus = HAL_FLASHEx_Erase(&s_eraseinit, &page_error);
-          /* If erase operation was failed, a Flash error code is returned */
-          if (flashstatus != HAL_OK)
-          {
-            return flashstatus;
-          }
-        }
-        /* Mark Page0 as valid */
-        flashstatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, PAGE0_BASE_ADDRESS, VALID_PAGE);
-        /* If program operation was failed, a Flash error code is returned */
-        if (flashstatus != HAL_OK)
-        {
-          return flashstatus;
-        }
-      }
-      else /* Invalid state -> format eeprom */
-      {
-        /* Erase both Page0 and Page1 and set Page0 as valid page */
-        flashstatus = EE_Format();
-        /* If erase/program operation was failed, a Flash error code is returned */
-        if (flashstatus != HAL_OK)
-        {
-          return flashstatus;
-        }
-      }
-      break;
+    /* Erase the old page, also if its erase was cut, and mark the new one valid */
+    flashstatus = EE_ErasePage(eePage == PAGE0 ? PAGE1 : PAGE0);
+    if (flashstatus == HAL_OK)
+    {
+      flashstatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, EE_PageAddress(eePage), VALID_PAGE);
+    }
+  }
+  else if (pagestatus0 == VALID_PAGE && pagestatus1 != VALID_PAGE)
+  {
+    /* Page0 valid, Page1 erased or an unfinished transfer to it: dropped */
+    flashstatus = EE_ErasePage(PAGE1);
+    eePage = PAGE0;
+  }
+  else if (pagestatus1 == VALID_PAGE && pagestatus0 != VALID_PAGE)
+  {
+    /* Page1 valid, Page0 erased or an unfinished transfer to it */
+    flashstatus = EE_ErasePage(PAGE0);
+    eePage = PAGE1;
+  }
+  else
+  {
+    /* First EEPROM access (Page0&1 are erased) or invalid state -> format EEPROM */
+    flashstatus = EE_Format();
+    eePage = PAGE0;
+  }
+  /* If erase/program operation was failed, a Flash error code is returned */
+  if (flashstatus != HAL_OK)
+  {
+    eePage = NO_VALID_PAGE;
+    return flashstatus;
+  }
 
-    case VALID_PAGE:
-      if (pagestatus1 == VALID_PAGE) /* Invalid state -> format eeprom */
-      {
-        /* Erase both Page0 and Page1 and set Page0 as valid page */
-        flashstatus = EE_Format();
-        /* If erase/program operation was failed, a Flash error code is returned */
-        if (flashstatus != HAL_OK)
-        {
-          return flashstatus;
-        }
-      }
-      else if (pagestatus1 == ERASED) /* Page0 valid, Page1 erased */
-      {
-        s_eraseinit.TypeErase   = FLASH_TYPEERASE_PAGES;
-        s_eraseinit.PageAddress = PAGE1_ID;
-        s_eraseinit.NbPages     = 1;
-        /* Erase Page1 */
-        if(!EE_VerifyPageFullyErased(PAGE1_BASE_ADDRESS))
-        {
-          flashstatus = HAL_FLASHEx_Erase(&s_eraseinit, &page_error);
-          /* If erase operation was failed, a Flash error code is returned */
-          if (flashstatus != HAL_OK)
-          {
-            return flashstatus;
-          }
-        }
-      }
-      else /* Page0 valid, Page1 receive */
-      {
-        /* Transfer data from Page0 to Page1 */
-        for (varidx = 0; varidx < NB_OF_VAR; varidx++)
-        {
-          if ((*(__IO uint16_t*)(PAGE1_BASE_ADDRESS + 6)) == VirtAddVarTab[varidx])
-          {
-            x = varidx;
-          }
-          if (varidx != x)
-          {
-            /* Read the last variables' updates */
-            readstatus = EE_ReadVariable(VirtAddVarTab[varidx], &DataVar);
-            /* In case variable corresponding to the virtual address was found */
-            if (readstatus != 0x1)
-            {
-              /* Transfer the variable to the Page1 */
-              eepromstatus = EE_VerifyPageFullWriteVariable(VirtAddVarTab[varidx], DataVar);
-              /* If program operation was failed, a Flash error code is returned */
-              if (eepromstatus != HAL_OK)
-              {
-                return eepromstatus;
-              }
-            }
-          }
-        }
-        /* Mark Page1 as valid */
-        flashstatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, PAGE1_BASE_ADDRESS, VALID_PAGE);
-        /* If program operation was failed, a Flash error code is returned */
-        if (flashstatus != HAL_OK)
-        {
-          return flashstatus;
-        }
-        s_eraseinit.TypeErase   = FLASH_TYPEERASE_PAGES;
-        s_eraseinit.PageAddress = PAGE0_ID;
-        s_eraseinit.NbPages     = 1;
-        /* Erase Page0 */
-        if(!EE_VerifyPageFullyErased(PAGE0_BASE_ADDRESS))
-        {
-          flashstatus = HAL_FLASHEx_Erase(&s_eraseinit, &page_error);
-          /* If erase operation was failed, a Flash error code is returned */
-          if (flashstatus != HAL_OK)
-          {
-            return flashstatus;
-          }
-        }
-      }
-      break;
+  /* Read the active page once into the RAM index */
+  pending = EE_BuildIndex(eePage, &commits);
 
-    default:  /* Any other state -> format eeprom */
-      /* Erase both Page0 and Page1 and set Page0 as valid page */
-      flashstatus = EE_Format();
-      /* If erase/program operation was failed, a Flash error code is returned */
-      if (flashstatus != HAL_OK)
-      {
-        return flashstatus;
-      }
-      break;
+  if (EE_READ16(EE_PageAddress(eePage) + 2) != PAGE_FORMAT ||
+      (pending && eeNextAddress + RECORD_SIZE > EE_PageAddress(eePage) + PAGE_SIZE))
+  {
+    /* Page without commit markers, or a cut batch filled the page: move the values */
+    flashstatus = EE_PageTransfer(0, eeValue);
+  }
+  else if (pending)
+  {
+    /* Close the cut batch with an empty commit, its records no longer match any commit */
+    flashstatus = EE_AppendBatch(0, eeValue);
   }
 
-  return HAL_OK;
+  return flashstatus;
 }
 
 /**
@@ -321,37 +197,27 @@ uint16_t EE_Init(void)
   *           - 0: if Page not erased
   *           - 1: if Page erased
   */
-uint16_t EE_VerifyPageFullyErased(uint32_t Address)
+static uint16_t EE_VerifyPageFullyErased(uint32_t Address)
 {
-  uint32_t readstatus = 1;
-  uint16_t addressvalue = 0x5555;
+  uint32_t endaddress = Address + PAGE_SIZE;
 
-  /* Check each active page address starting from end */
-  while (Address <= PAGE0_END_ADDRESS)
+  /* Check each half-word of the page */
+  while (Address < endaddress)
   {
-    /* Get the current location content to be compared with virtual address */
-    addressvalue = (*(__IO uint16_t*)Address);
-
-    /* Compare the read address with the virtual address */
-    if (addressvalue != ERASED)
+    if (EE_READ16(Address) != ERASED)
     {
-
-      /* In case variable value is read, reset readstatus flag */
-      readstatus = 0;
-
-      break;
+      return 0;
     }
     /* Next address location */
-    Address = Address + 4;
+    Address = Address + 2;
   }
 
-  /* Return readstatus value: (0: Page not erased, 1: Page erased) */
-  return readstatus;
+  return 1;
 }
 
 /**
-  * @brief  Returns the last stored variable data, if found, which correspond to
-  *   the passed virtual address
+  * @brief  Returns the last committed variable data, if found, which correspond to
+  *   the passed virtual address. Served from the RAM index, no Flash access.
   * @param  VirtAddress: Variable virtual address
   * @param  Data: Global variable contains the read variable value
   * @retval Success or error status:
@@ -361,79 +227,112 @@ uint16_t EE_VerifyPageFullyErased(uint32_t Address)
   */
 uint16_t EE_ReadVariable(uint16_t VirtAddress, uint16_t* Data)
 {
-  uint16_t validpage = PAGE0;
-  uint16_t addressvalue = 0x5555, readstatus = 1;
-  uint32_t address = EEPROM_START_ADDRESS, PageStartAddress = EEPROM_START_ADDRESS;
-
-  /* Get active Page for read operation */
-  validpage = EE_FindValidPage(READ_FROM_VALID_PAGE);
+  int16_t varidx;
 
   /* Check if there is no valid page */
-  if (validpage == NO_VALID_PAGE)
+  if (eePage == NO_VALID_PAGE)
   {
-    return  NO_VALID_PAGE;
+    return NO_VALID_PAGE;
   }
 
-  /* Get the valid Page start Address */
-  PageStartAddress = (uint32_t)(EEPROM_START_ADDRESS + (uint32_t)(validpage * PAGE_SIZE));
+  varidx = EE_FindIndex(VirtAddress);
+  if (varidx < 0 || !(eeValid & VAR_BIT(varidx)))
+  {
+    return 1;
+  }
 
-  /* Get the valid Page end Address */
-  address = (uint32_t)((EEPROM_START_ADDRESS - 2) + (uint32_t)((1 + validpage) * PAGE_SIZE));
+  *Data = eeValue[varidx];
+  return 0;
+}
 
-  /* Check each active page address starting from end */
-  while (address > (PageStartAddress + 2))
-  {
-    /* Get the current location content to be compared with virtual address */
-    addressvalue = (*(__IO uint16_t*)address);
+/**
+  * @brief  Start a batch: the following EE_WriteVariable() calls are stored in
+  *   Flash together by EE_WriteCommit(), all or none of them.
+  * @param  None
+  * @retval None
+  */
+void EE_WriteBegin(void)
+{
+  eeStaged = 0;
+  eeBatch  = 1;
+}
 
-    /* Compare the read address with the virtual address */
-    if (addressvalue == VirtAddress)
-    {
-      /* Get content of Address-2 which is variable value */
-      *Data = (*(__IO uint16_t*)(address - 2));
+/**
+  * @brief  Writes/upadtes variable data in EEPROM. Inside a batch the value is only
+  *   recorded, otherwise it is committed at once as a batch of one.
+  * @param  VirtAddress: Variable virtual address, an entry of VirtAddVarTab
+  * @param  Data: 16 bit data to be written
+  * @retval Success or error status:
+  *           - FLASH_COMPLETE: on success
+  *           - 1: if VirtAddress is not in VirtAddVarTab
+  *           - NO_VALID_PAGE: if no valid page was found
+  *           - Flash error code: on write Flash error
+  */
+uint16_t EE_WriteVariable(uint16_t VirtAddress, uint16_t Data)
+{
+  int16_t  varidx = EE_FindIndex(VirtAddress);
+  uint8_t  single = !eeBatch;
 
-      /* In case variable value is read, reset readstatus flag */
-      readstatus = 0;
+  if (varidx < 0)
+  {
+    return 1;
+  }
 
-      break;
-    }
-    else
-    {
-      /* Next address location */
-      address = address - 4;
-    }
+  if (single)
+  {
+    EE_WriteBegin();
   }
+  eeStage[varidx] = Data;
+  eeStaged |= VAR_BIT(varidx);
 
-  /* Return readstatus value: (0: variable exist, 1: variable doesn't exist) */
-  return readstatus;
+  return single ? EE_WriteCommit() : HAL_OK;
 }
 
 /**
-  * @brief  Writes/upadtes variable data in EEPROM.
-  * @param  VirtAddress: Variable virtual address
-  * @param  Data: 16 bit data to be written
+  * @brief  Close the batch: append the changed variables and one commit marker to
+  *   the active page, or move everything to the other page if they do not fit.
+  * @param  None
   * @retval Success or error status:
-  *           - FLASH_COMPLETE: on success
-  *           - PAGE_FULL: if valid page is full
+  *           - FLASH_COMPLETE: on success, also if no variable changed
   *           - NO_VALID_PAGE: if no valid page was found
   *           - Flash error code: on write Flash error
   */
-uint16_t EE_WriteVariable(uint16_t VirtAddress, uint16_t Data)
+uint16_t EE_WriteCommit(void)
 {
-  uint16_t Status = 0;
+  ee_mask_t mask = 0;
+  uint16_t count = 0, varidx = 0;
+
+  eeBatch = 0;
+
+  /* Check if there is no valid page */
+  if (eePage == NO_VALID_PAGE)
+  {
+    return NO_VALID_PAGE;
+  }
 
-  /* Write the variable virtual address and value in the EEPROM */
-  Status = EE_VerifyPageFullWriteVariable(VirtAddress, Data);
+  /* Only the variables with a new value are written */
+  for (varidx = 0; varidx < NB_OF_VAR; varidx++)
+  {
+    if ((eeStaged & VAR_BIT(varidx)) && (!(eeValid & VAR_BIT(varidx)) || eeValue[varidx] != eeStage[varidx]))
+    {
+      mask |= VAR_BIT(varidx);
+      count++;
+    }
+  }
+  eeStaged = 0;
 
-  /* In case the EEPROM active page is full */
-  if (Status == PAGE_FULL)
+  if (count == 0)
   {
-    /* Perform Page transfer */
-    Status = EE_PageTransfer(VirtAddress, Data);
+    return HAL_OK;
   }
 
-  /* Return last operation status */
-  return Status;
+  /* The records and the commit marker must fit in the active page */
+  if (eeNextAddress + (count + 1) * RECORD_SIZE > EE_PageAddress(eePage) + PAGE_SIZE)
+  {
+    return EE_PageTransfer(mask, eeStage);
+  }
+
+  return EE_AppendBatch(mask, eeStage);
 }
 
 /**
@@ -445,21 +344,19 @@ uint16_t EE_WriteVariable(uint16_t VirtAddress, uint16_t Data)
 static HAL_StatusTypeDef EE_Format(void)
 {
   HAL_StatusTypeDef flashstatus = HAL_OK;
-  uint32_t page_error = 0;
-  FLASH_EraseInitTypeDef s_eraseinit;
 
-  s_eraseinit.TypeErase   = FLASH_TYPEERASE_PAGES;
-  s_eraseinit.PageAddress = PAGE0_ID;
-  s_eraseinit.NbPages     = 1;
   /* Erase Page0 */
-  if(!EE_VerifyPageFullyErased(PAGE0_BASE_ADDRESS))
+  flashstatus = EE_ErasePage(PAGE0);
+  /* If erase operation was failed, a Flash error code is returned */
+  if (flashstatus != HAL_OK)
   {
-    flashstatus = HAL_FLASHEx_Erase(&s_eraseinit, &page_error);
-    /* If erase operation was failed, a Flash error code is returned */
-    if (flashstatus != HAL_OK)
-    {
-      return flashstatus;
-    }
+    return flashstatus;
+  }
+  /* Mark Page0 as written with commit markers */
+  flashstatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, PAGE0_BASE_ADDRESS + 2, PAGE_FORMAT);
+  if (flashstatus != HAL_OK)
+  {
+    return flashstatus;
   }
   /* Set Page0 as valid page: Write VALID_PAGE at Page0 base address */
   flashstatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, PAGE0_BASE_ADDRESS, VALID_PAGE);
@@ -469,195 +366,262 @@ static HAL_StatusTypeDef EE_Format(void)
     return flashstatus;
   }
 
-  s_eraseinit.PageAddress = PAGE1_ID;
   /* Erase Page1 */
-  if(!EE_VerifyPageFullyErased(PAGE1_BASE_ADDRESS))
+  return EE_ErasePage(PAGE1);
+}
+
+/**
+  * @brief  Erase a page unless it is erased already
+  * @param  Page: PAGE0 or PAGE1
+  * @retval Status of the erase operation
+  */
+static HAL_StatusTypeDef EE_ErasePage(uint16_t Page)
+{
+  uint32_t page_error = 0;
+  FLASH_EraseInitTypeDef s_eraseinit;
+
+  if (EE_VerifyPageFullyErased(EE_PageAddress(Page)))
   {
-    flashstatus = HAL_FLASHEx_Erase(&s_eraseinit, &page_error);
-    /* If erase operation was failed, a Flash error code is returned */
-    if (flashstatus != HAL_OK)
-    {
-      return flashstatus;
-    }
+    return HAL_OK;
   }
 
-  return HAL_OK;
+  s_eraseinit.TypeErase   = FLASH_TYPEERASE_PAGES;
+  s_eraseinit.PageAddress = (Page == PAGE1) ? PAGE1_ID : PAGE0_ID;
+  s_eraseinit.NbPages     = 1;
+
+  return HAL_FLASHEx_Erase(&s_eraseinit, &page_error);
 }
 
 /**
-  * @brief  Find valid Page for write or read operation
-  * @param  Operation: operation to achieve on the valid page.
-  *   This parameter can be one of the following values:
-  *     @arg READ_FROM_VALID_PAGE: read operation from valid page
-  *     @arg WRITE_IN_VALID_PAGE: write operation from valid page
-  * @retval Valid page number (PAGE or PAGE1) or NO_VALID_PAGE in case
-  *   of no valid page was found
+  * @brief  Base address of a page
+  * @param  Page: PAGE0 or PAGE1
+  * @retval PAGE0_BASE_ADDRESS or PAGE1_BASE_ADDRESS
   */
-static uint16_t EE_FindValidPage(uint8_t Operation)
+static uint32_t EE_PageAddress(uint16_t Page)
 {
-  uint16_t pagestatus0 = 6, pagestatus1 = 6;
+  return (Page == PAGE1) ? PAGE1_BASE_ADDRESS : PAGE0_BASE_ADDRESS;
+}
+
+/**
+  * @brief  Index of a virtual address in VirtAddVarTab. A table of consecutive
+  *   addresses is resolved directly, otherwise the table is searched.
+  * @param  VirtAddress: Variable virtual address
+  * @retval Index, -1 if the address is not in the table
+  */
+static int16_t EE_FindIndex(uint16_t VirtAddress)
+{
+  uint16_t varidx = (uint16_t)(VirtAddress - VirtAddVarTab[0]);
+
+  if (varidx < NB_OF_VAR && VirtAddVarTab[varidx] == VirtAddress)
+  {
+    return (int16_t)varidx;
+  }
+  for (varidx = 0; varidx < NB_OF_VAR; varidx++)
+  {
+    if (VirtAddVarTab[varidx] == VirtAddress)
+    {
+      return (int16_t)varidx;
+    }
+  }
+  return -1;
+}
 
-  /* Get Page0 actual status */
-  pagestatus0 = (*(__IO uint16_t*)PAGE0_BASE_ADDRESS);
+/**
+  * @brief  Scan a page once from the beginning into the RAM index. On a page with
+  *   commit markers the records of a batch are applied when its marker matches
+  *   their number, on an older page every record counts.
+  * @param  Page: PAGE0 or PAGE1
+  * @param  Commits: number of batches applied
+  * @retval Number of records after the last commit marker (a cut batch)
+  */
+static uint16_t EE_BuildIndex(uint16_t Page, uint16_t *Commits)
+{
+  uint32_t address = EE_PageAddress(Page) + RECORD_SIZE;
+  uint32_t endaddress = EE_PageAddress(Page) + PAGE_SIZE;
+  uint8_t  markers = (EE_READ16(EE_PageAddress(Page) + 2) == PAGE_FORMAT);
+  uint16_t pendvalue[NB_OF_VAR];
+  ee_mask_t pendmask = 0;
+  uint16_t pending = 0;
 
-  /* Get Page1 actual status */
-  pagestatus1 = (*(__IO uint16_t*)PAGE1_BASE_ADDRESS);
+  eeValid  = 0;
+  *Commits = 0;
 
-  /* Write or read operation */
-  switch (Operation)
+  while (address < endaddress)
   {
-    case WRITE_IN_VALID_PAGE:   /* ---- Write operation ---- */
-      if (pagestatus1 == VALID_PAGE)
-      {
-        /* Page0 receiving data */
-        if (pagestatus0 == RECEIVE_DATA)
-        {
-          return PAGE0;         /* Page0 valid */
-        }
-        else
-        {
-          return PAGE1;         /* Page1 valid */
-        }
-      }
-      else if (pagestatus0 == VALID_PAGE)
+    uint16_t data = EE_READ16(address);
+    uint16_t virtaddress = EE_READ16(address + 2);
+    int16_t  varidx;
+
+    /* The first erased record ends the page content */
+    if (data == ERASED && virtaddress == ERASED)
+    {
+      break;
+    }
+    address += RECORD_SIZE;
+
+    if (virtaddress == COMMIT_ADDRESS)
+    {
+      /* Commit marker: apply the batch if it is complete, drop it otherwise */
+      if (data == pending)
       {
-        /* Page1 receiving data */
-        if (pagestatus1 == RECEIVE_DATA)
-        {
-          return PAGE1;         /* Page1 valid */
-        }
-        else
+        for (varidx = 0; varidx < NB_OF_VAR; varidx++)
         {
-          return PAGE0;         /* Page0 valid */
+          if (pendmask & VAR_BIT(varidx))
+          {
+            eeValue[varidx] = pendvalue[varidx];
+          }
         }
+        eeValid |= pendmask;
+        (*Commits)++;
       }
-      else
-      {
-        return NO_VALID_PAGE;   /* No valid Page */
-      }
+      pendmask = 0;
+      pending  = 0;
+      continue;
+    }
 
-    case READ_FROM_VALID_PAGE:  /* ---- Read operation ---- */
-      if (pagestatus0 == VALID_PAGE)
-      {
-        return PAGE0;           /* Page0 valid */
-      }
-      else if (pagestatus1 == VALID_PAGE)
-      {
-        return PAGE1;           /* Page1 valid */
-      }
-      else
+    varidx = EE_FindIndex(virtaddress);
+    if (!markers)
+    {
+      if (varidx >= 0)
       {
-        return NO_VALID_PAGE ;  /* No valid Page */
+        eeValue[varidx] = data;
+        eeValid |= VAR_BIT(varidx);
       }
+      continue;
+    }
+
+    /* Record of a batch; a torn or unknown record still counts, so the batch can not match */
+    if (varidx >= 0)
+    {
+      pendvalue[varidx] = data;
+      pendmask |= VAR_BIT(varidx);
+    }
+    pending++;
+  }
+
+  eeNextAddress = address;
+  return pending;
+}
+
+/**
+  * @brief  Check if a page received a complete page transfer: its status is
+  *   neither erased nor valid (receive, or a cut program of either) and its
+  *   transfer batch is committed. The old page may be in any state then.
+  * @param  Page: PAGE0 or PAGE1
+  * @retval 1 if the transfer to the page is complete, 0 otherwise
+  */
+static uint8_t EE_TransferComplete(uint16_t Page)
+{
+  uint16_t pagestatus = EE_READ16(EE_PageAddress(Page));
+  uint16_t commits = 0;
 
-    default:
-      return PAGE0;             /* Page0 valid */
+  if (pagestatus == ERASED || pagestatus == VALID_PAGE || EE_READ16(EE_PageAddress(Page) + 2) != PAGE_FORMAT)
+  {
+    return 0;
   }
+  EE_BuildIndex(Page, &commits);
+  return (commits > 0);
 }
 
 /**
-  * @brief  Verify if active page is full and Writes variable in EEPROM.
+  * @brief  Program one record, data first, so an erased virtual address shows a
+  *   record that was cut.
+  * @param  Address: record address
   * @param  VirtAddress: 16 bit virtual address of the variable
   * @param  Data: 16 bit data to be written as variable value
-  * @retval Success or error status:
-  *           - FLASH_COMPLETE: on success
-  *           - PAGE_FULL: if valid page is full
-  *           - NO_VALID_PAGE: if no valid page was found
-  *           - Flash error code: on write Flash error
+  * @retval Status of the last program operation
   */
-static uint16_t EE_VerifyPageFullWriteVariable(uint16_t VirtAddress, uint16_t Data)
+static HAL_StatusTypeDef EE_ProgramRecord(uint32_t Address, uint16_t VirtAddress, uint16_t Data)
 {
   HAL_StatusTypeDef flashstatus = HAL_OK;
-  uint16_t validpage = PAGE0;
-  uint32_t address = EEPROM_START_ADDRESS, pageendaddress = EEPROM_START_ADDRESS+PAGE_SIZE;
 
-  /* Get valid Page for write operation */
-  validpage = EE_FindValidPage(WRITE_IN_VALID_PAGE);
-
-  /* Check if there is no valid page */
-  if (validpage == NO_VALID_PAGE)
+  /* Set variable data */
+  flashstatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, Address, Data);
+  /* If program operation was failed, a Flash error code is returned */
+  if (flashstatus != HAL_OK)
   {
-    return  NO_VALID_PAGE;
+    return flashstatus;
   }
+  /* Set variable virtual address */
+  return HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, Address + 2, VirtAddress);
+}
 
-  /* Get the valid Page start address */
-  address = (uint32_t)(EEPROM_START_ADDRESS + (uint32_t)(validpage * PAGE_SIZE));
-
-  /* Get the valid Page end address */
-  pageendaddress = (uint32_t)((EEPROM_START_ADDRESS - 1) + (uint32_t)((validpage + 1) * PAGE_SIZE));
+/**
+  * @brief  Append the masked variables and their commit marker at the first free
+  *   record of the active page and update the RAM index. The caller checked
+  *   that they fit.
+  * @param  Mask: bit i set: write Values[i] to VirtAddVarTab[i]
+  * @param  Values: values indexed like VirtAddVarTab
+  * @retval Status of the last program operation
+  */
+static HAL_StatusTypeDef EE_AppendBatch(ee_mask_t Mask, const uint16_t *Values)
+{
+  HAL_StatusTypeDef flashstatus = HAL_OK;
+  uint16_t count = 0, varidx = 0;
 
-  /* Check each active page address starting from begining */
-  while (address < pageendaddress)
+  for (varidx = 0; varidx < NB_OF_VAR; varidx++)
   {
-    /* Verify if address and address+2 contents are 0xFFFFFFFF */
-    if ((*(__IO uint32_t*)address) == 0xFFFFFFFF)
+    if (Mask & VAR_BIT(varidx))
     {
-      /* Set variable data */
-      flashstatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, address, Data);
-      /* If program operation was failed, a Flash error code is returned */
+      flashstatus = EE_ProgramRecord(eeNextAddress, VirtAddVarTab[varidx], Values[varidx]);
+      eeNextAddress += RECORD_SIZE;     /* a failed record is skipped by the next batch as well */
       if (flashstatus != HAL_OK)
       {
         return flashstatus;
       }
-      /* Set variable virtual address */
-      flashstatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, address + 2, VirtAddress);       
-      /* Return program operation status */
-      return flashstatus;
+      count++;
     }
-    else
+  }
+
+  /* The commit marker makes the batch count */
+  flashstatus = EE_ProgramRecord(eeNextAddress, COMMIT_ADDRESS, count);
+  eeNextAddress += RECORD_SIZE;
+  if (flashstatus != HAL_OK)
+  {
+    return flashstatus;
+  }
+
+  for (varidx = 0; varidx < NB_OF_VAR; varidx++)
+  {
+    if (Mask & VAR_BIT(varidx))
     {
-      /* Next address location */
-      address = address + 4;
+      eeValue[varidx] = Values[varidx];
     }
   }
+  eeValid |= Mask;
 
-  /* Return PAGE_FULL in case the valid page is full */
-  return PAGE_FULL;
+  return HAL_OK;
 }
 
 /**
-  * @brief  Transfers last updated variables data from the full Page to
-  *   an empty one.
-  * @param  VirtAddress: 16 bit virtual address of the variable
-  * @param  Data: 16 bit data to be written as variable value
+  * @brief  Transfers the last committed variables, updated by the masked values,
+  *   from the active page to the other page as one batch, then erases the old page.
+  * @param  Mask: bit i set: Values[i] replaces the value of VirtAddVarTab[i]
+  * @param  Values: values indexed like VirtAddVarTab
   * @retval Success or error status:
   *           - FLASH_COMPLETE: on success
-  *           - PAGE_FULL: if valid page is full
   *           - NO_VALID_PAGE: if no valid page was found
   *           - Flash error code: on write Flash error
   */
-static uint16_t EE_PageTransfer(uint16_t VirtAddress, uint16_t Data)
+static HAL_StatusTypeDef EE_PageTransfer(ee_mask_t Mask, const uint16_t *Values)
 {
   HAL_StatusTypeDef flashstatus = HAL_OK;
-  uint32_t newpageaddress = EEPROM_START_ADDRESS;
-  uint32_t oldpageid = 0;
-  uint16_t validpage = PAGE0, varidx = 0;
-  uint16_t eepromstatus = 0, readstatus = 0;
-  uint32_t page_error = 0;
-  FLASH_EraseInitTypeDef s_eraseinit;
-
-  /* Get active Page for read operation */
-  validpage = EE_FindValidPage(READ_FROM_VALID_PAGE);
+  uint16_t oldpage = eePage;
+  uint16_t newpage = (eePage == PAGE0) ? PAGE1 : PAGE0;
+  uint32_t newpageaddress = EE_PageAddress(newpage);
+  uint16_t merged[NB_OF_VAR];
+  uint16_t varidx = 0;
 
-  if (validpage == PAGE1)       /* Page1 valid */
+  for (varidx = 0; varidx < NB_OF_VAR; varidx++)
   {
-    /* New page address where variable will be moved to */
-    newpageaddress = PAGE0_BASE_ADDRESS;
-
-    /* Old page ID where variable will be taken from */
-    oldpageid = PAGE1_ID;
+    merged[varidx] = (Mask & VAR_BIT(varidx)) ? Values[varidx] : eeValue[varidx];
   }
-  else if (validpage == PAGE0)  /* Page0 valid */
-  {
-    /* New page address  where variable will be moved to */
-    newpageaddress = PAGE1_BASE_ADDRESS;
 
-    /* Old page ID where variable will be taken from */
-    oldpageid = PAGE0_ID;
-  }
-  else
+  /* The new page is normally erased already, unless a transfer to it was cut */
+  flashstatus = EE_ErasePage(newpage);
+  if (flashstatus != HAL_OK)
   {
-    return NO_VALID_PAGE;       /* No valid Page */
+    return flashstatus;
   }
 
   /* Set the new Page status to RECEIVE_DATA status */
@@ -667,42 +631,23 @@ static uint16_t EE_PageTransfer(uint16_t VirtAddress, uint16_t Data)
   {
     return flashstatus;
   }
-
-  /* Write the variable passed as parameter in the new active page */
-  eepromstatus = EE_VerifyPageFullWriteVariable(VirtAddress, Data);
-  /* If program operation was failed, a Flash error code is returned */
-  if (eepromstatus != HAL_OK)
+  flashstatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, newpageaddress + 2, PAGE_FORMAT);
+  if (flashstatus != HAL_OK)
   {
-    return eepromstatus;
+    return flashstatus;
   }
 
-  /* Transfer process: transfer variables from old to the new active page */
-  for (varidx = 0; varidx < NB_OF_VAR; varidx++)
+  /* Transfer process: all variables with a value in one batch */
+  eePage        = newpage;
+  eeNextAddress = newpageaddress + RECORD_SIZE;
+  flashstatus   = EE_AppendBatch(eeValid | Mask, merged);
+  if (flashstatus != HAL_OK)
   {
-    if (VirtAddVarTab[varidx] != VirtAddress)  /* Check each variable except the one passed as parameter */
-    {
-      /* Read the other last variable updates */
-      readstatus = EE_ReadVariable(VirtAddVarTab[varidx], &DataVar);
-      /* In case variable corresponding to the virtual address was found */
-      if (readstatus != 0x1)
-      {
-        /* Transfer the variable to the new active page */
-        eepromstatus = EE_VerifyPageFullWriteVariable(VirtAddVarTab[varidx], DataVar);
-        /* If program operation was failed, a Flash error code is returned */
-        if (eepromstatus != HAL_OK)
-        {
-          return eepromstatus;
-        }
-      }
-    }
+    return flashstatus;
   }
 
-  s_eraseinit.TypeErase   = FLASH_TYPEERASE_PAGES;
-  s_eraseinit.PageAddress = oldpageid;
-  s_eraseinit.NbPages     = 1;
-
   /* Erase the old Page: Set old Page status to ERASED status */
-  flashstatus = HAL_FLASHEx_Erase(&s_eraseinit, &page_error);
+  flashstatus = EE_ErasePage(oldpage);
   /* If erase operation was failed, a Flash error code is returned */
   if (flashstatus != HAL_OK)
   {
@@ -710,17 +655,7 @@ static uint16_t EE_PageTransfer(uint16_t VirtAddress, uint16_t Data)
   }
 
   /* Set new Page status to VALID_PAGE status */
-  flashstatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, newpageaddress, VALID_PAGE);
-  /* If program operation was failed, a Flash error code is returned */
-  if (flashstatus != HAL_OK)
-  {
-    return flashstatus;
-  }
-
-
-
-  /* Return last operation flash status */
-  return flashstatus;
+  return HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, newpageaddress, VALID_PAGE);
 }
 
 /**
@@ -0,0 +1,85 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Consistent snapshots between the main loop and the PWM interrupt without disabling interrupts.
+ * Each direction has exactly one writer. The writer keeps two copies of the snapshot and bumps
+ * the sequence counter before updating each copy:
+ *   seq odd  -> slot 0 is being written, slot 1 holds the previous snapshot
+ *   seq even -> slot 1 is being written, slot 0 holds the new snapshot
+ * A reader copies slot[seq & 1], which is never the one being written, and repeats the copy
+ * only if seq moved meanwhile. On the single core this means:
+ *   - the PWM interrupt reading the setpoint never repeats: the main loop cannot run during the
+ *     interrupt, an interrupted publish leaves seq odd and the interrupt takes the old setpoint
+ *   - the main loop reading the state repeats at most once per PWM period that interrupts the copy
+ * The fences keep the compiler (and the host CPU in the threaded SIL test) from moving the data
+ * accesses across the counter updates; on the Cortex-M3 they are single DMB instructions.
+ */
+
+// Includes
+#include <string.h>
+#include "exchange.h"
+#include "ramfunc.h"
+
+/* =========================== Variable Definitions =========================== */
+
+EXCH_LATCH(exchSetpoint, ExchSetpoint);
+EXCH_LATCH(exchState,    ExchState);
+
+/* =========================== Exchange Functions =========================== */
+
+/*
+ * Publish a new snapshot. Only one context may publish to a latch.
+ */
+RAMFUNC void Exch_Publish(ExchLatch *l, const void *src) {
+  uint8_t *slot = (uint8_t *)l->slot;
+  uint32_t seq  = __atomic_load_n(&l->seq, __ATOMIC_RELAXED);
+
+  __atomic_store_n(&l->seq, seq + 1, __ATOMIC_RELAXED);   // readers switch to slot 1
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(slot, src, l->size);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&l->seq, seq + 2, __ATOMIC_RELAXED);   // readers switch back to slot 0
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(slot + l->size, src, l->size);
+}
+
+/*
+ * Copy the latest complete snapshot to dst.
+ * - returns the number of repeated copies (0 = first copy was consistent)
+ */
+RAMFUNC uint16_t Exch_Read(ExchLatch *l, void *dst) {
+  const uint8_t *slot = (const uint8_t *)l->slot;
+  uint32_t seq, seqEnd;
+  uint16_t n = 0;
+
+  seq = __atomic_load_n(&l->seq, __ATOMIC_ACQUIRE);
+  while (1) {
+    memcpy(dst, slot + (seq & 1U) * l->size, l->size);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    seqEnd = __atomic_load_n(&l->seq, __ATOMIC_ACQUIRE);
+    if (seqEnd == seq) {
+      break;
+    }
+    seq = seqEnd;
+    n++;
+  }
+  if (n && l->retries < 0xFFFFU) {
+    l->retries++;
+  }
+  return n;
+}
@@ -0,0 +1,207 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Non-blocking debug log sink on USART3. printf() is retargeted to Log_Write(),
+ * which only copies the text into a ring buffer and returns. The buffer is drained
+ * by the USART3 Tx DMA: every completed transfer starts the next contiguous chunk
+ * from the transfer complete callback, so the CPU never waits for the line.
+ * When the buffer is full the message is dropped according to LOG_DROP_POLICY and
+ * counted, the caller is never blocked.
+ * Other modules can hand over a binary block (telemetry frame) with Log_SubmitBlock().
+ * The block is sent straight from the caller's memory ahead of the queued text, so
+ * all USART3 transmissions go through the one DMA channel owned by this module.
+ */
+
+// Includes
+#include <string.h>
+#include "stm32f1xx_hal.h"
+#include "defines.h"
+#include "config.h"
+#include "logger.h"
+
+#if (LOG_BUFFER_SIZE & (LOG_BUFFER_SIZE - 1)) != 0
+  #error LOG_BUFFER_SIZE must be a power of two
+#endif
+
+/* =========================== Variable Definitions =========================== */
+
+extern UART_HandleTypeDef huart3;
+
+static uint8_t           logBuf[LOG_BUFFER_SIZE];
+static volatile uint16_t logHead;         // write index, free running, owned by Log_Write()
+static volatile uint16_t logTail;         // read index, free running, owned by the DMA side
+static volatile uint16_t logTxLen;        // [bytes] length of the transfer in progress
+static volatile uint8_t  logTxBusy;       // 1 = DMA transfer in progress
+static volatile uint8_t  logTxBlk;        // 1 = the transfer in progress is the submitted block
+static const uint8_t    *volatile logBlk; // submitted block waiting for (or in) transmission, NULL = none
+static volatile uint16_t logBlkLen;       // [bytes]
+static void            (*volatile logBlkDone)(void);  // called when the block has been sent
+static volatile LogStats logStats;
+
+/* =========================== Logger Functions =========================== */
+
+void Log_Init(void) {
+  __disable_irq();
+  logHead   = logTail = 0;
+  logTxLen  = 0;
+  logTxBusy = 0;
+  logTxBlk  = 0;
+  logBlk    = NULL;
+  memset((void *)&logStats, 0, sizeof(logStats));
+  __enable_irq();
+}
+
+/*
+ * Start the DMA on the submitted block or else on the next contiguous chunk of the
+ * ring buffer, if idle. Must be called with interrupts disabled or from an interrupt.
+ */
+static void Log_Kick(void) {
+  uint16_t fill, idx, len;
+
+  if (logTxBusy) {
+    return;
+  }
+  if (logBlk != NULL) {
+    logTxBlk  = 1;
+    logTxBusy = 1;
+    if (HAL_UART_Transmit_DMA(&huart3, (uint8_t *)logBlk, logBlkLen) != HAL_OK) {
+      logTxBlk = logTxBusy = 0;
+    }
+    return;
+  }
+  fill = (uint16_t)(logHead - logTail);
+  if (fill == 0) {
+    return;
+  }
+  idx = logTail & (LOG_BUFFER_SIZE - 1);
+  len = MIN(fill, (uint16_t)(LOG_BUFFER_SIZE - idx));   // do not run past the end of the buffer, the rest follows in the next chunk
+
+  logTxLen  = len;
+  logTxBusy = 1;                                        // set before the start, the completion may come back immediately
+  if (HAL_UART_Transmit_DMA(&huart3, &logBuf[idx], len) != HAL_OK) {
+    logTxBusy = 0;                                      // UART not ready yet (e.g. before UART3_Init), retry on the next write
+  }
+}
+
+/*
+ * Queue a message for transmission on USART3. Returns immediately.
+ * Inputs:       data = characters to send
+ *               len  = number of characters
+ * Outputs:      number of characters consumed (always len, dropped bytes are counted in LogStats)
+ */
+int Log_Write(const char *data, int len) {
+  uint16_t fill, space, n, idx, first;
+
+  if (len <= 0) {
+    return 0;
+  }
+
+  __disable_irq();                                      // the copy is short; it also serialises writers from interrupts
+  fill  = (uint16_t)(logHead - logTail);
+  space = LOG_BUFFER_SIZE - fill;
+  n     = (uint16_t)MIN((uint32_t)len, (uint32_t)space);
+  #if (LOG_DROP_POLICY == LOG_DROP_MSG)
+  if (n < len) {
+    n = 0;
+  }
+  #endif
+  if (n < len) {
+    logStats.overflowCnt++;
+    logStats.dropBytes += (uint32_t)(len - n);
+  }
+
+  if (n) {
+    idx   = logHead & (LOG_BUFFER_SIZE - 1);
+    first = MIN(n, (uint16_t)(LOG_BUFFER_SIZE - idx));
+    memcpy(&logBuf[idx], data, first);
+    memcpy(&logBuf[0], data + first, n - first);
+    logHead += n;
+    if (fill + n > logStats.fillMax) {
+      logStats.fillMax = fill + n;
+    }
+  }
+
+  Log_Kick();
+  __enable_irq();
+
+  return len;
+}
+
+/*
+ * Hand a binary block over for transmission. The memory is read by the DMA and must
+ * stay untouched until done() is called (from interrupt context). Only one block can
+ * be queued at a time.
+ * Inputs:       data = block to send
+ *               len  = number of bytes
+ *               done = completion callback, may submit the next block
+ * Outputs:      1 = queued, 0 = another block is still queued or in transmission
+ */
+int Log_SubmitBlock(const uint8_t *data, uint16_t len, void (*done)(void)) {
+  int ok = 0;
+
+  __disable_irq();
+  if (logBlk == NULL) {
+    logBlkLen  = len;
+    logBlkDone = done;
+    logBlk     = data;
+    Log_Kick();
+    ok = 1;
+  }
+  __enable_irq();
+
+  return ok;
+}
+
+/*
+ * Transfer complete: release the sent block or text chunk and start the next transfer.
+ * Called from HAL_UART_TxCpltCallback() in interrupt context.
+ */
+void Log_TxCplt(UART_HandleTypeDef *huart) {
+  void (*done)(void);
+
+  if (huart->Instance != USART3 || !logTxBusy) {
+    return;
+  }
+  logTxBusy = 0;
+  if (logTxBlk) {
+    logTxBlk  = 0;
+    done      = logBlkDone;
+    logBlk    = NULL;
+    if (done != NULL) {
+      done();                                           // may submit the next block
+    }
+  } else {
+    logTail          += logTxLen;
+    logStats.txBytes += logTxLen;
+    logTxLen          = 0;
+  }
+  Log_Kick();
+}
+
+void Log_GetStats(LogStats *out) {
+  __disable_irq();
+  *out = *(LogStats *)&logStats;
+  __enable_irq();
+}
+
+/*
+ * HAL callback for all UARTs; USART2 (feedback frame) needs no completion handling.
+ */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) {
+  Log_TxCplt(huart);
+}
@@ -27,7 +27,13 @@
 #include "setup.h"
 #include "config.h"
 #include "util.h"
+#include "profiler.h"
+#include "logger.h"
+#include "telemetry.h"
+#include "exchange.h"
+#include "sched.h"
 #include "BLDC_controller.h"      /* BLDC's header file */
+#include "BLDC_controller_mr.h"   /* multi-rate partition */
 #include "rtwtypes.h"
 
 void SystemClock_Config(void);
@@ -50,10 +56,6 @@ volatile uint8_t uart_buf[200];
 //---------------
 extern P    rtP_Left;                   /* Block parameters (auto storage) */
 extern P    rtP_Right;                  /* Block parameters (auto storage) */
-extern ExtY rtY_Left;                   /* External outputs */
-extern ExtY rtY_Right;                  /* External outputs */
-extern ExtU rtU_Left;                   /* External inputs */
-extern ExtU rtU_Right;                  /* External inputs */
 //---------------
 
 extern uint8_t     inIdx;               // input index used for dual-inputs
@@ -67,14 +69,33 @@ extern volatile uint32_t timeoutCntGen; // Timeout counter for the General timeo
 extern volatile uint8_t  timeoutFlgGen; // Timeout Flag for the General timeout (PPM, PWM, Nunchuk)
 extern uint8_t timeoutFlgADC;           // Timeout Flag for for ADC Protection: 0 = OK, 1 = Problem detected (line disconnected or wrong ADC data)
 extern uint8_t timeoutFlgSerial;        // Timeout Flag for Rx Serial command: 0 = OK, 1 = Problem detected (line disconnected or wrong Rx data)
+extern SerialCmdState cmdStateL;        // Last accepted USART2 command: protocol, sequence number, time stamp
 
 extern volatile int pwml;               // global variable for pwm left. -1000 to 1000
 extern volatile int pwmr;               // global variable for pwm right. -1000 to 1000
 
 extern uint8_t enable;                  // global variable for motor enable
+extern uint8_t ctrlModReq;              // final control mode request
 
 extern int16_t batVoltage;              // global variable for battery voltage
 
+extern volatile uint32_t isrOverrunCnt; // PWM interrupt overrun counter
+extern volatile uint16_t isrLatencyMax; // PWM interrupt worst-case completion time
+extern volatile uint16_t isrDegradeCnt; // PWM interrupt degraded mode remaining time
+extern volatile uint8_t  offsetSrc;     // ADC current offsets: OFFSET_NONE until the controller runs, then measured or stored
+extern volatile uint32_t bootReadyTick; // [ms] controller start after power on
+
+#ifdef FAST_CMD_ENABLE
+extern volatile uint16_t fastCmdLat;    // [timer ticks] last fast command latency
+extern volatile uint16_t fastCmdLatMax; // [timer ticks] worst-case fast command latency
+extern volatile uint32_t fastCmdCnt;    // fast commands used by the PWM interrupt
+#endif
+
+#ifdef BLDC_MULTIRATE
+extern SlowPart slowLeft;               // slow controller tasks, n_skip = runs dropped because PendSV did not finish in time
+extern SlowPart slowRight;
+#endif
+
 #if defined(CONTROL_PPM_LEFT)
 extern volatile uint16_t ppm_captured_value[PPM_NUM_CHANNELS+1];
 #endif
@@ -113,6 +134,24 @@ typedef struct{
   uint16_t  checksum;
 } SerialFeedback;
 static SerialFeedback Feedback;
+
+typedef struct{                   // protocol v2 feedback, sent while the commands arrive in protocol v2
+  uint16_t  start;                // SERIAL_START_FRAME_V2
+  uint8_t   version;              // SERIAL_PROTOCOL_V2
+  uint8_t   errCode;              // errCodeL | errCodeR << 4 of the last control step
+  uint16_t  seq;                  // sequence number of the last accepted command
+  uint16_t  stamp;                // time stamp of the last accepted command, for the round-trip time on the host
+  uint16_t  age;                  // [ms] since the last accepted command was received
+  int16_t   cmd1;
+  int16_t   cmd2;
+  int16_t   speedR_meas;
+  int16_t   speedL_meas;
+  int16_t   batVoltage;
+  int16_t   boardTemp;
+  uint16_t  cmdLed;
+  uint16_t  crc;                  // calcCRC16 over all bytes above
+} SerialFeedbackV2;
+static SerialFeedbackV2 FeedbackV2;
 static uint8_t sideboard_leds_L;
 
 static int16_t     speed;                // local variable for speed. -1000 to 1000
@@ -122,11 +161,288 @@ static int16_t     speedRateFixdt;       // local fixed-point variable for speed
 static int32_t     steerFixdt;           // local fixed-point variable for steering low-pass filter
 static int32_t     speedFixdt;           // local fixed-point variable for speed low-pass filter
 
-static uint32_t    buzzerTimer_prev = 0;
+static uint32_t    isrOverrunCnt_prev = 0;
+static uint32_t    logOverflowCnt_prev = 0;
+#ifdef FAST_CMD_ENABLE
+static uint32_t    fastCmdCnt_prev = 0;
+#endif
+#ifdef BLDC_MULTIRATE
+static uint32_t    slowSkip_prev = 0;
+#endif
+static LogStats    logStats;
+static ExchState   motState;            // consistent snapshot of the last control step of both motors
+static ExchSetpoint setpoint;           // targets for the PWM interrupt
 static MultipleTap MultipleTapBrake;    // define multiple tap functionality for the Brake pedal
 
 static uint16_t rate = RATE; // Adjustable rate to support multiple drive modes on startup
 
+static int32_t     board_temp_adcFixdt;  // local fixed-point variable for the board temperature low-pass filter
+static int16_t     board_temp_adcFilt;   // local variable for the filtered board temperature ADC value
+
+/* =========================== Main Loop Tasks =========================== */
+
+/*
+ * USART3 debug and telemetry commands, released by the USART3 IDLE interrupt
+ */
+static void taskRx(void) {
+  usart3_rx_check();
+}
+
+/*
+ * Inputs, filters and mixer, hand over of the targets to the PWM interrupt, measurements.
+ * Runs every DELAY_IN_MAIN_LOOP ms: the rate limiter, the filters and the timeouts count in these steps
+ */
+static void taskCtrl(void) {
+  Exch_Read(&exchState, &motState);     // Read the motor outputs of the last control step: speeds, currents, error codes
+  readCommand();                        // Read Command: input1[inIdx].cmd, input2[inIdx].cmd
+  calcAvgSpeed(&motState);              // Calculate average measured speed: speedAvg, speedAvgAbs
+
+  // ####### MOTOR ENABLING: Only if the initial input is very small (for SAFETY) #######
+  if (enable == 0 && !motState.errCodeL && !motState.errCodeR && 
+      ABS(input1[inIdx].cmd) < 50 && ABS(input2[inIdx].cmd) < 50){
+    beepShort(6);                     // make 2 beeps indicating the motor enable
+    beepShort(4); beepQueue(0, 100);
+    steerFixdt = speedFixdt = 0;      // reset filters
+    enable = 1;                       // enable motors
+    printf("-- Motors enabled --\r\n");
+  }
+
+  #ifdef STANDSTILL_HOLD_ENABLE
+    standstillHold();                                           // Apply Standstill Hold functionality. Only available and makes sense for VOLTAGE or TORQUE Mode
+  #endif
+
+  #ifdef ELECTRIC_BRAKE_ENABLE
+    electricBrake(speedBlend, MultipleTapBrake.b_multipleTap);  // Apply Electric Brake. Only available and makes sense for TORQUE Mode
+  #endif
+
+  // ####### LOW-PASS FILTER #######
+  rateLimiter16(input1[inIdx].cmd, rate, &steerRateFixdt);
+  rateLimiter16(input2[inIdx].cmd, rate, &speedRateFixdt);
+  filtLowPass32(steerRateFixdt >> 4, FILTER, &steerFixdt);
+  filtLowPass32(speedRateFixdt >> 4, FILTER, &speedFixdt);
+  steer = (int16_t)(steerFixdt >> 16);  // convert fixed-point to integer
+  speed = (int16_t)(speedFixdt >> 16);  // convert fixed-point to integer
+
+  if (cmdStateL.motorMode && inIdx == 0) {  // protocol v2 per motor targets: input1 -> left, input2 -> right
+    cmdL = steer;
+    cmdR = speed;
+  } else {
+    mixerFcn(speed << 4, steer << 4, &cmdR, &cmdL);   // This function implements the equations above
+  }
+
+  // ####### SET OUTPUTS (if the target change is less than +/- 100) #######
+  #ifdef INVERT_R_DIRECTION
+    pwmr = cmdR;
+  #else
+    pwmr = -cmdR;
+  #endif
+  #ifdef INVERT_L_DIRECTION
+    pwml = -cmdL;
+  #else
+    pwml = cmdL;
+  #endif
+
+  // ####### HAND OVER TO THE PWM INTERRUPT (all at once) #######
+  setpoint.pwml       = (int16_t)pwml;
+  setpoint.pwmr       = (int16_t)pwmr;
+  setpoint.enable     = enable;
+  setpoint.ctrlModReq = ctrlModReq;
+  Exch_Publish(&exchSetpoint, &setpoint);
+
+  // ####### CALC BOARD TEMPERATURE #######
+  filtLowPass32(adc_buffer.temp, TEMP_FILT_COEF, &board_temp_adcFixdt);
+  board_temp_adcFilt  = (int16_t)(board_temp_adcFixdt >> 16);  // convert fixed-point to integer
+  board_temp_deg_c    = (TEMP_CAL_HIGH_DEG_C - TEMP_CAL_LOW_DEG_C) * (board_temp_adcFilt - TEMP_CAL_LOW_ADC) / (TEMP_CAL_HIGH_ADC - TEMP_CAL_LOW_ADC) + TEMP_CAL_LOW_DEG_C;
+
+  // ####### CALC CALIBRATED BATTERY VOLTAGE #######
+  batVoltageCalib = batVoltage * BAT_CALIB_REAL_VOLTAGE / BAT_CALIB_ADC;
+
+  // ####### CALC DC LINK CURRENT #######
+  left_dc_curr  = -(motState.i_DCLinkL * 100) / A2BIT_CONV;  // Left DC Link Current * 100 
+  right_dc_curr = -(motState.i_DCLinkR * 100) / A2BIT_CONV;  // Right DC Link Current * 100
+  dc_curr       = left_dc_curr + right_dc_curr;            // Total DC Link Current * 100
+
+  // Update states
+  inIdx_prev = inIdx;
+  main_loop_counter++;
+}
+
+/*
+ * Feedback frame on USART2, every 10 ms
+ */
+static void taskFeedback(void) {
+  // ####### FEEDBACK SERIAL OUT #######
+  Feedback.start	        = (uint16_t)SERIAL_START_FRAME;
+  Feedback.cmd1           = (int16_t)input1[inIdx].cmd;
+  Feedback.cmd2           = (int16_t)input2[inIdx].cmd;
+  Feedback.speedR_meas	  = motState.n_motR;
+  Feedback.speedL_meas	  = motState.n_motL;
+  Feedback.batVoltage	    = (int16_t)batVoltageCalib;
+  Feedback.boardTemp	    = (int16_t)board_temp_deg_c;
+
+  if(__HAL_DMA_GET_COUNTER(huart2.hdmatx) == 0 && cmdStateL.ver == 2) {   // answer in the protocol of the commands
+    FeedbackV2.start        = (uint16_t)SERIAL_START_FRAME_V2;
+    FeedbackV2.version      = SERIAL_PROTOCOL_V2;
+    FeedbackV2.errCode      = (uint8_t)(motState.errCodeL | (motState.errCodeR << 4));
+    FeedbackV2.seq          = cmdStateL.seq;
+    FeedbackV2.stamp        = cmdStateL.stamp;
+    FeedbackV2.age          = (uint16_t)MIN(HAL_GetTick() - cmdStateL.rxTick, 0xFFFFU);
+    FeedbackV2.cmd1         = Feedback.cmd1;
+    FeedbackV2.cmd2         = Feedback.cmd2;
+    FeedbackV2.speedR_meas  = Feedback.speedR_meas;
+    FeedbackV2.speedL_meas  = Feedback.speedL_meas;
+    FeedbackV2.batVoltage   = Feedback.batVoltage;
+    FeedbackV2.boardTemp    = Feedback.boardTemp;
+    FeedbackV2.cmdLed       = (uint16_t)sideboard_leds_L;
+    FeedbackV2.crc          = calcCRC16(0xFFFF, (const uint8_t *)&FeedbackV2, sizeof(FeedbackV2) - 2);
+
+    HAL_UART_Transmit_DMA(&huart2, (uint8_t *)&FeedbackV2, sizeof(FeedbackV2));
+  } else if(__HAL_DMA_GET_COUNTER(huart2.hdmatx) == 0) {
+    Feedback.cmdLed     = (uint16_t)sideboard_leds_L;
+    Feedback.checksum   = (uint16_t)(Feedback.start ^ Feedback.cmd1 ^ Feedback.cmd2 ^ Feedback.speedR_meas ^ Feedback.speedL_meas 
+                                    ^ Feedback.batVoltage ^ Feedback.boardTemp ^ Feedback.cmdLed);
+
+    HAL_UART_Transmit_DMA(&huart2, (uint8_t *)&Feedback, sizeof(Feedback));
+  }
+}
+
+/*
+ * Emergency poweroff, error, timeout and warning beeps. Runs right after taskCtrl()
+ */
+static void taskProtect(void) {
+  // ####### POWEROFF BY POWER-BUTTON #######
+  // poweroffPressCheck();
+
+  // ####### BEEP AND EMERGENCY POWEROFF #######
+  if (TEMP_POWEROFF_ENABLE && board_temp_deg_c >= TEMP_POWEROFF && speedAvgAbs < 20){  // poweroff before mainboard burns OR low bat 3
+    printf("Powering off, temperature is too high\r\n");
+    poweroff();
+  } else if ( BAT_DEAD_ENABLE && batVoltage < BAT_DEAD && speedAvgAbs < 20){
+    printf("Powering off, battery voltage is too low\r\n");
+    poweroff();
+  } else if (motState.errCodeL || motState.errCodeR) {                                              // 1 beep (low pitch): Motor error, disable motors
+    enable = 0;
+    beepCount(1, 24, 1);
+  } else if (timeoutFlgADC) {                                                                       // 2 beeps (low pitch): ADC timeout
+    beepCount(2, 24, 1);
+  } else if (timeoutFlgSerial) {                                                                    // 3 beeps (low pitch): Serial timeout
+    beepCount(3, 24, 1);
+  } else if (timeoutFlgGen) {                                                                       // 4 beeps (low pitch): General timeout (PPM, PWM, Nunchuk)
+    beepCount(4, 24, 1);
+  } else if (TEMP_WARNING_ENABLE && board_temp_deg_c >= TEMP_WARNING) {                             // 5 beeps (low pitch): Mainboard temperature warning
+    beepCount(5, 24, 1);
+  } else if (BAT_LVL1_ENABLE && batVoltage < BAT_LVL1) {                                            // 1 beep fast (medium pitch): Low bat 1
+    beepCount(0, 10, 6);
+  } else if (BAT_LVL2_ENABLE && batVoltage < BAT_LVL2) {                                            // 1 beep slow (medium pitch): Low bat 2
+    beepCount(0, 10, 30);
+  } else if (BEEPS_BACKWARD && (((cmdR < -50 || cmdL < -50) && speedAvg < 0) || MultipleTapBrake.b_multipleTap)) { // 1 beep fast (high pitch): Backward spinning motors
+    beepCount(0, 5, 1);
+    backwardDrive = 1;
+  } else {  // do not beep
+    beepCount(0, 0, 0);
+    backwardDrive = 0;
+  }
+}
+
+/*
+ * Debug serial output, every 125 ms
+ */
+static void taskDebug(void) {
+  // ####### DEBUG SERIAL OUT #######
+  #if defined(DEBUG_SERIAL_PROTOCOL)
+    process_debug();
+  #else
+    printf("in1:%i in2:%i cmdL:%i cmdR:%i BatADC:%i BatV:%i TempADC:%i Temp:%i \r\n",
+      input1[inIdx].raw,        // 1: INPUT1
+      input2[inIdx].raw,        // 2: INPUT2
+      cmdL,                     // 3: output command: [-1000, 1000]
+      cmdR,                     // 4: output command: [-1000, 1000]
+      adc_buffer.batt1,         // 5: for battery voltage calibration
+      batVoltageCalib,          // 6: for verifying battery voltage calibration
+      board_temp_adcFilt,       // 7: for board temperature calibration
+      board_temp_deg_c);        // 8: for verifying board temperature calibration
+  #endif
+}
+
+/*
+ * Reports of rare events, one per run in turn: each report every 1 s
+ */
+static void taskReport(void) {
+  static uint8_t idx = 0;
+  static uint8_t bootReported = 0;
+
+  if (!bootReported && offsetSrc != OFFSET_NONE) {    // ####### BOOT TIME REPORT, once #######
+    bootReported = 1;
+    printf("Boot: ready in %lu ms, %lu MHz, ADC offsets %s\r\n",
+      (unsigned long)bootReadyTick,
+      (unsigned long)(SystemCoreClock / 1000000),
+      (offsetSrc == OFFSET_STORED) ? "stored" : "calibrated");
+  }
+
+  switch (idx) {
+    case 0:   // ####### ISR OVERRUN REPORT #######
+      if (isrOverrunCnt != isrOverrunCnt_prev) {
+        isrOverrunCnt_prev = isrOverrunCnt;
+        printf("ISR overrun:%lu latMax:%u degraded:%u\r\n",
+          (unsigned long)isrOverrunCnt,
+          isrLatencyMax,
+          isrDegradeCnt);
+      }
+      break;
+    case 1:   // ####### FAST COMMAND LATENCY REPORT #######
+      #ifdef FAST_CMD_ENABLE
+      if (fastCmdCnt != fastCmdCnt_prev) {
+        fastCmdCnt_prev = fastCmdCnt;
+        printf("Fast cmd:%lu lat:%u max:%u us\r\n",
+          (unsigned long)fastCmdCnt,
+          (unsigned)(fastCmdLat / (SystemCoreClock / 1000000)),     // timer ticks = core cycles
+          (unsigned)(fastCmdLatMax / (SystemCoreClock / 1000000)));
+      }
+      #endif
+      break;
+    case 2:   // ####### DEBUG LOG OVERFLOW REPORT #######
+      Log_GetStats(&logStats);
+      if (logStats.overflowCnt != logOverflowCnt_prev) {
+        logOverflowCnt_prev = logStats.overflowCnt;
+        printf("Log overflow:%lu dropped:%lu\r\n",
+          (unsigned long)logStats.overflowCnt,
+          (unsigned long)logStats.dropBytes);
+      }
+      break;
+    default:  // ####### SLOW TASK OVERRUN REPORT #######
+      #ifdef BLDC_MULTIRATE
+      if ((uint32_t)(slowLeft.n_skip + slowRight.n_skip) != slowSkip_prev) {
+        slowSkip_prev = (uint32_t)(slowLeft.n_skip + slowRight.n_skip);
+        printf("Slow skip L:%u R:%u\r\n", slowLeft.n_skip, slowRight.n_skip);
+      }
+      #endif
+      break;
+  }
+  idx = (idx + 1) & 3;
+}
+
+/*
+ * Profiler and scheduler statistics, one section and one task per run
+ */
+static void taskProf(void) {
+  #ifdef PROFILER_ENABLE
+  Prof_PrintNext();
+  Sched_PrintNext();
+  #endif
+}
+
+// Periods and phases: taskFeedback and taskProtect follow taskCtrl in the same PWM period, the printing tasks
+// are shifted by a few ms so that their printf does not delay the control task
+static const SchedTask schedTasks[SCHED_TASKS] = {
+  [SCHED_RX]       = { "rx",       taskRx,       0,                                                0 },
+  [SCHED_CTRL]     = { "ctrl",     taskCtrl,     SCHED_MS(DELAY_IN_MAIN_LOOP),                     0 },
+  [SCHED_FEEDBACK] = { "feedback", taskFeedback, SCHED_MS(10),                                     0 },
+  [SCHED_PROTECT]  = { "protect",  taskProtect,  SCHED_MS(DELAY_IN_MAIN_LOOP),                     0 },
+  [SCHED_DEBUG]    = { "debug",    taskDebug,    SCHED_MS(125),                                    SCHED_MS(1) },
+  [SCHED_REPORT]   = { "report",   taskReport,   SCHED_MS(250),                                    SCHED_MS(2) },
+  [SCHED_PROF]     = { "prof",     taskProf,     SCHED_MS(PROF_PRINT_LOOPS * DELAY_IN_MAIN_LOOP),  SCHED_MS(3) },
+};
+
 
 int main(void) {
 
@@ -145,21 +461,34 @@ int main(void) {
   /* DebugMonitor_IRQn interrupt configuration */
   HAL_NVIC_SetPriority(DebugMonitor_IRQn, 0, 0);
   /* PendSV_IRQn interrupt configuration */
+  #ifdef BLDC_MULTIRATE
+  HAL_NVIC_SetPriority(PendSV_IRQn, 15, 0);   // slow controller tasks, below all other interrupts except the buzzer timer (same level)
+  #else
   HAL_NVIC_SetPriority(PendSV_IRQn, 0, 0);
+  #endif
   /* SysTick_IRQn interrupt configuration */
   HAL_NVIC_SetPriority(SysTick_IRQn, 0, 0);
 
   SystemClock_Config();
+  #ifdef PROFILER_ENABLE
+  Prof_Init();
+  #endif
 
+  bldcClockInit();
   __HAL_RCC_DMA1_CLK_DISABLE();
   MX_GPIO_Init();
   MX_TIM_Init();
+  MX_BUZZER_TIM_Init();
   MX_ADC1_Init();
   MX_ADC2_Init();
   BLDC_Init();        // BLDC Controller Init
 
   HAL_GPIO_WritePin(OFF_PORT, OFF_PIN, GPIO_PIN_SET);   // Activate Latch
   Input_Lim_Init();   // Input Limitations Init
+  Log_Init();         // Debug log Init (USART3 Tx DMA ring buffer)
+  #ifdef TELEMETRY_ENABLE
+  Telem_Init();       // Telemetry stream Init
+  #endif
   Input_Init();       // Input Init
 
   HAL_ADC_Start(&hadc1);
@@ -168,178 +497,96 @@ int main(void) {
   poweronMelody();
   HAL_GPIO_WritePin(LED_PORT, LED_PIN, GPIO_PIN_SET);
   
-  int32_t board_temp_adcFixdt = adc_buffer.temp << 16;  // Fixed-point filter output initialized with current ADC converted to fixed-point
-  int16_t board_temp_adcFilt  = adc_buffer.temp;
-
-  while(1) {
-    if (buzzerTimer - buzzerTimer_prev > 16*DELAY_IN_MAIN_LOOP) {   // 1 ms = 16 ticks buzzerTimer
-
-    readCommand();                        // Read Command: input1[inIdx].cmd, input2[inIdx].cmd
-    calcAvgSpeed();                       // Calculate average measured speed: speedAvg, speedAvgAbs
-
-    // ####### MOTOR ENABLING: Only if the initial input is very small (for SAFETY) #######
-    if (enable == 0 && !rtY_Left.z_errCode && !rtY_Right.z_errCode && 
-        ABS(input1[inIdx].cmd) < 50 && ABS(input2[inIdx].cmd) < 50){
-      beepShort(6);                     // make 2 beeps indicating the motor enable
-      beepShort(4); HAL_Delay(100);
-      steerFixdt = speedFixdt = 0;      // reset filters
-      enable = 1;                       // enable motors
-      printf("-- Motors enabled --\r\n");
-    }
-
-    #ifdef STANDSTILL_HOLD_ENABLE
-      standstillHold();                                           // Apply Standstill Hold functionality. Only available and makes sense for VOLTAGE or TORQUE Mode
-    #endif
-
-    #ifdef ELECTRIC_BRAKE_ENABLE
-      electricBrake(speedBlend, MultipleTapBrake.b_multipleTap);  // Apply Electric Brake. Only available and makes sense for TORQUE Mode
-    #endif
-
-    // ####### LOW-PASS FILTER #######
-    rateLimiter16(input1[inIdx].cmd, rate, &steerRateFixdt);
-    rateLimiter16(input2[inIdx].cmd, rate, &speedRateFixdt);
-    filtLowPass32(steerRateFixdt >> 4, FILTER, &steerFixdt);
-    filtLowPass32(speedRateFixdt >> 4, FILTER, &speedFixdt);
-    steer = (int16_t)(steerFixdt >> 16);  // convert fixed-point to integer
-    speed = (int16_t)(speedFixdt >> 16);  // convert fixed-point to integer
-
-    mixerFcn(speed << 4, steer << 4, &cmdR, &cmdL);   // This function implements the equations above
+  board_temp_adcFixdt = adc_buffer.temp << 16;  // Fixed-point filter output initialized with current ADC converted to fixed-point
+  board_temp_adcFilt  = adc_buffer.temp;
 
-    // ####### SET OUTPUTS (if the target change is less than +/- 100) #######
-    #ifdef INVERT_R_DIRECTION
-      pwmr = cmdR;
-    #else
-      pwmr = -cmdR;
-    #endif
-    #ifdef INVERT_L_DIRECTION
-      pwml = -cmdL;
-    #else
-      pwml = cmdL;
-    #endif
-
-    // ####### CALC BOARD TEMPERATURE #######
-    filtLowPass32(adc_buffer.temp, TEMP_FILT_COEF, &board_temp_adcFixdt);
-    board_temp_adcFilt  = (int16_t)(board_temp_adcFixdt >> 16);  // convert fixed-point to integer
-    board_temp_deg_c    = (TEMP_CAL_HIGH_DEG_C - TEMP_CAL_LOW_DEG_C) * (board_temp_adcFilt - TEMP_CAL_LOW_ADC) / (TEMP_CAL_HIGH_ADC - TEMP_CAL_LOW_ADC) + TEMP_CAL_LOW_DEG_C;
-
-    // ####### CALC CALIBRATED BATTERY VOLTAGE #######
-    batVoltageCalib = batVoltage * BAT_CALIB_REAL_VOLTAGE / BAT_CALIB_ADC;
-
-    // ####### CALC DC LINK CURRENT #######
-    left_dc_curr  = -(rtU_Left.i_DCLink * 100) / A2BIT_CONV;   // Left DC Link Current * 100 
-    right_dc_curr = -(rtU_Right.i_DCLink * 100) / A2BIT_CONV;  // Right DC Link Current * 100
-    dc_curr       = left_dc_curr + right_dc_curr;            // Total DC Link Current * 100
-
-    // ####### DEBUG SERIAL OUT #######
-    if (main_loop_counter % 25 == 0) {    // Send data periodically every 125 ms      
-      #if defined(DEBUG_SERIAL_PROTOCOL)
-        process_debug();
-      #else
-        printf("in1:%i in2:%i cmdL:%i cmdR:%i BatADC:%i BatV:%i TempADC:%i Temp:%i \r\n",
-          input1[inIdx].raw,        // 1: INPUT1
-          input2[inIdx].raw,        // 2: INPUT2
-          cmdL,                     // 3: output command: [-1000, 1000]
-          cmdR,                     // 4: output command: [-1000, 1000]
-          adc_buffer.batt1,         // 5: for battery voltage calibration
-          batVoltageCalib,          // 6: for verifying battery voltage calibration
-          board_temp_adcFilt,       // 7: for board temperature calibration
-          board_temp_deg_c);        // 8: for verifying board temperature calibration
-      #endif
-    }
-
-    // ####### FEEDBACK SERIAL OUT #######
-    if (main_loop_counter % 2 == 0) {    // Send data periodically every 10 ms
-      Feedback.start	        = (uint16_t)SERIAL_START_FRAME;
-      Feedback.cmd1           = (int16_t)input1[inIdx].cmd;
-      Feedback.cmd2           = (int16_t)input2[inIdx].cmd;
-      Feedback.speedR_meas	  = (int16_t)rtY_Right.n_mot;
-      Feedback.speedL_meas	  = (int16_t)rtY_Left.n_mot;
-      Feedback.batVoltage	    = (int16_t)batVoltageCalib;
-      Feedback.boardTemp	    = (int16_t)board_temp_deg_c;
-
-      if(__HAL_DMA_GET_COUNTER(huart2.hdmatx) == 0) {
-        Feedback.cmdLed     = (uint16_t)sideboard_leds_L;
-        Feedback.checksum   = (uint16_t)(Feedback.start ^ Feedback.cmd1 ^ Feedback.cmd2 ^ Feedback.speedR_meas ^ Feedback.speedL_meas 
-                                        ^ Feedback.batVoltage ^ Feedback.boardTemp ^ Feedback.cmdLed);
-
-        HAL_UART_Transmit_DMA(&huart2, (uint8_t *)&Feedback, sizeof(Feedback));
-      }
-    }
-
-    // ####### POWEROFF BY POWER-BUTTON #######
-    // poweroffPressCheck();
-
-    // ####### BEEP AND EMERGENCY POWEROFF #######
-    if (TEMP_POWEROFF_ENABLE && board_temp_deg_c >= TEMP_POWEROFF && speedAvgAbs < 20){  // poweroff before mainboard burns OR low bat 3
-      printf("Powering off, temperature is too high\r\n");
-      poweroff();
-    } else if ( BAT_DEAD_ENABLE && batVoltage < BAT_DEAD && speedAvgAbs < 20){
-      printf("Powering off, battery voltage is too low\r\n");
-      poweroff();
-    } else if (rtY_Left.z_errCode || rtY_Right.z_errCode) {                                           // 1 beep (low pitch): Motor error, disable motors
-      enable = 0;
-      beepCount(1, 24, 1);
-    } else if (timeoutFlgADC) {                                                                       // 2 beeps (low pitch): ADC timeout
-      beepCount(2, 24, 1);
-    } else if (timeoutFlgSerial) {                                                                    // 3 beeps (low pitch): Serial timeout
-      beepCount(3, 24, 1);
-    } else if (timeoutFlgGen) {                                                                       // 4 beeps (low pitch): General timeout (PPM, PWM, Nunchuk)
-      beepCount(4, 24, 1);
-    } else if (TEMP_WARNING_ENABLE && board_temp_deg_c >= TEMP_WARNING) {                             // 5 beeps (low pitch): Mainboard temperature warning
-      beepCount(5, 24, 1);
-    } else if (BAT_LVL1_ENABLE && batVoltage < BAT_LVL1) {                                            // 1 beep fast (medium pitch): Low bat 1
-      beepCount(0, 10, 6);
-    } else if (BAT_LVL2_ENABLE && batVoltage < BAT_LVL2) {                                            // 1 beep slow (medium pitch): Low bat 2
-      beepCount(0, 10, 30);
-    } else if (BEEPS_BACKWARD && (((cmdR < -50 || cmdL < -50) && speedAvg < 0) || MultipleTapBrake.b_multipleTap)) { // 1 beep fast (high pitch): Backward spinning motors
-      beepCount(0, 5, 1);
-      backwardDrive = 1;
-    } else {  // do not beep
-      beepCount(0, 0, 0);
-      backwardDrive = 0;
-    }
-
-    // HAL_GPIO_TogglePin(LED_PORT, LED_PIN);                 // This is to measure the main() loop duration with an oscilloscope connected to LED_PIN
-    // Update states
-    inIdx_prev = inIdx;
-    buzzerTimer_prev = buzzerTimer;
-    main_loop_counter++;
-    }
-  }
+  Sched_Init(schedTasks);
+  Sched_Run();                                    // does not return
 }
 
 
 // ===========================================================
+/* Clock profiles, see CLOCK PROFILE in config.h. The GD32F103 PLL multiplier has a fifth bit (RCC_CFGR bit 27):
+ * x27 = 0b11010, the low four bits are the STM32 encoding of x12.
+*/
+#define RCC_CFGR_PLLMULL_GD32_4   (1UL << 27)
+
+typedef struct {
+  uint32_t pllSource;                   // RCC_PLLSOURCE_HSI_DIV2 or RCC_PLLSOURCE_HSE
+  uint32_t hsePrediv;                   // RCC_HSE_PREDIV_DIVx, HSE only
+  uint32_t pllMul;                      // RCC_PLL_MULx
+  uint32_t pllMulHi;                    // RCC_CFGR_PLLMULL_GD32_4 on GD32, else 0
+  uint32_t hz;                          // [Hz] core clock
+} ClockProfile;
+
+static const ClockProfile clockProfile[2][2] = {    // [GD32][HSE]
+  { { RCC_PLLSOURCE_HSI_DIV2, RCC_HSE_PREDIV_DIV1, RCC_PLL_MUL16, 0,                        64000000 },
+    { RCC_PLLSOURCE_HSE,      RCC_HSE_PREDIV_DIV1, RCC_PLL_MUL9,  0,                        72000000 } },
+  { { RCC_PLLSOURCE_HSI_DIV2, RCC_HSE_PREDIV_DIV1, RCC_PLL_MUL12, RCC_CFGR_PLLMULL_GD32_4, 108000000 },
+    { RCC_PLLSOURCE_HSE,      RCC_HSE_PREDIV_DIV2, RCC_PLL_MUL12, RCC_CFGR_PLLMULL_GD32_4, 108000000 } }
+};
+
+// GD32F103: Cortex-M3 r2p1, STM32F103: r1p1
+static uint8_t mcuIsGD32(void) {
+  #ifdef CLOCK_GD32_108
+  return ((SCB->CPUID & SCB_CPUID_VARIANT_Msk) >> SCB_CPUID_VARIANT_Pos) >= 2;
+  #else
+  return 0;
+  #endif
+}
+
+static HAL_StatusTypeDef clockPllConfig(const ClockProfile *clk) {
+  RCC_OscInitTypeDef RCC_OscInitStruct = {0};
+
+  if (clk->pllSource == RCC_PLLSOURCE_HSE) {
+    RCC_OscInitStruct.OscillatorType    = RCC_OSCILLATORTYPE_HSE;
+    RCC_OscInitStruct.HSEState          = RCC_HSE_ON;
+    RCC_OscInitStruct.HSEPredivValue    = clk->hsePrediv;
+  } else {
+    RCC_OscInitStruct.OscillatorType    = RCC_OSCILLATORTYPE_HSI;
+    RCC_OscInitStruct.HSIState          = RCC_HSI_ON;
+    RCC_OscInitStruct.HSICalibrationValue = 16;
+  }
+  RCC_OscInitStruct.PLL.PLLState        = RCC_PLL_ON;
+  RCC_OscInitStruct.PLL.PLLSource       = clk->pllSource;
+  RCC_OscInitStruct.PLL.PLLMUL          = clk->pllMul;
+  MODIFY_REG(RCC->CFGR, RCC_CFGR_PLLMULL_GD32_4, clk->pllMulHi);   // PLL still off, HAL keeps this bit
+  return HAL_RCC_OscConfig(&RCC_OscInitStruct);
+}
+
 /** System Clock Configuration
 */
 void SystemClock_Config(void) {
-  RCC_OscInitTypeDef RCC_OscInitStruct;
   RCC_ClkInitTypeDef RCC_ClkInitStruct;
   RCC_PeriphCLKInitTypeDef PeriphClkInit;
+  const ClockProfile *clk = &clockProfile[mcuIsGD32()][0];
 
   /**Initializes the CPU, AHB and APB busses clocks
     */
-  RCC_OscInitStruct.OscillatorType      = RCC_OSCILLATORTYPE_HSI;
-  RCC_OscInitStruct.HSIState            = RCC_HSI_ON;
-  RCC_OscInitStruct.HSICalibrationValue = 16;
-  RCC_OscInitStruct.PLL.PLLState        = RCC_PLL_ON;
-  RCC_OscInitStruct.PLL.PLLSource       = RCC_PLLSOURCE_HSI_DIV2;
-  RCC_OscInitStruct.PLL.PLLMUL          = RCC_PLL_MUL16;
-  HAL_RCC_OscConfig(&RCC_OscInitStruct);
+  #ifdef CLOCK_HSE
+  if (clockPllConfig(clk + 1) == HAL_OK) {
+    clk++;
+  } else {                              // no crystal: internal oscillator
+    __HAL_RCC_HSE_CONFIG(RCC_HSE_OFF);
+    clockPllConfig(clk);
+  }
+  #else
+  clockPllConfig(clk);
+  #endif
 
   /**Initializes the CPU, AHB and APB busses clocks
     */
   RCC_ClkInitStruct.ClockType           = RCC_CLOCKTYPE_HCLK | RCC_CLOCKTYPE_SYSCLK | RCC_CLOCKTYPE_PCLK1 | RCC_CLOCKTYPE_PCLK2;
   RCC_ClkInitStruct.SYSCLKSource        = RCC_SYSCLKSOURCE_PLLCLK;
   RCC_ClkInitStruct.AHBCLKDivider       = RCC_SYSCLK_DIV1;
-  RCC_ClkInitStruct.APB1CLKDivider      = RCC_HCLK_DIV2;
+  RCC_ClkInitStruct.APB1CLKDivider      = RCC_HCLK_DIV2;    // 32 / 36 / 54 MHz, timers x2
   RCC_ClkInitStruct.APB2CLKDivider      = RCC_HCLK_DIV1;
 
   HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_2);
+  SystemCoreClock = clk->hz;            // the HAL does not know the fifth GD32 multiplier bit
 
   PeriphClkInit.PeriphClockSelection    = RCC_PERIPHCLK_ADC;
-  // PeriphClkInit.AdcClockSelection    = RCC_ADCPCLK2_DIV8;  // 8 MHz
-  PeriphClkInit.AdcClockSelection       = RCC_ADCPCLK2_DIV4;  // 16 MHz
+  PeriphClkInit.AdcClockSelection       = (ADC_CLOCK_DIV_AT(clk->hz) / 2 - 1) << RCC_CFGR_ADCPRE_Pos;  // RCC_ADCPCLK2_DIVx, <= CLOCK_ADC_MAX
   HAL_RCCEx_PeriphCLKConfig(&PeriphClkInit);
 
   /**Configure the Systick interrupt time
@@ -0,0 +1,115 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Execution time profiler for the PWM interrupt. Sections are bracketed with
+ * PROF_START()/PROF_STOP() in bldc.c; the statistics are printed on the debug
+ * serial (USART3) from the main loop, one section at a time, and reset after each
+ * print, so every report covers the time since the previous one.
+ */
+
+// Includes
+#include <stdio.h>
+#include <string.h>
+#include "stm32f1xx_hal.h"
+#include "config.h"
+#include "profiler.h"
+
+/* =========================== Variable Definitions =========================== */
+
+static const char *const profName[PROF_SECTIONS] = { "isr", "io", "buzzer", "left", "right", "ctrl", "slow" };
+static volatile ProfStat profStat[PROF_SECTIONS];
+
+/* =========================== Profiler Functions =========================== */
+
+void Prof_Init(void) {
+  #ifndef PROF_HOST
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;   // enable the DWT unit
+  DWT->CYCCNT       = 0;
+  DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;       // start the cycle counter
+  #endif
+  Prof_Reset();
+}
+
+void Prof_Reset(void) {
+  for (int i = 0; i < PROF_SECTIONS; i++) {
+    __disable_irq();
+    memset((void *)&profStat[i], 0, sizeof(ProfStat));
+    profStat[i].min = UINT32_MAX;
+    __enable_irq();
+  }
+}
+
+/*
+ * Add one execution time sample. Called from the PWM interrupt.
+ * Inputs:       s   = profiled section
+ *               cyc = elapsed cycles
+ */
+void Prof_Record(ProfSection s, uint32_t cyc) {
+  volatile ProfStat *p = &profStat[s];
+  uint32_t bin = cyc / PROF_BIN_CYC;
+
+  p->cnt++;
+  p->sum += cyc;
+  if (cyc < p->min) { p->min = cyc; }
+  if (cyc > p->max) { p->max = cyc; }
+  p->hist[(bin < PROF_HIST_BINS) ? bin : (PROF_HIST_BINS - 1)]++;
+}
+
+/*
+ * Consistent copy of one section. The interrupt is held off only for the copy of
+ * a single section to keep the added latency small.
+ */
+void Prof_Snapshot(ProfSection s, ProfStat *out) {
+  __disable_irq();
+  memcpy(out, (const void *)&profStat[s], sizeof(ProfStat));
+  __enable_irq();
+}
+
+/*
+ * Print the statistics of the next section in turn and restart its window. One line
+ * per call keeps the blocking printf on USART3 short.
+ */
+void Prof_PrintNext(void) {
+  static uint8_t idx = 0;
+  ProfStat st;
+
+  __disable_irq();
+  memcpy(&st, (const void *)&profStat[idx], sizeof(ProfStat));
+  memset((void *)&profStat[idx], 0, sizeof(ProfStat));
+  profStat[idx].min = UINT32_MAX;
+  __enable_irq();
+
+  if (st.cnt) {
+    printf("prof %s n:%lu min:%lu max:%lu avg:%lu maxload:%lu%% bin:%u hist:",
+      profName[idx],
+      (unsigned long)st.cnt,
+      (unsigned long)st.min,
+      (unsigned long)st.max,
+      (unsigned long)(st.sum / st.cnt),
+      (unsigned long)(st.max * 100 / PROF_BUDGET_CYC),
+      (unsigned)PROF_BIN_CYC);
+    for (int k = 0; k < PROF_HIST_BINS; k++) {
+      printf(k ? ",%lu" : "%lu", (unsigned long)st.hist[k]);
+    }
+    printf("\r\n");
+  }
+
+  if (++idx >= PROF_SECTIONS) {
+    idx = 0;
+  }
+}
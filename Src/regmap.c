@@ -0,0 +1,287 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Register map on USART3: batched reads and writes of controller parameters and
+ * signals with binary request frames (see regmap.h), answered with one response
+ * frame each. Requests are scanned in the main loop (SCHED_RX task). A write batch
+ * is range checked completely, then copied into rtP_Left and rtP_Right with the
+ * interrupts off. The main loop only runs when neither the PWM interrupt nor the
+ * slow controller tasks (PendSV) are in the middle of a step, so every control step
+ * sees all values of a batch or none. Parameters can be saved to EEPROM in one
+ * batch and are loaded again at boot by Reg_Load().
+ */
+
+// Includes
+#include <stdio.h>
+#include <string.h>
+#include "stm32f1xx_hal.h"
+#include "defines.h"
+#include "config.h"
+#include "eeprom.h"
+#include "util.h"
+#include "logger.h"
+#include "regmap.h"
+#include "BLDC_controller.h"
+#include "rtwtypes.h"
+
+/* =========================== Variable Definitions =========================== */
+
+extern P        rtP_Left;
+extern P        rtP_Right;
+extern ExtY     rtY_Left;
+extern ExtY     rtY_Right;
+extern int16_t  dc_curr;
+extern int16_t  batVoltage;
+extern uint8_t  enable;
+extern uint16_t VirtAddVarTab[NB_OF_VAR];
+
+const char *const regName[REGS] = {
+  "iqKp", "iqKi", "idKp", "idKi", "nKp", "nKi", "currFilt", "iMax", "nMax", "fwEna", "fwMax", "phaAdvMax", "fwHi", "fwLo",
+  "iqL", "idL", "nL", "errL", "iqR", "idR", "nR", "errR", "dcCurr", "batV"
+};
+
+enum { REG_U16, REG_I16, REG_U8 };
+
+typedef struct {
+  volatile void *addr;                  // signal, or the rtP_Left field of a parameter
+  void          *addrR;                 // rtP_Right field of a parameter, NULL = read only
+  uint8_t        type;
+  int32_t        min;                   // accepted range of a written value
+  int32_t        max;
+} RegDef;
+
+#define REG_PAR(f, t, lo, hi)   { &rtP_Left.f, &rtP_Right.f, (t), (lo), (hi) }
+#define REG_SIG(v, t)           { &(v), NULL, (t), 0, 0 }
+
+static const RegDef regDef[REGS] = {
+  [REG_IQ_KP]       = REG_PAR(cf_iqKp,         REG_U16, 0,          UINT16_MAX),
+  [REG_IQ_KI]       = REG_PAR(cf_iqKi,         REG_U16, 0,          UINT16_MAX),
+  [REG_ID_KP]       = REG_PAR(cf_idKp,         REG_U16, 0,          UINT16_MAX),
+  [REG_ID_KI]       = REG_PAR(cf_idKi,         REG_U16, 0,          UINT16_MAX),
+  [REG_N_KP]        = REG_PAR(cf_nKp,          REG_U16, 0,          UINT16_MAX),
+  [REG_N_KI]        = REG_PAR(cf_nKi,          REG_U16, 0,          UINT16_MAX),
+  [REG_CURR_FILT]   = REG_PAR(cf_currFilt,     REG_U16, 1,          UINT16_MAX),
+  [REG_I_MAX]       = REG_PAR(i_max,           REG_I16, 0,          (I_MOT_MAX * A2BIT_CONV) << 4),
+  [REG_N_MAX]       = REG_PAR(n_max,           REG_I16, 0,          INT16_MAX),
+  #ifdef BLDC_SPECIALISE
+  [REG_FW_ENA]      = REG_SIG(rtP_Left.b_fieldWeakEna, REG_U8),   // compiled in as FIELD_WEAK_ENA, see BLDC_controller_spec.h
+  #else
+  [REG_FW_ENA]      = REG_PAR(b_fieldWeakEna,  REG_U8,  0,          1),
+  #endif
+  [REG_FW_MAX]      = REG_PAR(id_fieldWeakMax, REG_I16, 0,          (I_MOT_MAX * A2BIT_CONV) << 4),
+  [REG_PHA_ADV_MAX] = REG_PAR(a_phaAdvMax,     REG_I16, 0,          60 << 4),
+  [REG_FW_HI]       = REG_PAR(r_fieldWeakHi,   REG_I16, 1001 << 4,  1500 << 4),
+  [REG_FW_LO]       = REG_PAR(r_fieldWeakLo,   REG_I16, 501 << 4,   1000 << 4),
+  [REG_IQ_L]        = REG_SIG(rtY_Left.iq,          REG_I16),
+  [REG_ID_L]        = REG_SIG(rtY_Left.id,          REG_I16),
+  [REG_N_L]         = REG_SIG(rtY_Left.n_mot,       REG_I16),
+  [REG_ERR_L]       = REG_SIG(rtY_Left.z_errCode,   REG_U8),
+  [REG_IQ_R]        = REG_SIG(rtY_Right.iq,         REG_I16),
+  [REG_ID_R]        = REG_SIG(rtY_Right.id,         REG_I16),
+  [REG_N_R]         = REG_SIG(rtY_Right.n_mot,      REG_I16),
+  [REG_ERR_R]       = REG_SIG(rtY_Right.z_errCode,  REG_U8),
+  [REG_DC_CURR]     = REG_SIG(dc_curr,              REG_I16),
+  [REG_BAT_V]       = REG_SIG(batVoltage,           REG_I16),
+};
+
+_Static_assert(REG_PARAMS <= NB_OF_VAR - REG_EE_KEY - 1, "one EEPROM variable per parameter");
+
+#ifdef BLDC_MULTIRATE
+  #define REG_SLOW_DIV      BLDC_SLOW_DIV
+#else
+  #define REG_SLOW_DIV      1
+#endif
+
+/* =========================== Register Functions =========================== */
+
+/*
+ * Key of the saved parameters. The gains and times are saved in the units of the running controller, rescaled for
+ * CTRL_FREQ and BLDC_SLOW_DIV (see BLDC_RateScale, BLDC_SlowScale): a build for another rate or another parameter
+ * set does not load them
+ */
+static uint16_t Reg_Key(void) {
+  static const uint16_t layout[] = { FLASH_REG_KEY, REG_PARAMS, CTRL_FREQ, REG_SLOW_DIV };
+  return calcCRC16(0xFFFF, (const uint8_t *)layout, sizeof(layout));
+}
+
+static uint16_t Reg_Get(const RegDef *r) {
+  switch (r->type) {
+    case REG_I16: return (uint16_t)*(const volatile int16_t *)r->addr;
+    case REG_U8:  return *(const volatile uint8_t *)r->addr;
+    default:      return *(const volatile uint16_t *)r->addr;
+  }
+}
+
+static void Reg_Set(const RegDef *r, uint16_t value) {
+  switch (r->type) {
+    case REG_I16: *(volatile int16_t *)r->addr  = (int16_t)value; *(int16_t *)r->addrR  = (int16_t)value; break;
+    case REG_U8:  *(volatile uint8_t *)r->addr  = (uint8_t)value; *(uint8_t *)r->addrR  = (uint8_t)value; break;
+    default:      *(volatile uint16_t *)r->addr = value;          *(uint16_t *)r->addrR = value;          break;
+  }
+}
+
+static int Reg_InRange(const RegDef *r, uint16_t value) {
+  int32_t v = (r->type == REG_I16) ? (int16_t)value : value;
+  return v >= r->min && v <= r->max;
+}
+
+/*
+ * Request length on the wire, 0 = unknown operation or too many items
+ */
+uint16_t Reg_FrameSize(uint8_t op, uint8_t n) {
+  if (n > REG_BATCH_MAX) {
+    return 0;
+  }
+  switch (op & ~REG_OP_SAVE) {
+    case REG_OP_READ:  return REG_HDR_SIZE + n + 2;
+    case REG_OP_WRITE: return REG_HDR_SIZE + n * REG_ITEM_SIZE + 2;
+    default:           return 0;
+  }
+}
+
+/*
+ * Load the parameters saved with REG_OP_SAVE. Called at boot after the configuration
+ * from config.h and EEPROM is in place, saved parameters take precedence over it.
+ * Values outside the range of their register and read only parameters are skipped.
+ */
+void Reg_Load(void) {
+  uint16_t key, value;
+  uint8_t  n = 0;
+
+  if (EE_ReadVariable(VirtAddVarTab[REG_EE_KEY], &key) != 0 || key != Reg_Key()) {
+    return;
+  }
+  for (int id = 0; id < REG_PARAMS; id++) {
+    if (regDef[id].addrR != NULL && EE_ReadVariable(VirtAddVarTab[REG_EE_KEY + 1 + id], &value) == 0 && Reg_InRange(&regDef[id], value)) {
+      Reg_Set(&regDef[id], value);
+      n++;
+    }
+  }
+  Input_Lim_Init();                     // follows b_fieldWeakEna
+  printf("Using %u register map parameters from EEprom\r\n", n);
+}
+
+/*
+ * Save all parameters in one EEPROM batch. The flash stalls the CPU, and the PWM
+ * interrupt with it, for the program and erase times, so only with the motors off.
+ */
+static RegStatus Reg_Save(void) {
+  uint16_t status;
+
+  HAL_FLASH_Unlock();
+  EE_WriteBegin();
+  EE_WriteVariable(VirtAddVarTab[REG_EE_KEY], Reg_Key());
+  for (int id = 0; id < REG_PARAMS; id++) {
+    EE_WriteVariable(VirtAddVarTab[REG_EE_KEY + 1 + id], Reg_Get(&regDef[id]));
+  }
+  status = EE_WriteCommit();
+  HAL_FLASH_Lock();
+
+  return (status == HAL_OK) ? REG_OK : REG_ERR_EEPROM;
+}
+
+/*
+ * Execute one request with a valid CRC and send the response.
+ * Inputs:       op, n = request header, item = the n request items
+ */
+static void Reg_Execute(uint8_t op, uint8_t n, const uint8_t *item) {
+  uint8_t   resp[REG_RESP_HDR_SIZE + REG_BATCH_MAX * REG_ITEM_SIZE + 2];
+  uint8_t   id[REG_BATCH_MAX];
+  uint16_t  value[REG_BATCH_MAX];
+  uint8_t   write = (op & ~REG_OP_SAVE) == REG_OP_WRITE;
+  uint8_t   status = REG_OK, index = 0;
+  uint16_t  len, crc;
+
+  for (index = 0; index < n; index++) {
+    id[index]    = write ? item[index * REG_ITEM_SIZE] : item[index];
+    value[index] = write ? (uint16_t)(item[index * REG_ITEM_SIZE + 1] | (item[index * REG_ITEM_SIZE + 2] << 8)) : 0;
+    if (id[index] >= REGS) {
+      status = REG_ERR_ID;
+    } else if (write && regDef[id[index]].addrR == NULL) {
+      status = REG_ERR_RO;
+    } else if (write && !Reg_InRange(&regDef[id[index]], value[index])) {
+      status = REG_ERR_RANGE;
+    } else {
+      continue;
+    }
+    break;
+  }
+  if (status == REG_OK && (op & REG_OP_SAVE)) {
+    status = !write ? REG_ERR_OP : (enable ? REG_ERR_BUSY : REG_OK);
+  }
+
+  if (status == REG_OK) {
+    __disable_irq();                    // between two control steps: all of the batch or nothing
+    for (uint8_t k = 0; write && k < n; k++) {
+      Reg_Set(&regDef[id[k]], value[k]);
+    }
+    for (uint8_t k = 0; k < n; k++) {
+      value[k] = Reg_Get(&regDef[id[k]]);
+    }
+    __enable_irq();
+    if (write) {
+      Input_Lim_Init();                 // follows b_fieldWeakEna
+    }
+    if (op & REG_OP_SAVE) {
+      status = Reg_Save();
+    }
+  }
+
+  resp[0] = (uint8_t)REG_RESP_FRAME;
+  resp[1] = (uint8_t)(REG_RESP_FRAME >> 8);
+  resp[2] = op;
+  resp[3] = n;
+  resp[4] = status;
+  resp[5] = index;
+  len     = REG_RESP_HDR_SIZE;
+  for (uint8_t k = 0; status == REG_OK && k < n; k++) {
+    resp[len++] = id[k];
+    resp[len++] = (uint8_t)value[k];
+    resp[len++] = (uint8_t)(value[k] >> 8);
+  }
+  crc         = calcCRC16(0xFFFF, resp, len);
+  resp[len++] = (uint8_t)crc;
+  resp[len++] = (uint8_t)(crc >> 8);
+
+  Log_Write((const char *)resp, len);   // queued with the debug text, never in the way of the telemetry frames
+}
+
+/*
+ * Scan received USART3 data for register requests. A request must arrive within one
+ * chunk, frames with a wrong CRC are ignored and get no response.
+ */
+void Reg_Command(const uint8_t *data, uint32_t len) {
+  RegHeader hdr;
+  uint16_t  size, crc;
+
+  for (uint32_t i = 0; i + REG_HDR_SIZE <= len; i++) {
+    memcpy(&hdr, &data[i], sizeof(hdr));
+    if (hdr.start != REG_START_FRAME) {
+      continue;
+    }
+    size = Reg_FrameSize(hdr.op, hdr.n);
+    if (size == 0 || i + size > len) {
+      continue;
+    }
+    memcpy(&crc, &data[i + size - 2], sizeof(crc));
+    if (crc == calcCRC16(0xFFFF, &data[i], size - 2U)) {
+      Reg_Execute(hdr.op, hdr.n, &data[i + REG_HDR_SIZE]);
+      i += size - 1U;
+    }
+  }
+}
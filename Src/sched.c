@@ -0,0 +1,172 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Cooperative main loop scheduler. Tasks are released periodically on the PWM period
+ * counter (buzzerTimer) and/or by an interrupt through Sched_Signal(); ready tasks run
+ * to completion in the order of SchedTaskId. With nothing ready the core sleeps in WFI
+ * until the next interrupt, at the latest the next PWM interrupt.
+ * Per task the run time (DWT cycles) and the start delay after the release (jitter, in
+ * PWM periods) are recorded; the core load is the time spent outside WFI.
+ */
+
+// Includes
+#include <stdio.h>
+#include <string.h>
+#include "stm32f1xx_hal.h"
+#include "config.h"
+#include "profiler.h"
+#include "sched.h"
+
+extern volatile uint32_t buzzerTimer;
+
+/* =========================== Variable Definitions =========================== */
+
+static const SchedTask   *schedTask;
+static SchedStat          schedStat[SCHED_TASKS];
+static uint32_t           schedNext[SCHED_TASKS];       // [PWM periods] next periodic release
+static volatile uint32_t  schedEvtTick[SCHED_TASKS];    // [PWM periods] release by Sched_Signal()
+static volatile uint32_t  schedEvt;                     // pending Sched_Signal() releases, one bit per task
+static uint64_t           schedIdleCyc;                 // [cycles] spent in WFI, incl. the interrupts that ended it
+static uint32_t           schedWinStart;                // [cycles] start of the load window
+
+/* =========================== Scheduler Functions =========================== */
+
+void Sched_Init(const SchedTask *tasks) {
+  uint32_t now = buzzerTimer;
+
+  #ifndef PROF_HOST
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;   // enable the DWT unit, run times in cycles also without PROFILER_ENABLE
+  DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+  #endif
+
+  schedTask = tasks;
+  memset(schedStat, 0, sizeof(schedStat));
+  for (int i = 0; i < SCHED_TASKS; i++) {
+    schedNext[i] = now + tasks[i].offset;
+  }
+  schedEvt      = 0;
+  schedIdleCyc  = 0;
+  schedWinStart = PROF_CYCLES();
+}
+
+/*
+ * Release a task once. Called from interrupts; a release that is still pending keeps
+ * its original time stamp, so the jitter covers the oldest unserved event.
+ */
+void Sched_Signal(SchedTaskId id) {
+  uint32_t bit = 1UL << id;
+
+  if (!(schedEvt & bit)) {
+    schedEvtTick[id] = buzzerTimer;
+  }
+  __atomic_fetch_or(&schedEvt, bit, __ATOMIC_RELEASE);
+}
+
+static void Sched_Exec(SchedTaskId id, uint32_t release) {
+  SchedStat *s   = &schedStat[id];
+  uint32_t   jit = buzzerTimer - release;
+  uint32_t   t0  = PROF_CYCLES();
+  uint32_t   cyc;
+
+  schedTask[id].fcn();
+
+  cyc = PROF_CYCLES() - t0;
+  s->cnt++;
+  s->cycSum += cyc;
+  s->jitSum += jit;
+  if (cyc > s->cycMax) { s->cycMax = cyc; }
+  if (jit > s->jitMax) { s->jitMax = jit; }
+}
+
+/*
+ * Run the ready tasks in priority order and sleep when none is ready. Does not return.
+ */
+void Sched_Run(void) {
+  while (1) {
+    uint8_t ran = 0;
+
+    for (int i = 0; i < SCHED_TASKS; i++) {
+      const SchedTask *t   = &schedTask[i];
+      uint32_t         now = buzzerTimer;
+      uint32_t         bit = 1UL << i;
+
+      if (t->period && (int32_t)(now - schedNext[i]) >= 0) {     // periodic release
+        uint32_t skip = (now - schedNext[i]) / t->period;         // releases missed completely
+        uint32_t release = schedNext[i] + skip * t->period;
+        schedStat[i].late += skip;
+        schedNext[i] = release + t->period;                       // keep the phase, no drift
+        __atomic_fetch_and(&schedEvt, ~bit, __ATOMIC_ACQUIRE);    // a pending event is served by this run
+        Sched_Exec((SchedTaskId)i, release);
+        ran = 1;
+      } else if (schedEvt & bit) {                                // event release
+        uint32_t release = schedEvtTick[i];
+        __atomic_fetch_and(&schedEvt, ~bit, __ATOMIC_ACQUIRE);
+        Sched_Exec((SchedTaskId)i, release);
+        ran = 1;
+      }
+    }
+
+    if (!ran) {
+      #ifdef SCHED_IDLE_WFI
+      uint32_t t0 = PROF_CYCLES();
+      __disable_irq();                  // an event signalled after the check above still ends the WFI
+      if (!schedEvt) {
+        __WFI();
+      }
+      __enable_irq();                   // the waking interrupt runs here
+      schedIdleCyc += PROF_CYCLES() - t0;
+      #endif
+    }
+  }
+}
+
+void Sched_Snapshot(SchedTaskId id, SchedStat *out) {
+  *out = schedStat[id];                 // only the main loop writes the statistics
+}
+
+/*
+ * Print the statistics of the next task in turn and restart its window, after the last
+ * task the core load since the previous load line. One line per call, see Prof_PrintNext().
+ */
+void Sched_PrintNext(void) {
+  static uint8_t idx = 0;
+  SchedStat st = schedStat[idx];
+
+  memset(&schedStat[idx], 0, sizeof(SchedStat));
+  if (st.cnt) {
+    printf("sched %s n:%lu max:%lu avg:%lu cyc jit:%lu/%lu us late:%lu\r\n",
+      schedTask[idx].name,
+      (unsigned long)st.cnt,
+      (unsigned long)st.cycMax,
+      (unsigned long)(st.cycSum / st.cnt),
+      (unsigned long)SCHED_TICK_US(st.jitSum / st.cnt),
+      (unsigned long)SCHED_TICK_US(st.jitMax),
+      (unsigned long)st.late);
+  }
+
+  if (++idx >= SCHED_TASKS) {
+    uint32_t now = PROF_CYCLES();
+    uint32_t win = now - schedWinStart;
+    idx = 0;
+    #ifdef SCHED_IDLE_WFI
+    printf("sched load:%lu%%\r\n", win ? (unsigned long)(100 - (schedIdleCyc * 100 / win)) : 0UL);
+    #endif
+    schedIdleCyc  = 0;
+    schedWinStart = now;
+  }
+}
@@ -24,6 +24,9 @@ tim1 master, enable -> trgo
 tim8, gated slave mode, trgo by tim1 trgo. overflow -> trgo
 adc1,adc2 triggered by tim8 trgo
 adc 1,2 dual mode
+ADC_INJ_ENABLE: currents injected, triggered by tim8 cc4. vbat, temp, l_tx, l_rx regular, software start
+PWM_PHASE_SHIFT > 0: adc1,adc2 independent. adc1 injected right currents by tim1 cc4, adc2 injected left currents by tim8 cc4,
+                     adc1 regular vbat, l_tx, temp, l_rx
 
 ADC1             ADC2
 R_Blau PC4 CH14  R_Gelb PC5 CH15
@@ -41,6 +44,7 @@ pb10 usart3 dma1 channel2/3
 
 TIM_HandleTypeDef htim_right;
 TIM_HandleTypeDef htim_left;
+TIM_HandleTypeDef htim_buzzer;
 ADC_HandleTypeDef hadc1;
 ADC_HandleTypeDef hadc2;
 I2C_HandleTypeDef hi2c2;
@@ -383,6 +387,14 @@ void MX_GPIO_Init(void) {
   GPIO_InitStruct.Pin = CHARGER_PIN;
   HAL_GPIO_Init(CHARGER_PORT, &GPIO_InitStruct);
 
+  #ifdef OC_TRIP_BKIN
+  GPIO_InitStruct.Pin = LEFT_OC_BKIN_PIN;
+  HAL_GPIO_Init(LEFT_OC_BKIN_PORT, &GPIO_InitStruct);
+
+  GPIO_InitStruct.Pin = RIGHT_OC_BKIN_PIN;
+  HAL_GPIO_Init(RIGHT_OC_BKIN_PORT, &GPIO_InitStruct);
+  #endif
+
   GPIO_InitStruct.Pull = GPIO_NOPULL;
 
   GPIO_InitStruct.Pin = BUTTON_PIN;
@@ -469,6 +481,19 @@ void MX_GPIO_Init(void) {
   HAL_GPIO_Init(RIGHT_TIM_WL_PORT, &GPIO_InitStruct);
 }
 
+#if PWM_FREQ % CTRL_FREQ != 0 || PWM_CTRL_DIV < 1 || PWM_CTRL_DIV > 128
+  #error PWM_FREQ must be 1 .. 128 times CTRL_FREQ (TIM8 repetition counter)
+#endif
+#if defined(ADC_INJ_ENABLE) && PWM_CTRL_DIV > 1
+  #error ADC_INJ_ENABLE triggers on every PWM period (TIM8 CC4) and needs PWM_FREQ = CTRL_FREQ
+#endif
+#if PWM_PHASE_SHIFT < 0 || PWM_PHASE_SHIFT > 180
+  #error PWM_PHASE_SHIFT must be 0 .. 180 deg
+#endif
+#if PWM_PHASE_SHIFT > 0 && !defined(ADC_INJ_ENABLE)
+  #error PWM_PHASE_SHIFT needs ADC_INJ_ENABLE (one injected trigger per bridge)
+#endif
+
 void MX_TIM_Init(void) {
   __HAL_RCC_TIM1_CLK_ENABLE();
   __HAL_RCC_TIM8_CLK_ENABLE();
@@ -481,7 +506,7 @@ void MX_TIM_Init(void) {
   htim_right.Instance               = RIGHT_TIM;
   htim_right.Init.Prescaler         = 0;
   htim_right.Init.CounterMode       = TIM_COUNTERMODE_CENTERALIGNED1;
-  htim_right.Init.Period            = 64000000 / 2 / PWM_FREQ;
+  htim_right.Init.Period            = SystemCoreClock / 2 / PWM_FREQ;
   htim_right.Init.ClockDivision     = TIM_CLOCKDIVISION_DIV1;
   htim_right.Init.RepetitionCounter = 0;
   htim_right.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
@@ -502,11 +527,22 @@ void MX_TIM_Init(void) {
   HAL_TIM_PWM_ConfigChannel(&htim_right, &sConfigOC, TIM_CHANNEL_2);
   HAL_TIM_PWM_ConfigChannel(&htim_right, &sConfigOC, TIM_CHANNEL_3);
 
+  #if PWM_PHASE_SHIFT > 0
+  // ADC1 injected trigger (TIM1 CC4): right bridge sample at the top of its counter, like TIM8 CC4 for the left one
+  sConfigOC.OCMode       = TIM_OCMODE_TIMING;
+  sConfigOC.Pulse        = SystemCoreClock / 2 / PWM_FREQ - 1;
+  HAL_TIM_OC_ConfigChannel(&htim_right, &sConfigOC, TIM_CHANNEL_4);
+  #endif
+
   sBreakDeadTimeConfig.OffStateRunMode  = TIM_OSSR_ENABLE;
   sBreakDeadTimeConfig.OffStateIDLEMode = TIM_OSSI_ENABLE;
   sBreakDeadTimeConfig.LockLevel        = TIM_LOCKLEVEL_OFF;
-  sBreakDeadTimeConfig.DeadTime         = DEAD_TIME;
+  sBreakDeadTimeConfig.DeadTime         = DEAD_TIME * (SystemCoreClock / 1000000) / 64;   // < 128: linear range of DTG
+  #ifdef OC_TRIP_BKIN
+  sBreakDeadTimeConfig.BreakState       = TIM_BREAK_ENABLE;   // overcurrent comparator: MOE cleared in hardware
+  #else
   sBreakDeadTimeConfig.BreakState       = TIM_BREAK_DISABLE;
+  #endif
   sBreakDeadTimeConfig.BreakPolarity    = TIM_BREAKPOLARITY_LOW;
   sBreakDeadTimeConfig.AutomaticOutput  = TIM_AUTOMATICOUTPUT_DISABLE;
   HAL_TIMEx_ConfigBreakDeadTime(&htim_right, &sBreakDeadTimeConfig);
@@ -514,7 +550,7 @@ void MX_TIM_Init(void) {
   htim_left.Instance               = LEFT_TIM;
   htim_left.Init.Prescaler         = 0;
   htim_left.Init.CounterMode       = TIM_COUNTERMODE_CENTERALIGNED1;
-  htim_left.Init.Period            = 64000000 / 2 / PWM_FREQ;
+  htim_left.Init.Period            = SystemCoreClock / 2 / PWM_FREQ;
   htim_left.Init.ClockDivision     = TIM_CLOCKDIVISION_DIV1;
   htim_left.Init.RepetitionCounter = 0;
   htim_left.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
@@ -529,8 +565,9 @@ void MX_TIM_Init(void) {
   HAL_TIM_SlaveConfigSynchronization(&htim_left, &sTimConfig);
 
   // Start counting >0 to effectively offset timers by the time it takes for one ADC conversion to complete.
-  // This method allows that the Phase currents ADC measurements are properly aligned with LOW-FET ON region for both motors
-  LEFT_TIM->CNT 		     = ADC_TOTAL_CONV_TIME;
+  // This method allows that the Phase currents ADC measurements are properly aligned with LOW-FET ON region for both motors.
+  // PWM_PHASE_SHIFT adds the phase lead on top, each bridge is then sampled by its own trigger
+  LEFT_TIM->CNT 		     = PWM_LEFT_LEAD(SystemCoreClock / 2 / PWM_FREQ, PWM_PHASE_SHIFT);
 
   sConfigOC.OCMode       = TIM_OCMODE_PWM1;
   sConfigOC.Pulse        = 0;
@@ -543,11 +580,23 @@ void MX_TIM_Init(void) {
   HAL_TIM_PWM_ConfigChannel(&htim_left, &sConfigOC, TIM_CHANNEL_2);
   HAL_TIM_PWM_ConfigChannel(&htim_left, &sConfigOC, TIM_CHANNEL_3);
 
+  #ifdef ADC_INJ_ENABLE
+  // ADC injected trigger (TIM8 CC4): center-aligned mode 1 sets the compare flag only while counting down,
+  // one event per PWM period one tick after the top, at the same instant as the update TRGO
+  sConfigOC.OCMode       = TIM_OCMODE_TIMING;
+  sConfigOC.Pulse        = SystemCoreClock / 2 / PWM_FREQ - 1;
+  HAL_TIM_OC_ConfigChannel(&htim_left, &sConfigOC, TIM_CHANNEL_4);
+  #endif
+
   sBreakDeadTimeConfig.OffStateRunMode  = TIM_OSSR_ENABLE;
   sBreakDeadTimeConfig.OffStateIDLEMode = TIM_OSSI_ENABLE;
   sBreakDeadTimeConfig.LockLevel        = TIM_LOCKLEVEL_OFF;
-  sBreakDeadTimeConfig.DeadTime         = DEAD_TIME;
+  sBreakDeadTimeConfig.DeadTime         = DEAD_TIME * (SystemCoreClock / 1000000) / 64;   // < 128: linear range of DTG
+  #ifdef OC_TRIP_BKIN
+  sBreakDeadTimeConfig.BreakState       = TIM_BREAK_ENABLE;   // overcurrent comparator: MOE cleared in hardware
+  #else
   sBreakDeadTimeConfig.BreakState       = TIM_BREAK_DISABLE;
+  #endif
   sBreakDeadTimeConfig.BreakPolarity    = TIM_BREAKPOLARITY_LOW;
   sBreakDeadTimeConfig.AutomaticOutput  = TIM_AUTOMATICOUTPUT_DISABLE;
   HAL_TIMEx_ConfigBreakDeadTime(&htim_left, &sBreakDeadTimeConfig);
@@ -561,6 +610,9 @@ void MX_TIM_Init(void) {
   HAL_TIMEx_PWMN_Start(&htim_left, TIM_CHANNEL_1);
   HAL_TIMEx_PWMN_Start(&htim_left, TIM_CHANNEL_2);
   HAL_TIMEx_PWMN_Start(&htim_left, TIM_CHANNEL_3);  
+  #ifdef ADC_INJ_ENABLE
+  HAL_TIM_OC_Start(&htim_left, TIM_CHANNEL_4);
+  #endif
 
   HAL_TIM_PWM_Start(&htim_right, TIM_CHANNEL_1);
   HAL_TIM_PWM_Start(&htim_right, TIM_CHANNEL_2);
@@ -568,12 +620,85 @@ void MX_TIM_Init(void) {
   HAL_TIMEx_PWMN_Start(&htim_right, TIM_CHANNEL_1);
   HAL_TIMEx_PWMN_Start(&htim_right, TIM_CHANNEL_2);
   HAL_TIMEx_PWMN_Start(&htim_right, TIM_CHANNEL_3);
+  #if PWM_PHASE_SHIFT > 0
+  HAL_TIM_OC_Start(&htim_right, TIM_CHANNEL_4);
+  #endif
 
-  htim_left.Instance->RCR = 1;
+  htim_left.Instance->RCR = 2 * PWM_CTRL_DIV - 1;  // center-aligned: one update (TRGO, ADC trigger) every PWM_CTRL_DIV periods
 
   __HAL_TIM_ENABLE(&htim_right);
 }
 
+/*
+ * Buzzer timer: counts half buzzer periods (BUZZER_TIM_FREQ), the update interrupt (TIM6_IRQHandler in bldc.c) toggles the buzzer pin
+ * and sets the time to the next toggle. Lowest priority, the PWM interrupt preempts it
+ */
+void MX_BUZZER_TIM_Init(void) {
+  __HAL_RCC_TIM6_CLK_ENABLE();
+
+  htim_buzzer.Instance               = BUZZER_TIM;
+  htim_buzzer.Init.Prescaler         = SystemCoreClock / 2 / BUZZER_TIM_FREQ - 1; // APB1 timer clock = core clock, two counts per buzzer period (ARR = 0 stops the counter)
+  htim_buzzer.Init.CounterMode       = TIM_COUNTERMODE_UP;
+  htim_buzzer.Init.Period            = 2 * BUZZER_TIM_IDLE - 1;
+  htim_buzzer.Init.ClockDivision     = TIM_CLOCKDIVISION_DIV1;
+  htim_buzzer.Init.RepetitionCounter = 0;
+  htim_buzzer.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE; // a new period starts with the next update
+  HAL_TIM_Base_Init(&htim_buzzer);
+
+  HAL_NVIC_SetPriority(BUZZER_TIM_IRQn, 15, 0);
+  HAL_NVIC_EnableIRQ(BUZZER_TIM_IRQn);
+  HAL_TIM_Base_Start_IT(&htim_buzzer);
+}
+
+#ifdef ADC_INJ_ENABLE
+/*
+ * Injected group of ADC1 or ADC2: DC link current (1.5 cycles) and two phase currents (7.5 cycles),
+ * same order and sample times as ranks 1..3 of the regular scan without ADC_INJ_ENABLE. Results in JDR1..3
+ */
+static void MX_ADC_InjectedInit(ADC_HandleTypeDef *hadc, uint32_t trigger, uint32_t chDc, uint32_t chPh1, uint32_t chPh2) {
+  ADC_InjectionConfTypeDef sConfigInj;
+
+  sConfigInj.InjectedNbrOfConversion       = 3;
+  sConfigInj.InjectedDiscontinuousConvMode = DISABLE;
+  sConfigInj.AutoInjectedConv              = DISABLE;
+  sConfigInj.ExternalTrigInjecConv         = trigger;
+  sConfigInj.InjectedOffset                = 0;
+
+  sConfigInj.InjectedSamplingTime = ADC_SAMPLETIME_1CYCLE_5;
+  sConfigInj.InjectedChannel      = chDc;
+  sConfigInj.InjectedRank         = ADC_INJECTED_RANK_1;
+  HAL_ADCEx_InjectedConfigChannel(hadc, &sConfigInj);
+
+  sConfigInj.InjectedSamplingTime = ADC_SAMPLETIME_7CYCLES_5;
+  sConfigInj.InjectedChannel      = chPh1;
+  sConfigInj.InjectedRank         = ADC_INJECTED_RANK_2;
+  HAL_ADCEx_InjectedConfigChannel(hadc, &sConfigInj);
+
+  sConfigInj.InjectedChannel      = chPh2;
+  sConfigInj.InjectedRank         = ADC_INJECTED_RANK_3;
+  HAL_ADCEx_InjectedConfigChannel(hadc, &sConfigInj);
+}
+#endif
+
+/*
+ * OC_TRIP_AWD: analog watchdog on the DC link current channel, interrupt on ADC1_2_IRQn. The window stays fully open
+ * (never trips) until the PWM interrupt sets it around the measured offset
+ */
+static void MX_ADC_WatchdogInit(ADC_HandleTypeDef *hadc, uint32_t chDc) {
+  #ifdef OC_TRIP_AWD
+  hadc->Instance->HTR  = 0xFFF;
+  hadc->Instance->LTR  = 0;
+  #ifdef ADC_INJ_ENABLE
+  hadc->Instance->CR1 |= ADC_CR1_JAWDEN | ADC_CR1_AWDSGL | ADC_CR1_AWDIE | (chDc << ADC_CR1_AWDCH_Pos);
+  #else
+  hadc->Instance->CR1 |= ADC_CR1_AWDEN  | ADC_CR1_AWDSGL | ADC_CR1_AWDIE | (chDc << ADC_CR1_AWDCH_Pos);
+  #endif
+  #else
+  (void)hadc;
+  (void)chDc;
+  #endif
+}
+
 void MX_ADC1_Init(void) {
   ADC_MultiModeTypeDef multimode;
   ADC_ChannelConfTypeDef sConfig;
@@ -584,8 +709,87 @@ void MX_ADC1_Init(void) {
   hadc1.Init.ScanConvMode          = ADC_SCAN_ENABLE;
   hadc1.Init.ContinuousConvMode    = DISABLE;
   hadc1.Init.DiscontinuousConvMode = DISABLE;
-  hadc1.Init.ExternalTrigConv      = ADC_EXTERNALTRIGCONV_T8_TRGO;
   hadc1.Init.DataAlign             = ADC_DATAALIGN_RIGHT;
+  #ifdef ADC_INJ_ENABLE
+  hadc1.Init.ExternalTrigConv      = ADC_SOFTWARE_START;   // slow scan, started by the PWM interrupt
+  hadc1.Init.NbrOfConversion       = 2;
+  HAL_ADC_Init(&hadc1);
+  /**Enable or disable the remapping of ADC1_ETRGINJ:
+    * ADC1 External Event injected conversion is connected to TIM8 Channel4
+    */
+  #if PWM_PHASE_SHIFT > 0
+  // Independent ADCs: ADC1 samples the right bridge at the top of TIM1, ADC2 the left bridge at the top of TIM8
+  multimode.Mode = ADC_MODE_INDEPENDENT;
+  HAL_ADCEx_MultiModeConfigChannel(&hadc1, &multimode);
+
+  MX_ADC_InjectedInit(&hadc1, ADC_EXTERNALTRIGINJECCONV_T1_CC4, ADC_CHANNEL_11, ADC_CHANNEL_14, ADC_CHANNEL_15);  // pc1 left cur -> right, pc4 left b -> right, pc5 left c -> right
+  #else
+  __HAL_AFIO_REMAP_ADC1_ETRGINJ_ENABLE();
+
+  /**Configure the ADC multi-mode
+    */
+  multimode.Mode = ADC_DUALMODE_REGSIMULT_INJECSIMULT;
+  HAL_ADCEx_MultiModeConfigChannel(&hadc1, &multimode);
+
+  MX_ADC_InjectedInit(&hadc1, ADC_EXTERNALTRIGINJECCONV_T8_CC4, ADC_CHANNEL_11, ADC_CHANNEL_0, ADC_CHANNEL_14);  // pc1 left cur -> right, pa0 right a -> left, pc4 left b -> right
+  #endif
+
+  sConfig.SamplingTime = ADC_SAMPLETIME_7CYCLES_5;
+  #if BOARD_VARIANT == 0
+  sConfig.Channel = ADC_CHANNEL_12;  // pc2 vbat
+  #elif BOARD_VARIANT == 1
+  sConfig.Channel = ADC_CHANNEL_1;   // pa1 vbat
+  #endif
+  sConfig.Rank    = 1;
+  HAL_ADC_ConfigChannel(&hadc1, &sConfig);
+
+  #if PWM_PHASE_SHIFT > 0
+  // The analog inputs of ADC2 in the dual mode, same buffer layout
+  sConfig.Channel = ADC_CHANNEL_2;  // pa2 uart-l-tx
+  sConfig.Rank    = 2;
+  HAL_ADC_ConfigChannel(&hadc1, &sConfig);
+
+  sConfig.SamplingTime = ADC_SAMPLETIME_239CYCLES_5;
+  sConfig.Channel = ADC_CHANNEL_TEMPSENSOR;  // internal temp
+  sConfig.Rank    = 3;
+  HAL_ADC_ConfigChannel(&hadc1, &sConfig);
+
+  sConfig.SamplingTime = ADC_SAMPLETIME_7CYCLES_5;
+  sConfig.Channel = ADC_CHANNEL_3;  // pa3 uart-l-rx
+  sConfig.Rank    = 4;
+  HAL_ADC_ConfigChannel(&hadc1, &sConfig);
+  #else
+  //temperature requires at least 17.1uS sampling time
+  sConfig.SamplingTime = ADC_SAMPLETIME_239CYCLES_5;
+  sConfig.Channel = ADC_CHANNEL_TEMPSENSOR;  // internal temp
+  sConfig.Rank    = 2;
+  HAL_ADC_ConfigChannel(&hadc1, &sConfig);
+  #endif
+
+  hadc1.Instance->CR1 |= ADC_CR1_JEOCIE;
+  hadc1.Instance->CR2 |= ADC_CR2_DMA | ADC_CR2_TSVREFE | ADC_CR2_EXTTRIG | ADC_CR2_JEXTTRIG;
+  MX_ADC_WatchdogInit(&hadc1, ADC_CHANNEL_11);
+
+  __HAL_ADC_ENABLE(&hadc1);
+
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  DMA1_Channel1->CCR   = 0;
+  DMA1_Channel1->CPAR  = (uint32_t) & (ADC1->DR);
+  DMA1_Channel1->CMAR  = (uint32_t)&adc_buffer.batt1;   // batt1 | l_tx2, temp | l_rx2
+  #if PWM_PHASE_SHIFT > 0
+  DMA1_Channel1->CNDTR = 4;
+  DMA1_Channel1->CCR   = DMA_CCR_MSIZE_0 | DMA_CCR_PSIZE_0 | DMA_CCR_MINC | DMA_CCR_CIRC;
+  #else
+  DMA1_Channel1->CNDTR = 2;
+  DMA1_Channel1->CCR   = DMA_CCR_MSIZE_1 | DMA_CCR_PSIZE_1 | DMA_CCR_MINC | DMA_CCR_CIRC;
+  #endif
+  DMA1_Channel1->CCR |= DMA_CCR_EN;
+
+  HAL_NVIC_SetPriority(ADC1_2_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(ADC1_2_IRQn);
+  #else
+  hadc1.Init.ExternalTrigConv      = ADC_EXTERNALTRIGCONV_T8_TRGO;
   hadc1.Init.NbrOfConversion       = 5;
   HAL_ADC_Init(&hadc1);
   /**Enable or disable the remapping of ADC1_ETRGREG:
@@ -628,6 +832,7 @@ void MX_ADC1_Init(void) {
   HAL_ADC_ConfigChannel(&hadc1, &sConfig);
 
   hadc1.Instance->CR2 |= ADC_CR2_DMA | ADC_CR2_TSVREFE;
+  MX_ADC_WatchdogInit(&hadc1, ADC_CHANNEL_11);
 
   __HAL_ADC_ENABLE(&hadc1);
 
@@ -642,11 +847,18 @@ void MX_ADC1_Init(void) {
 
   HAL_NVIC_SetPriority(DMA1_Channel1_IRQn, 0, 0);
   HAL_NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+  #ifdef OC_TRIP_AWD
+  HAL_NVIC_SetPriority(ADC1_2_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(ADC1_2_IRQn);
+  #endif
+  #endif
 }
 
 /* ADC2 init function */
 void MX_ADC2_Init(void) {
+  #if !defined(ADC_INJ_ENABLE) || PWM_PHASE_SHIFT == 0
   ADC_ChannelConfTypeDef sConfig;
+  #endif
 
   __HAL_RCC_ADC2_CLK_ENABLE();
 
@@ -660,6 +872,36 @@ void MX_ADC2_Init(void) {
   hadc2.Init.DiscontinuousConvMode = DISABLE;
   hadc2.Init.ExternalTrigConv      = ADC_SOFTWARE_START;
   hadc2.Init.DataAlign             = ADC_DATAALIGN_RIGHT;
+  #ifdef ADC_INJ_ENABLE
+  hadc2.Init.NbrOfConversion       = 2;
+  HAL_ADC_Init(&hadc2);
+
+  #if PWM_PHASE_SHIFT > 0
+  /**Enable or disable the remapping of ADC2_ETRGINJ:
+    * ADC2 External Event injected conversion is connected to TIM8 Channel4
+    */
+  __HAL_AFIO_REMAP_ADC2_ETRGINJ_ENABLE();
+
+  MX_ADC_InjectedInit(&hadc2, ADC_EXTERNALTRIGINJECCONV_T8_CC4, ADC_CHANNEL_10, ADC_CHANNEL_0, ADC_CHANNEL_13);  // pc0 right cur -> left, pa0 right a -> left, pc3 right b -> left
+
+  hadc2.Instance->CR2 |= ADC_CR2_JEXTTRIG;  // regular group converted by ADC1
+  #else
+  MX_ADC_InjectedInit(&hadc2, ADC_INJECTED_SOFTWARE_START, ADC_CHANNEL_10, ADC_CHANNEL_13, ADC_CHANNEL_15);  // pc0 right cur -> left, pc3 right b -> left, pc5 left c -> right
+
+  sConfig.SamplingTime = ADC_SAMPLETIME_7CYCLES_5;
+  sConfig.Channel = ADC_CHANNEL_2;  // pa2 uart-l-tx
+  sConfig.Rank    = 1;
+  HAL_ADC_ConfigChannel(&hadc2, &sConfig);
+
+  sConfig.Channel = ADC_CHANNEL_3;  // pa3 uart-l-rx
+  sConfig.Rank    = 2;
+  HAL_ADC_ConfigChannel(&hadc2, &sConfig);
+
+  hadc2.Instance->CR2 |= ADC_CR2_DMA | ADC_CR2_JEXTTRIG;  // the slave needs the trigger enabled with software start selected
+  #endif
+  MX_ADC_WatchdogInit(&hadc2, ADC_CHANNEL_10);
+  __HAL_ADC_ENABLE(&hadc2);
+  #else
   hadc2.Init.NbrOfConversion       = 5;
   HAL_ADC_Init(&hadc2);
 
@@ -689,5 +931,7 @@ void MX_ADC2_Init(void) {
   HAL_ADC_ConfigChannel(&hadc2, &sConfig);
 
   hadc2.Instance->CR2 |= ADC_CR2_DMA;
+  MX_ADC_WatchdogInit(&hadc2, ADC_CHANNEL_10);
   __HAL_ADC_ENABLE(&hadc2);
+  #endif
 }
@@ -37,6 +37,7 @@
 #include "defines.h"
 #include "config.h"
 #include "util.h"
+#include "sched.h"
 
 extern DMA_HandleTypeDef hdma_i2c2_rx;
 extern DMA_HandleTypeDef hdma_i2c2_tx;
@@ -156,6 +157,9 @@ void DebugMon_Handler(void) {
 */
 void PendSV_Handler(void) {
   /* USER CODE BEGIN PendSV_IRQn 0 */
+#ifdef BLDC_MULTIRATE
+  bldcSlowTask();
+#endif
 
   /* USER CODE END PendSV_IRQn 0 */
   /* USER CODE BEGIN PendSV_IRQn 1 */
@@ -358,7 +362,7 @@ void USART3_IRQHandler(void)
   /* USER CODE BEGIN USART2_IRQn 1 */
   if(RESET != __HAL_UART_GET_IT_SOURCE(&huart3, UART_IT_IDLE)) {  // Check for IDLE line interrupt  
       __HAL_UART_CLEAR_IDLEFLAG(&huart3);                         // Clear IDLE line flag (otherwise it will continue to enter interrupt)
-      usart3_rx_check();                                          // Check for data to process
+      Sched_Signal(SCHED_RX);                                     // Process the data in the main loop (taskRx)
   }
   /* USER CODE END USART2_IRQn 1 */
 }
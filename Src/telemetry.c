@@ -0,0 +1,231 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Binary telemetry stream on USART3. The PWM interrupt calls Telem_Sample() every
+ * period; every div periods the selected signals are written straight into one of
+ * two frame buffers. A full frame is closed with its CRC and handed to the USART3
+ * Tx DMA (Log_SubmitBlock) without copying, while the interrupt fills the other
+ * buffer. The signal set and the rate are changed at runtime with a TelemConfig
+ * frame on USART3 (see Telem_Command) or Telem_Config().
+ */
+
+// Includes
+#include <string.h>
+#include "stm32f1xx_hal.h"
+#include "defines.h"
+#include "config.h"
+#include "util.h"
+#include "logger.h"
+#include "telemetry.h"
+#include "BLDC_controller.h"
+#include "rtwtypes.h"
+
+/* =========================== Variable Definitions =========================== */
+
+extern ExtY    rtY_Left;
+extern ExtY    rtY_Right;
+extern int16_t dc_curr;
+extern int16_t batVoltage;
+extern volatile uint16_t ocTripCntL;
+extern volatile uint16_t ocTripCntR;
+extern volatile uint16_t ocTripPerL;
+extern volatile uint16_t ocTripPerR;
+
+const char *const telemSigName[TELEM_SIGNALS] = {
+  "iqL", "idL", "nL", "angL", "errL", "iqR", "idR", "nR", "angR", "errR", "dcCurr", "batV", "ocL", "ocR", "ocPerL", "ocPerR"
+};
+
+typedef struct {
+  const volatile void *addr;
+  uint8_t              isU8;            // 1 = uint8_t source, 0 = int16_t source
+} TelemSource;
+
+static const TelemSource telemSrc[TELEM_SIGNALS] = {
+  { &rtY_Left.iq,          0 }, { &rtY_Left.id,          0 }, { &rtY_Left.n_mot,  0 },
+  { &rtY_Left.a_elecAngle, 0 }, { &rtY_Left.z_errCode,   1 },
+  { &rtY_Right.iq,         0 }, { &rtY_Right.id,         0 }, { &rtY_Right.n_mot, 0 },
+  { &rtY_Right.a_elecAngle,0 }, { &rtY_Right.z_errCode,  1 },
+  { &dc_curr,              0 }, { &batVoltage,           0 },
+  { &ocTripCntL,           0 }, { &ocTripCntR,           0 },
+  { &ocTripPerL,           0 }, { &ocTripPerR,           0 }
+};
+
+enum { TELEM_FREE, TELEM_READY, TELEM_SENDING };
+
+static TelemFrame        telemBuf[2];                 // double buffer: one filled by the interrupt, one read by the DMA
+static volatile uint8_t  telemState[2];
+static uint8_t           telemFill;                   // buffer being filled
+static uint8_t           telemTx;                     // next buffer to send
+static uint8_t           telemPos;                    // samples in the buffer being filled
+static uint8_t           telemSeq;
+static uint16_t          telemTick;                   // [control periods]
+static uint16_t          telemCnt;                    // [control periods] until the next sample
+static uint16_t          telemCrc;                    // running CRC of the buffer being filled
+
+static uint16_t          telemMask;
+static uint16_t          telemDiv;                    // 0 = streaming off
+static uint8_t           telemNSig;
+static uint8_t           telemSamp;                   // samples per frame for the current selection
+static uint8_t           telemSel[TELEM_SIGNALS];     // selected signals in ascending order
+static volatile TelemStats telemStats;
+
+/* =========================== Telemetry Functions =========================== */
+
+void Telem_Init(void) {
+  memset((void *)&telemStats, 0, sizeof(telemStats));
+  Telem_Config(TELEM_MASK, TELEM_DIV);
+}
+
+/*
+ * Frame length on the wire for a given selection
+ */
+uint16_t Telem_FrameSize(uint16_t mask, uint8_t nSamp) {
+  uint8_t nSig = 0;
+  for (int i = 0; i < TELEM_SIGNALS; i++) {
+    nSig += (mask >> i) & 1U;
+  }
+  return TELEM_HDR_SIZE + 2 * (nSamp * nSig + 1);
+}
+
+/*
+ * Select the streamed signals and the sample period. A partly filled frame is
+ * discarded, frames already waiting for the DMA are sent as they are.
+ * Inputs:       mask = TELEM_SIG() bits, 0 = off
+ *               div  = [control periods] sample period, clamped to TELEM_DIV_MIN (1 kHz)
+ * Outputs:      1 = applied, 0 = rejected (unknown signal)
+ */
+int Telem_Config(uint16_t mask, uint16_t div) {
+  uint8_t sel[TELEM_SIGNALS], n = 0;
+
+  if (mask & ~TELEM_MASK_ALL) {
+    return 0;
+  }
+  for (int i = 0; i < TELEM_SIGNALS; i++) {
+    if (mask & TELEM_SIG(i)) {
+      sel[n++] = (uint8_t)i;
+    }
+  }
+
+  __disable_irq();
+  memcpy(telemSel, sel, n);
+  telemNSig = n;
+  telemMask = mask;
+  telemSamp = n ? (uint8_t)MIN(TELEM_FRAME_SAMPLES, TELEM_PAYLOAD_WORDS / n) : 0;
+  telemDiv  = n ? MAX(div, TELEM_DIV_MIN) : 0;
+  telemCnt  = telemDiv;
+  telemPos  = 0;
+  __enable_irq();
+
+  return 1;
+}
+
+/*
+ * Scan received USART3 data for TelemConfig frames
+ */
+void Telem_Command(const uint8_t *data, uint32_t len) {
+  TelemConfig cfg;
+
+  for (uint32_t i = 0; i + sizeof(cfg) <= len; i++) {
+    memcpy(&cfg, &data[i], sizeof(cfg));
+    if (cfg.start != TELEM_CFG_FRAME) {
+      continue;
+    }
+    if (cfg.crc == calcCRC16(0xFFFF, (const uint8_t *)&cfg, sizeof(cfg) - 2) && Telem_Config(cfg.mask, cfg.div)) {
+      i += sizeof(cfg) - 1;
+    } else {
+      telemStats.cfgErrors++;
+    }
+  }
+}
+
+static void Telem_TxDone(void);
+
+/*
+ * Hand the oldest complete frame to the DMA. Interrupt context only.
+ */
+static void Telem_Send(void) {
+  TelemFrame *f = &telemBuf[telemTx];
+
+  if (telemState[telemTx] != TELEM_READY) {
+    return;
+  }
+  telemState[telemTx] = TELEM_SENDING;                  // before the submit: a synchronous completion frees it again
+  if (Log_SubmitBlock((const uint8_t *)f, Telem_FrameSize(f->mask, f->nSamp), Telem_TxDone)) {
+    telemStats.frames++;
+  } else {
+    telemState[telemTx] = TELEM_READY;                  // another block in the way, retry from its completion
+  }
+}
+
+static void Telem_TxDone(void) {
+  telemState[telemTx] = TELEM_FREE;
+  telemTx ^= 1;
+  Telem_Send();
+}
+
+/*
+ * Called once per control period from the PWM interrupt.
+ * Cost: a counter decrement, plus ~15 cycles per signal and CRC byte pair on a sample.
+ */
+void Telem_Sample(void) {
+  TelemFrame *f;
+  int16_t    *p;
+
+  telemTick++;
+  if (telemDiv == 0 || --telemCnt) {
+    return;
+  }
+  telemCnt = telemDiv;
+
+  f = &telemBuf[telemFill];
+  if (telemState[telemFill] != TELEM_FREE) {            // both buffers on their way out: the link is slower than the stream
+    telemStats.dropSamples++;
+    return;
+  }
+
+  if (telemPos == 0) {                                  // open a new frame
+    f->start = TELEM_START_FRAME;
+    f->mask  = telemMask;
+    f->tick  = telemTick;
+    f->div   = telemDiv;
+    f->seq   = telemSeq++;
+    f->nSamp = telemSamp;
+    telemCrc = calcCRC16(0xFFFF, (const uint8_t *)f, TELEM_HDR_SIZE);
+  }
+
+  p = &f->data[telemPos * telemNSig];
+  for (uint8_t i = 0; i < telemNSig; i++) {
+    const TelemSource *s = &telemSrc[telemSel[i]];
+    p[i] = s->isU8 ? *(const volatile uint8_t *)s->addr : *(const volatile int16_t *)s->addr;
+  }
+  telemCrc = calcCRC16(telemCrc, (const uint8_t *)p, 2U * telemNSig);
+
+  if (++telemPos == telemSamp) {                        // frame complete: append the CRC and send it
+    f->data[telemSamp * telemNSig] = (int16_t)telemCrc;
+    telemState[telemFill] = TELEM_READY;
+    telemFill ^= 1;
+    telemPos   = 0;
+    Telem_Send();
+  }
+}
+
+void Telem_GetStats(TelemStats *out) {
+  __disable_irq();
+  *out = *(TelemStats *)&telemStats;
+  __enable_irq();
+}
@@ -27,7 +27,12 @@
 #include "config.h"
 #include "eeprom.h"
 #include "util.h"
+#include "logger.h"
+#include "telemetry.h"
+#include "regmap.h"
+#include "ramfunc.h"
 #include "BLDC_controller.h"
+#include "BLDC_controller_mr.h"
 #include "rtwtypes.h"
 
 /* =========================== Variable Definitions =========================== */
@@ -82,6 +87,11 @@ P        rtP_Right;                     /* Block parameters (auto storage) */
 DW       rtDW_Right;                    /* Observable states */
 ExtU     rtU_Right;                     /* External inputs */
 ExtY     rtY_Right;                     /* External outputs */
+
+#ifdef BLDC_MULTIRATE
+SlowPart slowLeft;                      /* Slow partition, run in PendSV_Handler */
+SlowPart slowRight;
+#endif
 //---------------
 
 uint8_t  inIdx      = 0;
@@ -99,11 +109,13 @@ int16_t  speedAvgAbs;                   // average measured speed in absolute
 uint8_t  timeoutFlgADC    = 0;          // Timeout Flag for ADC Protection:    0 = OK, 1 = Problem detected (line disconnected or wrong ADC data)
 uint8_t  timeoutFlgSerial = 0;          // Timeout Flag for Rx Serial command: 0 = OK, 1 = Problem detected (line disconnected or wrong Rx data)
 
+SerialRxStats rxStatsL;                 // USART2 command parser statistics
+SerialCmdState cmdStateL = { 1 };      // USART2 last accepted command
+
 uint8_t  ctrlModReqRaw = CTRL_MOD_REQ;
 uint8_t  ctrlModReq    = CTRL_MOD_REQ;  // Final control mode request 
 
-uint16_t VirtAddVarTab[NB_OF_VAR] = {1000, 1001, 1002, 1003, 1004, 1005, 1006, 1007, 1008, 1009,
-                                     1010, 1011, 1012, 1013, 1014, 1015, 1016, 1017, 1018};
+uint16_t VirtAddVarTab[NB_OF_VAR] = VIRT_ADDR_TAB;   // see eeprom.h
 
 //------------------------------------------------------------------------
 // Local variables
@@ -114,6 +126,8 @@ static int16_t INPUT_MIN;             // [-] Input target minimum limitation
 
 static uint8_t  cur_spd_valid  = 0;
 static uint8_t  inp_cal_valid  = 0;
+static adc_offset_t offsetSaved;      // ADC current offsets in EEPROM, all 0 if none
+static uint8_t offsetRead(adc_offset_t *off);
 
 static uint8_t  rx_buffer_L[SERIAL_BUFFER_SIZE];      // USART Rx DMA circular buffer
 static uint32_t rx_buffer_L_len = ARRAY_LEN(rx_buffer_L);
@@ -124,8 +138,13 @@ static uint8_t  rx_buffer_R[SERIAL_BUFFER_SIZE];      // USART Rx DMA circular b
 static uint32_t rx_buffer_R_len = ARRAY_LEN(rx_buffer_R);
 
 static SerialCommand commandL;
-static SerialCommand commandL_raw;
-static uint32_t commandL_len = sizeof(commandL);
+static union {
+  SerialCommand   v1;
+  SerialCommandV2 v2;
+} commandL_raw;                                       // frame being received, legacy or protocol v2
+static uint32_t commandL_len = sizeof(commandL);      // length of the frame being received, known after the start frame
+static uint32_t commandL_idx = 0;                     // bytes of commandL_raw received so far
+static uint8_t  commandL_hunt = 0;                    // 1 = discarding bytes until the next start frame
 
 #if defined(STANDSTILL_HOLD_ENABLE) && (CTRL_TYP_SEL == FOC_CTRL) && (CTRL_MOD_REQ != SPD_MODE)
 static uint8_t cruiseCtrlAcv = 0;
@@ -140,15 +159,14 @@ static uint8_t standstillAcv = 0;
   #define PUTCHAR_PROTOTYPE int fputc(int ch, FILE *f)
 #endif
 PUTCHAR_PROTOTYPE {
-  HAL_UART_Transmit(&huart3, (uint8_t *)&ch, 1, 1000);
+  char c = (char)ch;
+  Log_Write(&c, 1);                     // queued, sent by the USART3 Tx DMA (see logger.c)
   return ch;
 }
 
 #ifdef __GNUC__
   int _write(int file, char *data, int len) {
-    int i;
-    for (i = 0; i < len; i++) { __io_putchar( *data++ );}
-    return len;
+    return Log_Write(data, len);        // whole chunk at once, returns without waiting for the UART
   }
 #endif
 
@@ -172,6 +190,8 @@ void BLDC_Init(void) {
   rtP_Right                     = rtP_Left;     // Copy the Left motor parameters to the Right motor parameters
   rtP_Right.z_selPhaCurMeasABC  = 1;            // Right motor measured current phases {Blue, Yellow} = {iB, iC} -> do NOT change
 
+  BLDC_RateScale(CTRL_FREQ);                    // before the initialization: the hall counter states start at z_maxCntRst
+
   /* Pack LEFT motor data into RTM */
   rtM_Left->defaultParam        = &rtP_Left;
   rtM_Left->dwork               = &rtDW_Left;
@@ -187,6 +207,71 @@ void BLDC_Init(void) {
   /* Initialize BLDC controllers */
   BLDC_controller_initialize(rtM_Left);
   BLDC_controller_initialize(rtM_Right);
+
+  #ifdef BLDC_MULTIRATE
+  BLDC_SlowScale(BLDC_SLOW_DIV);
+  BLDC_controller_slow_init(rtM_Left,  &slowLeft,  BLDC_SLOW_DIV);
+  BLDC_controller_slow_init(rtM_Right, &slowRight, BLDC_SLOW_DIV);
+  #endif
+}
+
+/*
+ * Rescale the time constants of the slow controller tasks (BLDC_controller_step_slow) for a run
+ * every div-th Task_Scheduler period instead of every one: the error qualification times, the
+ * OPEN mode voltage rate, the speed PI integral gain and the integrator / back-calculation gains
+ * of the motor limitations.
+ */
+void BLDC_SlowScale(uint8_t div) {
+  P *p[2] = { &rtP_Left, &rtP_Right };
+  if (div <= 1) {
+    return;
+  }
+  for (int k = 0; k < 2; k++) {
+    p[k]->t_errQual       = MAX(p[k]->t_errQual   / div, 1);
+    p[k]->t_errDequal     = MAX(p[k]->t_errDequal / div, 1);
+    p[k]->dV_openRate     = p[k]->dV_openRate * div;
+    p[k]->cf_nKi          = (uint16_t)MIN((uint32_t)p[k]->cf_nKi         * div, UINT16_MAX);
+    p[k]->cf_iqKiLimProt  = (uint16_t)MIN((uint32_t)p[k]->cf_iqKiLimProt * div, UINT16_MAX);
+    p[k]->cf_nKiLimProt   = (uint16_t)MIN((uint32_t)p[k]->cf_nKiLimProt  * div, UINT16_MAX);
+    p[k]->cf_KbLimProt    = (uint16_t)MIN((uint32_t)p[k]->cf_KbLimProt   * div, UINT16_MAX);
+  }
+}
+
+#if CTRL_FREQ < 8000 || CTRL_FREQ > 24000
+  #error CTRL_FREQ must be within 8000 .. 24000 Hz, see BLDC_RateScale()
+#endif
+
+/*
+ * Rescale the rate dependent controller parameters from the rate they are at (BLDC_GEN_FREQ after reset) to a
+ * controller step every 1/freq s. Times and hall counter limits counted in steps scale with the rate: the error
+ * qualification times, the hall counter reset and transition thresholds and the speed coefficient (speed =
+ * coefficient / counter). Per-step quantities scale inversely: the OPEN mode voltage rate, the current filter
+ * coefficient (first order approximation) and the integrator / back-calculation gains. Calls at the current rate
+ * change nothing, so a repeated BLDC_Init() does not scale twice.
+ */
+void BLDC_RateScale(uint16_t freq) {
+  static uint16_t rate = BLDC_GEN_FREQ;
+  P *p[2] = { &rtP_Left, &rtP_Right };
+  if (freq == rate) {
+    return;
+  }
+  for (int k = 0; k < 2; k++) {
+    p[k]->t_errQual       = (uint16_t)MIN((uint32_t)p[k]->t_errQual   * freq / rate, UINT16_MAX);
+    p[k]->t_errDequal     = (uint16_t)MIN((uint32_t)p[k]->t_errDequal * freq / rate, UINT16_MAX);
+    p[k]->z_maxCntRst     = (int16_t)MIN((int32_t)p[k]->z_maxCntRst     * freq / rate, INT16_MAX);
+    p[k]->dz_cntTrnsDetHi = (int16_t)MIN((int32_t)p[k]->dz_cntTrnsDetHi * freq / rate, INT16_MAX);
+    p[k]->dz_cntTrnsDetLo = (int16_t)MIN((int32_t)p[k]->dz_cntTrnsDetLo * freq / rate, INT16_MAX);
+    p[k]->cf_speedCoef    = (uint16_t)MIN((uint32_t)p[k]->cf_speedCoef * freq / rate, UINT16_MAX >> 2);  // shifted left by 2 in the estimator
+    p[k]->dV_openRate     = (int32_t)((int64_t)p[k]->dV_openRate * rate / freq);
+    p[k]->cf_currFilt     = (uint16_t)MIN((uint32_t)p[k]->cf_currFilt    * rate / freq, UINT16_MAX);
+    p[k]->cf_iqKi         = (uint16_t)MIN((uint32_t)p[k]->cf_iqKi        * rate / freq, UINT16_MAX);
+    p[k]->cf_idKi         = (uint16_t)MIN((uint32_t)p[k]->cf_idKi        * rate / freq, UINT16_MAX);
+    p[k]->cf_nKi          = (uint16_t)MIN((uint32_t)p[k]->cf_nKi         * rate / freq, UINT16_MAX);
+    p[k]->cf_iqKiLimProt  = (uint16_t)MIN((uint32_t)p[k]->cf_iqKiLimProt * rate / freq, UINT16_MAX);
+    p[k]->cf_nKiLimProt   = (uint16_t)MIN((uint32_t)p[k]->cf_nKiLimProt  * rate / freq, UINT16_MAX);
+    p[k]->cf_KbLimProt    = (uint16_t)MIN((uint32_t)p[k]->cf_KbLimProt   * rate / freq, UINT16_MAX);
+  }
+  rate = freq;
 }
 
 void Input_Lim_Init(void) {     // Input Limitations - ! Do NOT touch !
@@ -218,6 +303,9 @@ void Input_Init(void) {
   uint16_t writeCheck, readVal;
   HAL_FLASH_Unlock();
   EE_Init();            /* EEPROM Init */
+  if (offsetRead(&offsetSaved)) {
+    bldcOffsetLoad(&offsetSaved);       // checked by the PWM interrupt at boot with FAST_BOOT_ENABLE
+  }
   EE_ReadVariable(VirtAddVarTab[0], &writeCheck);
   if (writeCheck == FLASH_WRITE_KEY) {
     printf("Using the configuration from EEprom\r\n");
@@ -257,6 +345,9 @@ void Input_Init(void) {
         input2[i].typ, input2[i].min, input2[i].mid, input2[i].max);
     }
   }
+  #ifdef REGMAP_ENABLE
+  Reg_Load();           // parameters saved over the register map
+  #endif
   HAL_FLASH_Lock();
 }
 
@@ -274,13 +365,21 @@ void UART_DisableRxErrors(UART_HandleTypeDef *huart)
 
 /* =========================== General Functions =========================== */
 
+/*
+ * Beeps and melodies are queued and played by the buzzer timer interrupt (bldc.c), none of the beep functions
+ * waits for the sound. A queued note plays before and instead of the beepCount() pattern.
+ * Single producer (main loop) and single consumer (buzzer timer interrupt): beepHead is written here only,
+ * beepTail in beepTick() only.
+ */
+static BeepNote          beepQ[BEEP_QUEUE_LEN];
+static volatile uint8_t  beepHead;      // next free entry
+static volatile uint8_t  beepTail;      // note playing, or the next one to play
+static uint8_t           beepStarted;   // the note at beepTail has started to play
+
 void poweronMelody(void) {
-    buzzerCount = 0;  // prevent interraction with beep counter
-    for (int i = 8; i >= 0; i--) {
-      buzzerFreq = (uint8_t)i;
-      HAL_Delay(100);
+    for (int i = 8; i >= 1; i--) {
+      beepQueue((uint8_t)i, 100);
     }
-    buzzerFreq = 0;
 }
 
 void beepCount(uint8_t cnt, uint8_t freq, uint8_t pattern) {
@@ -289,18 +388,78 @@ void beepCount(uint8_t cnt, uint8_t freq, uint8_t pattern) {
     buzzerPattern = pattern;
 }
 
+/*
+ * Queue a tone of freq (buzzerFreq scale, 0 = silence) for ms milliseconds.
+ * Returns 0 if the queue is full and the note was dropped. beepShort(), beepLong() and beepShortMany() only signal
+ * a state and accept the drop; poweroff() empties the queue first so that its melody is complete
+ */
+uint8_t beepQueue(uint8_t freq, uint16_t ms) {
+    uint8_t  head = beepHead;
+    uint32_t dur  = (uint32_t)ms * BUZZER_TIM_FREQ / 1000;
+
+    if ((uint8_t)(head - beepTail) >= BEEP_QUEUE_LEN) {
+      return 0;
+    }
+    beepQ[head & (BEEP_QUEUE_LEN - 1)].freq = freq;
+    beepQ[head & (BEEP_QUEUE_LEN - 1)].dur  = (uint16_t)MIN(MAX(dur, 1U), 0xFFFFU);
+    __atomic_store_n(&beepHead, (uint8_t)(head + 1), __ATOMIC_RELEASE);   // the note is complete before it is visible
+    return 1;
+}
+
+/*
+ * 1 while queued notes are playing or waiting
+ */
+uint8_t beepBusy(void) {
+    return beepHead != beepTail;
+}
+
+/*
+ * Wait until the queued notes have played, for the few places that have to, e.g. before the power is cut.
+ * Bounded by the queued duration plus BEEP_WAIT_MARGIN, in case the buzzer timer does not run
+ */
+void beepWait(void) {
+    uint8_t  head  = beepHead;
+    uint32_t dur   = 0;                 // [buzzer periods] left in the queue, only decreases while waiting
+    uint32_t start = HAL_GetTick();
+
+    for (uint8_t i = beepTail; i != head; i++) {
+      dur += beepQ[i & (BEEP_QUEUE_LEN - 1)].dur + BUZZER_TIM_IDLE;   // a note starts on the next timer update
+    }
+    uint32_t limit = dur * 1000 / BUZZER_TIM_FREQ + BEEP_WAIT_MARGIN;
+    while (beepBusy() && HAL_GetTick() - start < limit) { }
+}
+
+/*
+ * Advance the queue by elapsed buzzer periods (1 / BUZZER_TIM_FREQ). Called from the buzzer timer interrupt on each update.
+ * Returns 1 while a note plays, its tone in *freq (0 = silence)
+ */
+uint8_t beepTick(uint16_t elapsed, uint8_t *freq) {
+    uint8_t tail = beepTail;
+
+    if (tail == __atomic_load_n(&beepHead, __ATOMIC_ACQUIRE)) {
+      return 0;
+    }
+    if (!beepStarted) {                 // the time before the note was queued does not count
+      beepStarted = 1;
+    } else if (beepQ[tail & (BEEP_QUEUE_LEN - 1)].dur > elapsed) {
+      beepQ[tail & (BEEP_QUEUE_LEN - 1)].dur -= elapsed;
+    } else {                            // note done, the next one starts now
+      beepTail = ++tail;
+      if (tail == __atomic_load_n(&beepHead, __ATOMIC_ACQUIRE)) {
+        beepStarted = 0;
+        return 0;
+      }
+    }
+    *freq = beepQ[tail & (BEEP_QUEUE_LEN - 1)].freq;
+    return 1;
+}
+
 void beepLong(uint8_t freq) {
-    buzzerCount = 0;  // prevent interraction with beep counter
-    buzzerFreq = freq;
-    HAL_Delay(500);
-    buzzerFreq = 0;
+    beepQueue(freq, 500);
 }
 
 void beepShort(uint8_t freq) {
-    buzzerCount = 0;  // prevent interraction with beep counter
-    buzzerFreq = freq;
-    HAL_Delay(100);
-    buzzerFreq = 0;
+    beepQueue(freq, 100);
 }
 
 void beepShortMany(uint8_t cnt, int8_t dir) {
@@ -315,21 +474,21 @@ void beepShortMany(uint8_t cnt, int8_t dir) {
     }
 }
 
-void calcAvgSpeed(void) {
+void calcAvgSpeed(const ExchState *st) {
     // Calculate measured average speed. The minus sign (-) is because motors spin in opposite directions
     speedAvg = 0;
     #if defined(MOTOR_LEFT_ENA)
       #if defined(INVERT_L_DIRECTION)
-        speedAvg -= rtY_Left.n_mot;
+        speedAvg -= st->n_motL;
       #else
-        speedAvg += rtY_Left.n_mot;
+        speedAvg += st->n_motL;
       #endif
     #endif
     #if defined(MOTOR_RIGHT_ENA)
       #if defined(INVERT_R_DIRECTION)
-        speedAvg += rtY_Right.n_mot;
+        speedAvg += st->n_motR;
       #else
-        speedAvg -= rtY_Right.n_mot;
+        speedAvg -= st->n_motR;
       #endif
 
       // Average only if both motors are enabled
@@ -357,7 +516,9 @@ void calcAvgSpeed(void) {
  */
 void adcCalibLim(void) {
 #ifdef AUTO_CALIBRATION_ENA
-  calcAvgSpeed();
+  ExchState st;
+  Exch_Read(&exchState, &st);
+  calcAvgSpeed(&st);
   if (speedAvgAbs > 5) {    // do not enter this mode if motors are spinning
     return;
   }
@@ -440,7 +601,9 @@ if (input1TypTemp != 0 || input2TypTemp != 0){
  * - press the power button to confirm or wait for the 10 sec timeout
  */
 void updateCurSpdLim(void) {
-  calcAvgSpeed();
+  ExchState st;
+  Exch_Read(&exchState, &st);
+  calcAvgSpeed(&st);
   if (speedAvgAbs > 5) {    // do not enter this mode if motors are spinning
     return;
   }
@@ -479,7 +642,7 @@ if (input2[inIdx].typ != 0){
 
 // cur_spd_valid: 0 = No limit changed, 1 = Current limit changed, 2 = Speed limit changed, 3 = Both limits changed
 printf("Limits (%i)\r\nCurrent: fixdt:%li factor%i i_max:%i \r\nSpeed: fixdt:%li factor:%i n_max:%i\r\n",
-        cur_spd_valid, input1_fixdt, cur_factor, rtP_Left.i_max, input2_fixdt, spd_factor, rtP_Left.n_max);
+        cur_spd_valid, (long)input1_fixdt, cur_factor, rtP_Left.i_max, (long)input2_fixdt, spd_factor, rtP_Left.n_max);
 
 }
 
@@ -659,9 +822,91 @@ void readCommand(void) {
 }
 
 
+/*
+ * Frame length for a start frame, 0 = no start frame
+ */
+static uint32_t usart_frame_len(uint8_t lo, uint8_t hi)
+{
+  uint16_t start = (uint16_t)(lo | (hi << 8));
+  if (start == SERIAL_START_FRAME) {
+    return sizeof(SerialCommand);
+  }
+  if (start == SERIAL_START_FRAME_V2) {
+    return sizeof(SerialCommandV2);
+  }
+  return 0;
+}
+
+/*
+ * Streaming parser for SerialCommand and SerialCommandV2 frames on USART2. Bytes are
+ * collected from the start frame on, independent of how the line splits or coalesces
+ * the frames; a frame is processed as soon as its last byte arrives. Bytes outside a
+ * frame and frames with a wrong checksum are counted, after a checksum error the search
+ * for the next start frame continues inside the rejected bytes.
+ * Both start frames share the low byte, the high byte selects the frame length.
+ */
+static void usart2_parse(const uint8_t *data, uint32_t len)
+{
+  uint8_t *raw = (uint8_t *)&commandL_raw;
+  uint32_t k;
+  uint8_t  valid;
+
+  while (len--) {
+    uint8_t b = *data++;
+
+    if ((commandL_idx == 0 && b != (uint8_t)SERIAL_START_FRAME) ||
+        (commandL_idx == 1 && usart_frame_len(raw[0], b) == 0)) {         // not (or no longer) a start frame
+      if (!commandL_hunt) {
+        rxStatsL.frameErr++;                                              // count each loss of synchronisation once
+        commandL_hunt = 1;
+      }
+      rxStatsL.skipped += commandL_idx + 1 - (b == (uint8_t)SERIAL_START_FRAME);
+      commandL_idx = 0;
+      if (b == (uint8_t)SERIAL_START_FRAME) {                             // can be the first byte of the next start frame
+        raw[commandL_idx++] = b;
+      }
+      continue;
+    }
+
+    raw[commandL_idx++] = b;
+    if (commandL_idx == 2) {
+      commandL_len = usart_frame_len(raw[0], raw[1]);
+    }
+    if (commandL_idx < 2 || commandL_idx < commandL_len) {
+      continue;
+    }
+
+    commandL_idx  = 0;                                                    // complete frame
+    commandL_hunt = 0;
+    if (commandL_len == sizeof(SerialCommandV2)) {
+      valid = usart_process_command_v2(&commandL_raw.v2, &commandL, 2);
+    } else {
+      valid = usart_process_command(&commandL_raw.v1, &commandL, 2);
+    }
+    if (valid) {
+      rxStatsL.frames++;
+    } else {
+      rxStatsL.crcErr++;
+      for (k = 1; k < commandL_len; k++) {                                // resync on a start frame inside the rejected bytes
+        if (raw[k] == (uint8_t)SERIAL_START_FRAME &&
+            (k + 1 == commandL_len || usart_frame_len(raw[k], raw[k + 1]) != 0)) {
+          break;
+        }
+      }
+      rxStatsL.skipped += k;
+      commandL_idx = commandL_len - k;
+      memmove(raw, &raw[k], commandL_idx);
+      if (commandL_idx >= 2) {
+        commandL_len = usart_frame_len(raw[0], raw[1]);
+      }
+    }
+  }
+}
+
 /*
  * Check for new data received on USART2 with DMA: refactored function from https://github.com/MaJerle/stm32-usart-uart-dma-rx-tx
- * - this function is called for every USART IDLE line detection, in the USART interrupt handler
+ * - this function is called for every USART IDLE line detection, in the USART interrupt handler, and for the
+ *   half/full transfer events of the circular DMA, so that no data is overwritten during a continuous stream
  */
 void usart2_rx_check(void)
 {
@@ -669,19 +914,14 @@ void usart2_rx_check(void)
   uint32_t pos;
   pos = rx_buffer_L_len - __HAL_DMA_GET_COUNTER(huart2.hdmarx);         // Calculate current position in buffer
 
-  uint8_t *ptr;	
   if (pos != old_pos) {                                                 // Check change in received data
-    ptr = (uint8_t *)&commandL_raw;                                     // Initialize the pointer with command_raw address
-    if (pos > old_pos && (pos - old_pos) == commandL_len) {             // "Linear" buffer mode: check if current position is over previous one AND data length equals expected length
-      memcpy(ptr, &rx_buffer_L[old_pos], commandL_len);                 // Copy data. This is possible only if command_raw is contiguous! (meaning all the structure members have the same size)
-      usart_process_command(&commandL_raw, &commandL, 2);               // Process data
-    } else if ((rx_buffer_L_len - old_pos + pos) == commandL_len) {     // "Overflow" buffer mode: check if data length equals expected length
-      memcpy(ptr, &rx_buffer_L[old_pos], rx_buffer_L_len - old_pos);    // First copy data from the end of buffer
+    if (pos > old_pos) {                                                // "Linear" buffer mode: check if current position is over previous one
+      usart2_parse(&rx_buffer_L[old_pos], pos - old_pos);               // Process data
+    } else {                                                            // "Overflow" buffer mode
+      usart2_parse(&rx_buffer_L[old_pos], rx_buffer_L_len - old_pos);   // First process data from the end of buffer
       if (pos > 0) {                                                    // Check and continue with beginning of buffer
-        ptr += rx_buffer_L_len - old_pos;                               // Move to correct position in command_raw
-        memcpy(ptr, &rx_buffer_L[0], pos);                              // Copy remaining data
+        usart2_parse(&rx_buffer_L[0], pos);                             // Process remaining data
       }
-      usart_process_command(&commandL_raw, &commandL, 2);               // Process data
     }
   }
 
@@ -691,10 +931,28 @@ void usart2_rx_check(void)
   }
 }
 
+/*
+ * DMA half/full transfer callbacks of the circular Rx buffers
+ */
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart)
+{
+  if (huart->Instance == USART2) {
+    usart2_rx_check();
+  }
+}
+
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+{
+  if (huart->Instance == USART2) {
+    usart2_rx_check();
+  }
+}
+
 
 /*
  * Check for new data received on USART3 with DMA: refactored function from https://github.com/MaJerle/stm32-usart-uart-dma-rx-tx
- * - this function is called for every USART IDLE line detection, in the USART interrupt handler
+ * - this function is called from the main loop task released by the USART IDLE line detection (SCHED_RX), so the
+ *   debug commands and their printf run outside of interrupts. The circular buffer holds SERIAL_BUFFER_SIZE bytes
  */
 void usart3_rx_check(void)
 {
@@ -730,13 +988,20 @@ void usart_process_debug(uint8_t *userCommand, uint32_t len)
   #ifdef DEBUG_SERIAL_PROTOCOL
     handle_input(userCommand, len);
   #endif
+  #ifdef TELEMETRY_ENABLE
+    Telem_Command(userCommand, len);
+  #endif
+  #ifdef REGMAP_ENABLE
+    Reg_Command(userCommand, len);
+  #endif
 }
 
 /*
  * Process command Rx data
  * - if the command_in data is valid (correct START_FRAME and checksum) copy the command_in to command_out
+ * - returns 1 if the command was accepted
  */
-void usart_process_command(SerialCommand *command_in, SerialCommand *command_out, uint8_t usart_idx)
+uint8_t usart_process_command(SerialCommand *command_in, SerialCommand *command_out, uint8_t usart_idx)
 {
   uint16_t checksum;
   if (command_in->start == SERIAL_START_FRAME) {
@@ -746,21 +1011,141 @@ void usart_process_command(SerialCommand *command_in, SerialCommand *command_out
       if (usart_idx == 2) {             // Sideboard USART2
         timeoutFlgSerial_L = 0;         // Clear timeout flag
         timeoutCntSerial_L = 0;         // Reset timeout counter
+        if (cmdStateL.ver != 1) {       // back from protocol v2: configured mode and mixing
+          ctrlModReqRaw       = CTRL_MOD_REQ;
+          cmdStateL.motorMode = 0;
+          cmdStateL.ver       = 1;
+        }
       }
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Process protocol v2 command Rx data
+ * - if the command_in data is valid (START_FRAME_V2, version, CRC16, mode and flags) copy the targets to command_out,
+ *   apply the control mode request and record the sequence number and time stamp for the feedback
+ * - returns 1 if the command was accepted
+ */
+uint8_t usart_process_command_v2(SerialCommandV2 *command_in, SerialCommand *command_out, uint8_t usart_idx)
+{
+  if (command_in->start   != SERIAL_START_FRAME_V2 ||
+      command_in->version != SERIAL_PROTOCOL_V2 ||
+      command_in->crc     != calcCRC16(0xFFFF, (const uint8_t *)command_in, sizeof(*command_in) - 2) ||
+      command_in->ctrlMod  > TRQ_MODE ||
+      (command_in->flags & ~(SERIAL_V2_MOTOR | SERIAL_V2_FAST))) {
+    return 0;
+  }
+
+  command_out->start    = SERIAL_START_FRAME;
+  command_out->steer    = command_in->cmd1;
+  command_out->speed    = command_in->cmd2;
+  command_out->checksum = (uint16_t)(command_out->start ^ command_out->steer ^ command_out->speed);
+  ctrlModReqRaw         = command_in->ctrlMod;
+
+  if (usart_idx == 2) {                 // Sideboard USART2
+    timeoutFlgSerial_L = 0;             // Clear timeout flag
+    timeoutCntSerial_L = 0;             // Reset timeout counter
+    int16_t seqStep = (int16_t)(command_in->seq - cmdStateL.seq);
+    if (cmdStateL.ver == 2 && seqStep > 1) {                              // repeated or reordered frames are no loss
+      cmdStateL.seqGaps += (uint16_t)(seqStep - 1);
     }
+    cmdStateL.ver       = 2;
+    cmdStateL.motorMode = (command_in->flags & (SERIAL_V2_MOTOR | SERIAL_V2_FAST)) != 0;
+    cmdStateL.seq       = command_in->seq;
+    cmdStateL.stamp     = command_in->stamp;
+    cmdStateL.rxTick    = HAL_GetTick();
+    #ifdef FAST_CMD_ENABLE
+    if ((command_in->flags & SERIAL_V2_FAST) && inIdx == 0) {           // skip the main loop, the PWM interrupt rate limits the targets
+      int16_t cmdL = CLAMP(command_in->cmd1, INPUT_MIN, INPUT_MAX);
+      int16_t cmdR = CLAMP(command_in->cmd2, INPUT_MIN, INPUT_MAX);
+      #ifdef INVERT_L_DIRECTION
+        cmdL = -cmdL;
+      #endif
+      #ifndef INVERT_R_DIRECTION
+        cmdR = -cmdR;
+      #endif
+      fastCmdSet(cmdL, cmdR);
+    }
+    #endif
   }
+  return 1;
 }
 
 /* =========================== Poweroff Functions =========================== */
 
+/*
+ * ADC current offsets in EEPROM: VirtAddVarTab[20..25], VirtAddVarTab[19] = FLASH_OFFSET_KEY ^ sum of the offsets.
+ * Returns 1 if a complete and consistent set was read, otherwise *off is all 0
+ */
+static uint8_t offsetRead(adc_offset_t *off) {
+  int16_t  *val = (int16_t *)off;       // six int16_t in a row
+  uint16_t  check, readVal, sum = 0;
+  uint8_t   ok  = (EE_ReadVariable(VirtAddVarTab[19], &check) == 0);
+
+  for (uint8_t k = 0; k < 6; k++) {
+    ok &= (EE_ReadVariable(VirtAddVarTab[20 + k], &readVal) == 0);
+    val[k] = (int16_t)readVal;
+    sum   += readVal;
+  }
+  if (!ok || check != (uint16_t)(FLASH_OFFSET_KEY ^ sum)) {
+    memset(off, 0, sizeof(*off));
+    return 0;
+  }
+  return 1;
+}
+
+static void offsetWrite(const adc_offset_t *off) {
+  const int16_t *val = (const int16_t *)off;
+  uint16_t       sum = 0;
+
+  for (uint8_t k = 0; k < 6; k++) {
+    EE_WriteVariable(VirtAddVarTab[20 + k], (uint16_t)val[k]);
+    sum += (uint16_t)val[k];
+  }
+  EE_WriteVariable(VirtAddVarTab[19], (uint16_t)(FLASH_OFFSET_KEY ^ sum));
+}
+
+/*
+ * 1 if the offsets in use moved by more than ADC_OFFSET_SAVE from the ones in EEPROM
+ */
+static uint8_t offsetChanged(adc_offset_t *off) {
+  const int16_t *now = (const int16_t *)off;
+  const int16_t *old = (const int16_t *)&offsetSaved;
+
+  if (bldcOffsetGet(off) == OFFSET_NONE) {
+    return 0;
+  }
+  for (uint8_t k = 0; k < 6; k++) {
+    if (ABS(now[k] - old[k]) > ADC_OFFSET_SAVE) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
  /*
  * Save Configuration to Flash
  * This function makes sure data is not lost after power-off
  */
 void saveConfig() {
-  if (inp_cal_valid || cur_spd_valid) {
+  adc_offset_t off;
+  uint8_t saveOffsets = offsetChanged(&off);
+  uint8_t saveInputs  = inp_cal_valid || cur_spd_valid;
+
+  if (!saveOffsets && !saveInputs) {
+    return;
+  }
+  HAL_FLASH_Unlock();
+  EE_WriteBegin();                      // one batch: stored completely or not at all, unchanged values are not written
+  if (saveOffsets) {
+    printf("Saving ADC offsets to EEprom\r\n");
+    offsetWrite(&off);
+  }
+  if (saveInputs) {
     printf("Saving configuration to EEprom\r\n");
-    HAL_FLASH_Unlock();
     EE_WriteVariable(VirtAddVarTab[0] , (uint16_t)FLASH_WRITE_KEY);
     EE_WriteVariable(VirtAddVarTab[1] , (uint16_t)rtP_Left.i_max);
     EE_WriteVariable(VirtAddVarTab[2] , (uint16_t)rtP_Left.n_max);
@@ -774,20 +1159,22 @@ void saveConfig() {
       EE_WriteVariable(VirtAddVarTab[ 9+8*i] , (uint16_t)input2[i].mid);
       EE_WriteVariable(VirtAddVarTab[10+8*i] , (uint16_t)input2[i].max);
     }
-    HAL_FLASH_Lock();
   }
+  EE_WriteCommit();
+  HAL_FLASH_Lock();
 }
 
 
 void poweroff(void) {
   enable = 0;
   printf("-- Motors disabled --\r\n");
-  buzzerCount = 0;  // prevent interraction with beep counter
-  buzzerPattern = 0;
-  for (int i = 0; i < 8; i++) {
-    buzzerFreq = (uint8_t)i;
-    HAL_Delay(100);
+  beepCount(0, 0, 0);
+  beepWait();                           // pending beeps first, the 8 notes below then fit the queue
+  beepQueue(0, 100);
+  for (int i = 1; i < 8; i++) {
+    beepQueue((uint8_t)i, 100);
   }
+  beepWait();                           // the melody ends before the power is cut
   saveConfig();
   HAL_GPIO_WritePin(OFF_PORT, OFF_PIN, GPIO_PIN_RESET);
   while(1) {}
@@ -843,7 +1230,7 @@ void poweroffPressCheck(void) {
   * filtLowPass16(u, 52429, &y);
   * yint = (int16_t)(y >> 16); // the integer output is the fixed-point ouput shifted by 16 bits
   */
-void filtLowPass32(int32_t u, uint16_t coef, int32_t *y) {
+RAMFUNC void filtLowPass32(int32_t u, uint16_t coef, int32_t *y) {
   int64_t tmp;  
   tmp = ((int64_t)((u << 4) - (*y >> 12)) * coef) >> 4;
   tmp = CLAMP(tmp, -2147483648LL, 2147483647LL);  // Overflow protection: 2147483647LL = 2^31 - 1
@@ -867,7 +1254,7 @@ void filtLowPass32(int32_t u, uint16_t coef, int32_t *y) {
   * Outputs:      y     = fixdt(1,16,4)
   * Parameters:   rate  = fixdt(1,16,4) = [0, 32767] Do NOT make rate negative (>32767)
   */
-void rateLimiter16(int16_t u, int16_t rate, int16_t *y) {
+RAMFUNC void rateLimiter16(int16_t u, int16_t rate, int16_t *y) {
   int16_t q0;
   int16_t q1;
 
@@ -973,4 +1360,50 @@ void multipleTapDet(int16_t u, uint32_t timeNow, MultipleTap *x) {
   x->t_timePrev 	  = t_time;
 }
 
+/* =========================== CRC Function =========================== */
 
+/*
+ * CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), table driven: ~8 cycles per byte
+ * Start with crc = 0xFFFF, chain calls to add data in pieces.
+ */
+static const uint16_t crc16Table[256] = {
+  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+  0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+  0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+  0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+  0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+  0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+  0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+  0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+  0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+  0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+  0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+  0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+  0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+  0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+  0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+  0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+  0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+  0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+  0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+  0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+  0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+  0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+  0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+  0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+  0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+  0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+  0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+  0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+  0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+  0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+  0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+  0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
+};
+
+uint16_t calcCRC16(uint16_t crc, const uint8_t *data, uint32_t len) {
+  while (len--) {
+    crc = (uint16_t)(crc << 8) ^ crc16Table[(uint8_t)(crc >> 8) ^ *data++];
+  }
+  return crc;
+}
@@ -0,0 +1,53 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Define to prevent recursive inclusion
+#ifndef FLASH_HOST_H
+#define FLASH_HOST_H
+
+#include <stdint.h>
+#include <setjmp.h>
+
+// In-memory NOR flash model of the two EEPROM emulation pages (PAGE0_BASE_ADDRESS, PAGE1_BASE_ADDRESS)
+// for the host build of eeprom.c (EE_HOST). As on the STM32F1 a half-word can only be programmed
+// when it reads 0xFFFF, or to 0x0000 (otherwise PGERR), and an erase sets the whole page to 0xFFFF.
+// Times: STM32F103xE datasheet, typical half-word program, maximum page erase; endurance: minimum.
+#define FLASH_HOST_PAGES        2
+#define FLASH_HOST_PROG_NS      52500U                 // [ns] half-word program
+#define FLASH_HOST_ERASE_NS     40000000U              // [ns] page erase
+#define FLASH_HOST_ENDURANCE    10000U                 // [-] erase cycles per page
+
+typedef struct {
+  uint64_t  reads;                      // [-] half-words read by EE_READ16
+  uint64_t  programs;                   // [-] half-words programmed
+  uint64_t  erases[FLASH_HOST_PAGES];   // [-] erase operations per page, incl. cut ones
+  uint64_t  pgErr;                      // [-] program operations refused: half-word not erased
+  uint64_t  busyNs;                     // [ns] program and erase time on the target
+} FlashHostStat;
+
+void     FlashHost_Erase(void);                                 // all pages erased, statistics cleared
+void     FlashHost_Stat(FlashHostStat *out);
+void     FlashHost_ClearStat(void);
+uint64_t FlashHost_Ops(void);                                   // [-] program and erase operations so far
+
+// Power cut: the n-th program or erase operation from now (n >= 1) is interrupted and the model
+// returns to env with longjmp(env, 1). A cut program clears a random part of the bits it should
+// clear, a cut erase leaves every half-word of the page either erased or unchanged, at random.
+// n = 0 disarms, a cut disarms as well.
+void     FlashHost_ArmCut(uint64_t n, jmp_buf *env);
+
+#endif // FLASH_HOST_H
@@ -0,0 +1,55 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Define to prevent recursive inclusion
+#ifndef PLANT_H
+#define PLANT_H
+
+#include <stdint.h>
+
+// Hub motor + wheel model used by the SIL build (SI units)
+typedef struct {
+  // Parameters
+  double  Rs;           // [Ohm]    phase resistance
+  double  Ls;           // [H]      phase inductance
+  double  psi;          // [Wb]     permanent magnet flux linkage
+  int     polePairs;    // [-]      number of pole pairs
+  double  J;            // [kg*m^2] wheel + load inertia
+  double  bVisc;        // [Nm*s]   viscous friction
+  double  tCoul;        // [Nm]     coulomb friction
+  double  tLoad;        // [Nm]     external load torque
+  double  Vdc;          // [V]      battery voltage
+  double  aHallOfs;     // [rad]    electrical angle of the first hall edge
+
+  // States
+  double  iAlpha;       // [A]      stator current, alpha axis
+  double  iBeta;        // [A]      stator current, beta axis
+  double  wMech;        // [rad/s]  wheel speed
+  double  aElec;        // [rad]    electrical rotor angle, wrapped to [0, 2*pi)
+
+  // Outputs
+  double  iPha[3];      // [A]      phase currents A, B, C (positive into the motor)
+  double  iDC;          // [A]      DC link current drawn from the battery
+  double  tElec;        // [Nm]     electromagnetic torque
+} Plant;
+
+void    Plant_Init(Plant *p);
+void    Plant_Step(Plant *p, const double duty[3], double dt, int nSub);
+uint8_t Plant_Hall(const Plant *p);
+double  Plant_Rpm(const Plant *p);
+
+#endif // PLANT_H
@@ -0,0 +1,19 @@
+/*
+ * Force-included in front of Src/BLDC_controller.c for the SIL build only.
+ *
+ * The generated controller checks at compile time that <limits.h> describes the
+ * 32-bit target it was generated for (long = 32 bit). On a 64-bit host that check
+ * fails although the code never uses 'long'. Pin the two limits it checks to the
+ * ARM Cortex-M3 values so the unmodified source compiles on the PC.
+ */
+#ifndef SIL_LIMITS_H
+#define SIL_LIMITS_H
+
+#include <limits.h>
+
+#undef  ULONG_MAX
+#define ULONG_MAX  (0xFFFFFFFFUL)
+#undef  LONG_MAX
+#define LONG_MAX   (0x7FFFFFFFL)
+
+#endif // SIL_LIMITS_H
@@ -0,0 +1,175 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Host stand-in for the STM32F1 HAL used by the software-in-the-loop (SIL) build.
+ * It sits in front of Inc/ on the include path so that the firmware sources compile
+ * unmodified on a PC. Peripherals are plain structs in RAM; only the subset of the
+ * HAL that the SIL-compiled sources touch is provided (see sil/Src/hal_stub.c).
+ */
+
+// Define to prevent recursive inclusion
+#ifndef STM32F1XX_HAL_H
+#define STM32F1XX_HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define __IO volatile
+
+typedef enum {
+  HAL_OK       = 0x00U,
+  HAL_ERROR    = 0x01U,
+  HAL_BUSY     = 0x02U,
+  HAL_TIMEOUT  = 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum { RESET = 0U, SET = !RESET } FlagStatus, ITStatus;
+typedef enum { DISABLE = 0U, ENABLE = !DISABLE } FunctionalState;
+
+#define __disable_irq()
+#define __enable_irq()
+
+#define SET_BIT(REG, BIT)     ((REG) |= (BIT))
+#define CLEAR_BIT(REG, BIT)   ((REG) &= ~(BIT))
+#define READ_BIT(REG, BIT)    ((REG) & (BIT))
+
+/* =========================== Peripherals =========================== */
+typedef struct {
+  __IO uint32_t CRL, CRH, IDR, ODR, BSRR, BRR, LCKR;
+} GPIO_TypeDef;
+
+typedef struct {
+  __IO uint32_t CR1, CR2, SMCR, DIER, SR, EGR, CCMR1, CCMR2, CCER, CNT, PSC, ARR, RCR;
+  __IO uint32_t CCR1, CCR2, CCR3, CCR4, BDTR, DCR, DMAR;
+} TIM_TypeDef;
+
+typedef struct {
+  __IO uint32_t SR, DR, BRR, CR1, CR2, CR3, GTPR;
+} USART_TypeDef;
+
+typedef struct {
+  __IO uint32_t CCR, CNDTR, CPAR, CMAR;
+} DMA_Channel_TypeDef;
+
+typedef struct {
+  __IO uint32_t ISR, IFCR;
+} DMA_TypeDef;
+
+extern GPIO_TypeDef sil_GPIOA, sil_GPIOB, sil_GPIOC;
+extern TIM_TypeDef  sil_TIM1, sil_TIM8;
+extern USART_TypeDef sil_USART2, sil_USART3;
+extern DMA_TypeDef  sil_DMA1;
+
+#define GPIOA   (&sil_GPIOA)
+#define GPIOB   (&sil_GPIOB)
+#define GPIOC   (&sil_GPIOC)
+#define TIM1    (&sil_TIM1)
+#define TIM8    (&sil_TIM8)
+#define USART2  (&sil_USART2)
+#define USART3  (&sil_USART3)
+#define DMA1    (&sil_DMA1)
+
+#define GPIO_PIN_0    ((uint16_t)0x0001)
+#define GPIO_PIN_1    ((uint16_t)0x0002)
+#define GPIO_PIN_2    ((uint16_t)0x0004)
+#define GPIO_PIN_3    ((uint16_t)0x0008)
+#define GPIO_PIN_4    ((uint16_t)0x0010)
+#define GPIO_PIN_5    ((uint16_t)0x0020)
+#define GPIO_PIN_6    ((uint16_t)0x0040)
+#define GPIO_PIN_7    ((uint16_t)0x0080)
+#define GPIO_PIN_8    ((uint16_t)0x0100)
+#define GPIO_PIN_9    ((uint16_t)0x0200)
+#define GPIO_PIN_10   ((uint16_t)0x0400)
+#define GPIO_PIN_11   ((uint16_t)0x0800)
+#define GPIO_PIN_12   ((uint16_t)0x1000)
+#define GPIO_PIN_13   ((uint16_t)0x2000)
+#define GPIO_PIN_14   ((uint16_t)0x4000)
+#define GPIO_PIN_15   ((uint16_t)0x8000)
+
+typedef enum { GPIO_PIN_RESET = 0U, GPIO_PIN_SET } GPIO_PinState;
+
+#define TIM_BDTR_MOE          (0x1UL << 15)
+#define USART_CR1_PEIE        (0x1UL << 8)
+#define USART_CR3_EIE         (0x1UL << 0)
+#define DMA_IFCR_CTCIF1       (0x1UL << 1)
+
+/* =========================== Handles =========================== */
+typedef struct {
+  DMA_Channel_TypeDef *Instance;
+} DMA_HandleTypeDef;
+
+typedef struct {
+  USART_TypeDef     *Instance;
+  DMA_HandleTypeDef *hdmatx;
+  DMA_HandleTypeDef *hdmarx;
+  uint8_t           *pRxBuffPtr;          // Rx DMA buffer, written by the SIL line model
+  uint16_t           RxXferSize;
+} UART_HandleTypeDef;
+
+typedef struct {
+  void *Instance;
+} I2C_HandleTypeDef;
+
+typedef struct {
+  TIM_TypeDef *Instance;
+} TIM_HandleTypeDef;
+
+typedef struct {
+  void *Instance;
+} ADC_HandleTypeDef;
+
+#define __HAL_DMA_GET_COUNTER(__HANDLE__) ((__HANDLE__)->Instance->CNDTR)
+
+/* =========================== Flash =========================== */
+#define FLASH_PAGE_SIZE               0x800U
+#define FLASH_TYPEERASE_PAGES         0x00U
+#define FLASH_TYPEPROGRAM_HALFWORD    0x01U
+
+typedef struct {
+  uint32_t TypeErase;
+  uint32_t Banks;
+  uint32_t PageAddress;
+  uint32_t NbPages;
+} FLASH_EraseInitTypeDef;
+
+/* =========================== Functions =========================== */
+extern uint32_t SystemCoreClock;
+
+uint32_t          HAL_GetTick(void);
+void              HAL_Delay(uint32_t Delay);
+GPIO_PinState     HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+void              HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+void              HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+void              HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart);
+void              HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart);
+void              HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError);
+
+/* =========================== SIL hooks =========================== */
+extern HAL_StatusTypeDef (*sil_uartTxHook)(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+extern uint32_t (*sil_profCyclesHook)(void);
+extern int sil_printfMute;
+int sil_printf(const char *format, ...);
+
+#endif // STM32F1XX_HAL_H
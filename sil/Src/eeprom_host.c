@@ -0,0 +1,275 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Host benchmark of the EEPROM emulation (Src/eeprom.c, built with EE_HOST) on the flash model
+ * of sil/Src/flash_host.c. A number of configuration saves is written with -c of the NB_OF_VAR
+ * variables changed each time, in three ways:
+ *   legacy  the former eeprom.c: every save appends all variables, no commit markers
+ *   single  one EE_WriteVariable() per variable, each committed alone
+ *   batch   EE_WriteBegin(), all variables, EE_WriteCommit(), as saveConfig() does
+ * and the half-words programmed, page erases and flash time per save are reported. Write
+ * amplification = half-words programmed / half-words of the changed values.
+ * The boot read then compares EE_Init() and reading all variables with the former backward
+ * scan of the active page per variable, in flash half-word reads and host time.
+ * Usage: see usage() or run 'build/sil/hover_eeprom -?'.
+ */
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "stm32f1xx_hal.h"
+#include "eeprom.h"
+#include "flash_host.h"
+
+/* =========================== Variable Definitions =========================== */
+
+uint16_t VirtAddVarTab[NB_OF_VAR] = VIRT_ADDR_TAB;   // same table as util.c
+
+typedef enum { MODE_LEGACY, MODE_SINGLE, MODE_BATCH, MODES } SaveMode;
+static const char *modeName[MODES] = { "legacy", "single", "batch" };
+
+static uint32_t nSaves   = 1000;        // [-] configuration saves
+static uint32_t nChanged = 2;           // [-] variables with a new value per save
+static uint32_t nBoots   = 20000;       // [-] boot reads timed
+
+static uint16_t expect[NB_OF_VAR];      // last value written per variable
+static double   bootReads[MODES];       // [-] flash half-word reads per boot
+static double   bootNs[MODES];          // [ns] host time per boot
+
+/* =========================== Helpers =========================== */
+
+static double ee_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t ee_pageAddress(uint16_t page) {
+  return page ? PAGE1_BASE_ADDRESS : PAGE0_BASE_ADDRESS;
+}
+
+static void ee_program(uint32_t address, uint16_t data) {
+  HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, address, data);
+}
+
+static void ee_erase(uint16_t page) {
+  FLASH_EraseInitTypeDef e = { FLASH_TYPEERASE_PAGES, 0, ee_pageAddress(page), 1 };
+  uint32_t err;
+  HAL_FLASHEx_Erase(&e, &err);
+}
+
+/* =========================== Former eeprom.c =========================== */
+// Same record layout and page transfer, no index: a read scans the page backwards, a save
+// appends every variable.
+
+static uint16_t legPage;                // active page, 0 or 1
+static uint32_t legNext;                // first free record
+
+static void legacy_format(void) {
+  FlashHost_Erase();
+  ee_program(PAGE0_BASE_ADDRESS, VALID_PAGE);
+  legPage = 0;
+  legNext = PAGE0_BASE_ADDRESS + 4;
+}
+
+static uint16_t legacy_scan(uint16_t page, uint16_t virtAddress, uint16_t *data) {
+  uint32_t start   = ee_pageAddress(page);
+  uint32_t address = start + PAGE_SIZE - 2;
+
+  while (address > start + 2) {
+    if (EE_READ16(address) == virtAddress) {
+      *data = EE_READ16(address - 2);
+      return 0;
+    }
+    address -= 4;
+  }
+  return 1;
+}
+
+static uint16_t legacy_read(uint16_t virtAddress, uint16_t *data) {
+  return legacy_scan(legPage, virtAddress, data);
+}
+
+static void legacy_record(uint16_t virtAddress, uint16_t data) {
+  ee_program(legNext, data);
+  ee_program(legNext + 2, virtAddress);
+  legNext += 4;
+}
+
+static void legacy_write(uint16_t virtAddress, uint16_t data) {
+  if (legNext >= ee_pageAddress(legPage) + PAGE_SIZE) {        // page full: transfer
+    uint16_t old = legPage, value;
+    legPage = !legPage;
+    legNext = ee_pageAddress(legPage) + 4;
+    ee_program(ee_pageAddress(legPage), RECEIVE_DATA);
+    legacy_record(virtAddress, data);
+    for (int i = 0; i < NB_OF_VAR; i++) {
+      if (VirtAddVarTab[i] != virtAddress && legacy_scan(old, VirtAddVarTab[i], &value) == 0) {
+        legacy_record(VirtAddVarTab[i], value);
+      }
+    }
+    ee_erase(old);
+    ee_program(ee_pageAddress(legPage), VALID_PAGE);
+    return;
+  }
+  legacy_record(virtAddress, data);
+}
+
+/* =========================== Benchmark =========================== */
+
+static uint16_t ee_value(uint32_t save, int k) {
+  for (uint32_t j = 0; j < nChanged; j++) {
+    if ((save * nChanged + j) % NB_OF_VAR == (uint32_t)k) {
+      expect[k] = (uint16_t)(save * 7 + k);
+    }
+  }
+  return expect[k];
+}
+
+// Returns the number of variables read back wrong
+static int ee_run(SaveMode mode) {
+  FlashHostStat st;
+  uint64_t      changedHw;
+  int           bad = 0;
+
+  for (int k = 0; k < NB_OF_VAR; k++) {
+    expect[k] = (uint16_t)(0x100 + k);
+  }
+  if (mode == MODE_LEGACY) {
+    legacy_format();
+    for (int k = 0; k < NB_OF_VAR; k++) { legacy_write(VirtAddVarTab[k], expect[k]); }
+  } else {
+    FlashHost_Erase();
+    EE_Init();
+    EE_WriteBegin();
+    for (int k = 0; k < NB_OF_VAR; k++) { EE_WriteVariable(VirtAddVarTab[k], expect[k]); }
+    EE_WriteCommit();
+  }
+  FlashHost_ClearStat();
+
+  for (uint32_t n = 0; n < nSaves; n++) {
+    if (mode == MODE_BATCH) { EE_WriteBegin(); }
+    for (int k = 0; k < NB_OF_VAR; k++) {
+      uint16_t v = ee_value(n, k);
+      if (mode == MODE_LEGACY) {
+        legacy_write(VirtAddVarTab[k], v);
+      } else {
+        EE_WriteVariable(VirtAddVarTab[k], v);
+      }
+    }
+    if (mode == MODE_BATCH) { EE_WriteCommit(); }
+  }
+  FlashHost_Stat(&st);
+
+  changedHw = (uint64_t)nSaves * (nChanged < NB_OF_VAR ? nChanged : NB_OF_VAR) * 2;
+  printf("%-7s %9.1f %8llu %10.1f %10.2f %8.1f\n", modeName[mode],
+    (double)st.programs / nSaves,
+    (unsigned long long)(st.erases[0] + st.erases[1]),
+    st.erases[0] + st.erases[1] ? (double)nSaves / (st.erases[0] + st.erases[1]) : 0.0,
+    (double)st.busyNs / nSaves * 1e-6,
+    changedHw ? (double)st.programs / changedHw : 0.0);
+
+  // Read back after a reset
+  if (mode != MODE_LEGACY) {
+    EE_Init();
+  }
+  for (int k = 0; k < NB_OF_VAR; k++) {
+    uint16_t v = 0;
+    uint16_t s = (mode == MODE_LEGACY) ? legacy_read(VirtAddVarTab[k], &v) : EE_ReadVariable(VirtAddVarTab[k], &v);
+    if (s != 0 || v != expect[k]) {
+      bad++;
+    }
+  }
+  return bad;
+}
+
+// Flash reads and host time of one boot: EE_Init() (not legacy) and reading every variable
+static void ee_boot(SaveMode mode) {
+  FlashHostStat st;
+  double        t0, t1;
+  uint16_t      v;
+
+  FlashHost_ClearStat();
+  t0 = ee_now();
+  for (uint32_t b = 0; b < nBoots; b++) {
+    if (mode != MODE_LEGACY) {
+      EE_Init();
+    }
+    for (int k = 0; k < NB_OF_VAR; k++) {
+      if (mode == MODE_LEGACY) {
+        legacy_read(VirtAddVarTab[k], &v);
+      } else {
+        EE_ReadVariable(VirtAddVarTab[k], &v);
+      }
+    }
+  }
+  t1 = ee_now();
+  FlashHost_Stat(&st);
+  bootReads[mode] = (double)st.reads / nBoots;
+  bootNs[mode]    = (t1 - t0) / nBoots * 1e9;
+}
+
+static void usage(const char *prog) {
+  printf("Usage: %s [options]\n"
+         "  -s <saves>       configuration saves (default 1000)\n"
+         "  -c <vars>        variables changed per save, 0..%d (default 2)\n"
+         "  -b <boots>       boot reads timed (default 20000)\n",
+         prog, NB_OF_VAR);
+}
+
+/* =========================== Main =========================== */
+
+int main(int argc, char **argv) {
+  int opt, bad = 0;
+
+  while ((opt = getopt(argc, argv, "s:c:b:")) != -1) {
+    switch (opt) {
+      case 's': nSaves   = (uint32_t)atoi(optarg); break;
+      case 'c': nChanged = (uint32_t)atoi(optarg); break;
+      case 'b': nBoots   = (uint32_t)atoi(optarg); break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+  if (nSaves == 0 || nBoots == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  printf("%u saves of %d variables, %u changed per save\n", (unsigned)nSaves, NB_OF_VAR, (unsigned)nChanged);
+  printf("mode    prog/save   erases saves/erase flash ms/save   ampl.\n");
+  for (int m = 0; m < MODES; m++) {
+    int b = ee_run((SaveMode)m);
+    if (b) {
+      printf("%-7s %d variables read back wrong\n", modeName[m], b);
+    }
+    bad += b;
+    if (m != MODE_SINGLE) {
+      ee_boot((SaveMode)m);
+    }
+  }
+  printf("boot read of all variables after the last save:\n");
+  printf("legacy  %8.0f half-word reads %8.0f ns host (backward scan per variable)\n", bootReads[MODE_LEGACY], bootNs[MODE_LEGACY]);
+  printf("batch   %8.0f half-word reads %8.0f ns host (EE_Init incl. spare page erase check, then RAM index)\n",
+    bootReads[MODE_BATCH], bootNs[MODE_BATCH]);
+  return bad ? 1 : 0;
+}
@@ -0,0 +1,368 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Wear and power-loss test of the EEPROM emulation (Src/eeprom.c, built with EE_HOST) on the
+ * NOR flash model of sil/Src/flash_host.c. The variables are laid out as in util.c: 0 write key,
+ * 1..2 limits, 3..18 input calibration, 19 offsets check word, 20..25 ADC current offsets.
+ *   daily  (-d) one boot (EE_Init, every variable read) and at power off one saveConfig() batch
+ *          per day: new ADC offsets on -o % of the days, a new input calibration every -k days.
+ *          Reports the erases per page and the projected life to FLASH_HOST_ENDURANCE cycles,
+ *          the flash time of a save (poweroff() waits for it) and the commit throughput.
+ *   cut    (-x) the power is cut at every program / erase operation of a save appending to the
+ *          page and of a save moving to the other page, -r torn patterns each, optionally a
+ *          second cut at every operation of the recovery in EE_Init (-2). After the reboot all
+ *          variables must read either the values before or after the save, and the next save
+ *          must be stored and read back.
+ * Usage: see usage() or run 'build/sil/hover_eewear -?'.
+ */
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <time.h>
+#include <unistd.h>
+#include "stm32f1xx_hal.h"
+#include "eeprom.h"
+#include "flash_host.h"
+
+/* =========================== Variable Definitions =========================== */
+
+uint16_t VirtAddVarTab[NB_OF_VAR] = VIRT_ADDR_TAB;   // same table as util.c
+
+#define VAR_INPUT           3           // first input calibration variable
+#define VAR_INPUTS          16
+#define VAR_OFFSET          19          // check word and the six offsets
+#define VAR_OFFSETS         7
+#define CUT_CHANGED         4           // [-] variables changed per save in the cut sweep
+
+typedef struct {
+  uint32_t  cases;                      // [-] cut runs
+  uint32_t  before;                     // [-] reboots with all values from before the save
+  uint32_t  after;                      // [-] reboots with all values from the save
+  uint32_t  mixed;                      // [-] reboots with a part of the save: batch not atomic
+  uint32_t  lost;                       // [-] reboots with a variable missing or a foreign value
+  uint32_t  stuck;                      // [-] next save not stored after the recovery
+  uint64_t  pgErr;                      // [-] refused program operations
+} CutResult;
+
+static uint32_t nDays     = 3650;       // [-] days of the daily pattern
+static uint32_t pOffset   = 30;         // [%] days with new ADC offsets
+static uint32_t kCal      = 30;         // [days] input calibration interval
+static uint32_t nSeeds    = 4;          // [-] torn patterns per cut point
+static int      doDaily   = 0;
+static int      doCut     = 0;
+static int      doDouble  = 0;
+
+static jmp_buf  cutEnv;
+
+/* =========================== Helpers =========================== */
+
+static double ee_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void ee_boot(uint32_t unused) {
+  (void)unused;
+  EE_Init();
+}
+
+// Runs fcn(arg) with the power cut at its n-th flash operation, 1 if the cut happened
+static int ee_cut(uint64_t n, void (*fcn)(uint32_t), uint32_t arg) {
+  if (setjmp(cutEnv)) {
+    return 1;
+  }
+  FlashHost_ArmCut(n, &cutEnv);
+  fcn(arg);
+  FlashHost_ArmCut(0, NULL);
+  return 0;
+}
+
+/* =========================== Cut sweep =========================== */
+// Save 0 writes every variable, save n >= 1 changes CUT_CHANGED of them.
+
+static int cut_changed(uint32_t n, int k) {
+  for (uint32_t j = 0; j < CUT_CHANGED; j++) {
+    if ((n * CUT_CHANGED + j) % NB_OF_VAR == (uint32_t)k) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Value of variable k after saves 0..n
+static uint16_t cut_value(uint32_t n, int k) {
+  for (; n >= 1; n--) {
+    if (cut_changed(n, k)) {
+      return (uint16_t)(n * 7 + k);
+    }
+  }
+  return (uint16_t)(0x100 + k);
+}
+
+static void cut_save(uint32_t n) {
+  EE_WriteBegin();
+  for (int k = 0; k < NB_OF_VAR; k++) {
+    EE_WriteVariable(VirtAddVarTab[k], cut_value(n, k));
+  }
+  EE_WriteCommit();
+}
+
+// Erased flash, boot, saves 0..n-1
+static void cut_prefix(uint32_t n) {
+  FlashHost_Erase();
+  EE_Init();
+  for (uint32_t i = 0; i < n; i++) {
+    cut_save(i);
+  }
+}
+
+// First save >= from that erases a page (moves to the other page)
+static uint32_t cut_findTransfer(uint32_t from) {
+  FlashHostStat st;
+
+  cut_prefix(from);
+  for (uint32_t n = from; ; n++) {
+    FlashHost_ClearStat();
+    cut_save(n);
+    FlashHost_Stat(&st);
+    if (st.erases[0] + st.erases[1]) {
+      return n;
+    }
+  }
+}
+
+static uint64_t cut_countOps(void (*fcn)(uint32_t), uint32_t arg) {
+  uint64_t ops = FlashHost_Ops();
+  fcn(arg);
+  return FlashHost_Ops() - ops;
+}
+
+// After the final reboot: classify the values, then check that the next save is stored
+static void cut_verify(uint32_t save, CutResult *res) {
+  FlashHostStat st;
+  uint32_t      nBefore = 0, nAfter = 0, nBad = 0;
+
+  for (int k = 0; k < NB_OF_VAR; k++) {
+    uint16_t v = 0;
+    if (EE_ReadVariable(VirtAddVarTab[k], &v) != 0) {
+      nBad++;
+      continue;
+    }
+    uint16_t vb = cut_value(save - 1, k), va = cut_value(save, k);
+    if (v == vb) { nBefore++; }           // an unchanged variable counts for both
+    if (v == va) { nAfter++; }
+    if (v != vb && v != va) { nBad++; }
+  }
+  if (nBad) {
+    res->lost++;
+  } else if (nBefore == NB_OF_VAR) {
+    res->before++;
+  } else if (nAfter == NB_OF_VAR) {
+    res->after++;
+  } else {
+    res->mixed++;
+  }
+
+  cut_save(save + 1);                   // from either state save + 1 ends in the same values
+  EE_Init();
+  for (int k = 0; k < NB_OF_VAR; k++) {
+    uint16_t v = 0;
+    if (EE_ReadVariable(VirtAddVarTab[k], &v) != 0 || v != cut_value(save + 1, k)) {
+      res->stuck++;
+      break;
+    }
+  }
+  FlashHost_Stat(&st);
+  res->pgErr += st.pgErr;
+}
+
+static void cut_sweep(const char *name, uint32_t save, CutResult *res) {
+  uint64_t nOps;
+
+  cut_prefix(save);
+  nOps = cut_countOps(cut_save, save);
+  memset(res, 0, sizeof(*res));
+
+  for (uint64_t k = 1; k <= nOps; k++) {
+    for (uint32_t seed = 1; seed <= nSeeds; seed++) {
+      uint64_t nRec = 1;
+
+      if (doDouble) {                   // operations of the recovery after this cut
+        srand(seed);
+        cut_prefix(save);
+        ee_cut(k, cut_save, save);
+        nRec = cut_countOps(ee_boot, 0) + 1;
+      }
+      for (uint64_t j = 1; j <= nRec; j++) {
+        srand(seed);
+        cut_prefix(save);
+        FlashHost_ClearStat();
+        ee_cut(k, cut_save, save);
+        if (doDouble) {
+          ee_cut(j, ee_boot, 0);        // j = nRec: the recovery completes
+        }
+        EE_Init();
+        res->cases++;
+        cut_verify(save, res);
+      }
+    }
+  }
+  printf("%-9s save %3u: %3llu ops, %6u cuts: %6u before, %6u after, %u mixed, %u lost, %u stuck, %llu PGERR\n",
+    name, (unsigned)save, (unsigned long long)nOps, (unsigned)res->cases, (unsigned)res->before, (unsigned)res->after,
+    (unsigned)res->mixed, (unsigned)res->lost, (unsigned)res->stuck, (unsigned long long)res->pgErr);
+}
+
+/* =========================== Daily pattern =========================== */
+
+static void daily(void) {
+  FlashHostStat st;
+  uint16_t      val[NB_OF_VAR];
+  uint32_t      saves = 0, vars = 0;
+  uint64_t      busyPrev = 0, busyMax = 0, ePage;
+  double        tCommit = 0;
+
+  srand(1);
+  FlashHost_Erase();
+  EE_Init();
+  for (int k = 0; k < NB_OF_VAR; k++) {
+    val[k] = (uint16_t)(k == 0 ? 0x0FF1 : 0x100 + k);   // configuration from config.h, first save
+  }
+  EE_WriteBegin();
+  for (int k = 0; k < NB_OF_VAR; k++) {
+    EE_WriteVariable(VirtAddVarTab[k], val[k]);
+  }
+  EE_WriteCommit();
+  FlashHost_ClearStat();
+
+  for (uint32_t d = 0; d < nDays; d++) {
+    int      newOffsets = (uint32_t)(rand() % 100) < pOffset;
+    int      newCal     = kCal && (d % kCal) == kCal - 1;
+    uint16_t v;
+    double   t0;
+
+    EE_Init();                          // boot
+    for (int k = 0; k < NB_OF_VAR; k++) {
+      EE_ReadVariable(VirtAddVarTab[k], &v);
+    }
+    if (!newOffsets && !newCal) {
+      continue;                         // saveConfig() returns without a write
+    }
+
+    EE_WriteBegin();
+    if (newOffsets) {
+      uint16_t sum = 0;
+      for (int k = VAR_OFFSET + 1; k < VAR_OFFSET + VAR_OFFSETS; k++) {
+        val[k] = (uint16_t)(2000 + rand() % 64);
+        sum   += val[k];
+      }
+      val[VAR_OFFSET] = (uint16_t)(0x0FF5 ^ sum);
+      for (int k = VAR_OFFSET; k < VAR_OFFSET + VAR_OFFSETS; k++) {
+        EE_WriteVariable(VirtAddVarTab[k], val[k]);
+      }
+    }
+    if (newCal) {
+      for (int k = VAR_INPUT; k < VAR_INPUT + VAR_INPUTS; k++) {
+        val[k] = (uint16_t)rand();
+      }
+      for (int k = 0; k < VAR_OFFSET; k++) {
+        EE_WriteVariable(VirtAddVarTab[k], val[k]);
+      }
+    }
+    t0 = ee_now();
+    EE_WriteCommit();
+    tCommit += ee_now() - t0;
+
+    FlashHost_Stat(&st);
+    if (st.busyNs - busyPrev > busyMax) {
+      busyMax = st.busyNs - busyPrev;
+    }
+    busyPrev = st.busyNs;
+    saves++;
+    vars += (newOffsets ? VAR_OFFSETS : 0) + (newCal ? VAR_INPUTS : 0);
+  }
+
+  FlashHost_Stat(&st);
+  ePage = st.erases[0] > st.erases[1] ? st.erases[0] : st.erases[1];
+  printf("daily: %u days, %u saves, %u variables changed\n", (unsigned)nDays, (unsigned)saves, (unsigned)vars);
+  printf("  erases page0 %llu page1 %llu, life to %u cycles: %.0f years\n",
+    (unsigned long long)st.erases[0], (unsigned long long)st.erases[1], FLASH_HOST_ENDURANCE,
+    ePage ? (double)FLASH_HOST_ENDURANCE * nDays / ePage / 365.0 : 0.0);
+  printf("  half-words programmed %llu (%.1f per save), refused %llu\n",
+    (unsigned long long)st.programs, saves ? (double)st.programs / saves : 0.0, (unsigned long long)st.pgErr);
+  printf("  flash time per save: %.2f ms mean, %.2f ms max\n",
+    saves ? (double)st.busyNs / saves * 1e-6 : 0.0, busyMax * 1e-6);
+  printf("  throughput: %.0f variables/s flash (target), %.0f commits/s host\n",
+    st.busyNs ? vars / (st.busyNs * 1e-9) : 0.0, tCommit > 0 ? saves / tCommit : 0.0);
+}
+
+static void usage(const char *prog) {
+  printf("Usage: %s [options]   (no option: -d and -x)\n"
+         "  -d <days>        daily pattern over <days> (default 3650)\n"
+         "  -o <%%>           days with new ADC offsets (default 30)\n"
+         "  -k <days>        input calibration interval, 0 = never (default 30)\n"
+         "  -x               power-cut sweep\n"
+         "  -2               power-cut sweep with a second cut during the recovery\n"
+         "  -r <n>           torn patterns per cut point (default 4)\n",
+         prog);
+}
+
+/* =========================== Main =========================== */
+
+int main(int argc, char **argv) {
+  int       opt;
+  CutResult app, xfer;
+  uint32_t  sXfer;
+
+  while ((opt = getopt(argc, argv, "d:o:k:x2r:")) != -1) {
+    switch (opt) {
+      case 'd': nDays   = (uint32_t)atoi(optarg); doDaily = 1; break;
+      case 'o': pOffset = (uint32_t)atoi(optarg); break;
+      case 'k': kCal    = (uint32_t)atoi(optarg); break;
+      case 'x': doCut   = 1; break;
+      case '2': doCut   = 1; doDouble = 1; break;
+      case 'r': nSeeds  = (uint32_t)atoi(optarg); break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+  if (!doDaily && !doCut) {
+    doDaily = doCut = 1;
+  }
+
+  if (doDaily) {
+    daily();
+  }
+  if (!doCut) {
+    return 0;
+  }
+
+  sXfer = cut_findTransfer(1);
+  cut_sweep("append", sXfer - 3, &app);
+  cut_sweep("transfer", sXfer, &xfer);
+  if (app.mixed + app.lost + app.stuck + app.pgErr + xfer.mixed + xfer.lost + xfer.stuck + xfer.pgErr) {
+    printf("FAIL\n");
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,258 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Host stress test of the main loop <-> PWM interrupt exchange (Src/exchange.c).
+ * Two threads stand in for the two contexts. On a multi-core PC they run truly in
+ * parallel, a harder case than the preemption on the board; on a single core they
+ * interleave by preemption like the board, only at random points:
+ *   "isr"  publishes ExchState snapshots and reads the ExchSetpoint
+ *   "main" publishes ExchSetpoint snapshots and reads the ExchState
+ * Every field of a snapshot is derived from one counter, so a reader can tell a
+ * torn (mixed) snapshot, and the state tick must never go backwards. For comparison
+ * the same values are also exchanged through plain shared structs, written field by
+ * field the way the globals were used before.
+ * Usage: see usage() or run 'build/sil/hover_exch -?'.
+ */
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "exchange.h"
+
+/* =========================== Variable Definitions =========================== */
+
+typedef struct {
+  uint64_t  reads;                      // [-] snapshots read
+  uint64_t  retries;                    // [-] repeated copies
+  uint32_t  retryMax;                   // [-] most repeated copies in one read
+  uint64_t  torn;                       // [-] inconsistent snapshots
+  uint64_t  stale;                      // [-] snapshots older than the previous one
+  uint64_t  plainReads;                 // [-] reads of the plain shared struct
+  uint64_t  plainTorn;                  // [-] inconsistent plain reads
+  double    tPub, tRead;                // [s] time spent in Exch_Publish / Exch_Read
+} ExchCheck;
+
+static uint32_t          nPub  = 2000000;   // publishes per thread
+static uint32_t          nPause = 0;         // [-] busy loop iterations between two publishes
+static volatile int      stop;
+
+static volatile ExchState    plainState;    // former way: plain globals, no consistency guarantee
+static volatile ExchSetpoint plainSetpoint;
+
+/* =========================== Helpers =========================== */
+
+static double exch_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void exch_pause(uint32_t n) {
+  for (volatile uint32_t i = 0; i < n; i++) { }
+}
+
+// All fields follow from the tick
+static void exch_makeState(ExchState *s, uint32_t k) {
+  s->tick      = k;
+  s->n_motL    = (int16_t)k;
+  s->n_motR    = (int16_t)~k;
+  s->iqL       = (int16_t)(k * 3U);
+  s->iqR       = (int16_t)(k * 5U);
+  s->i_DCLinkL = (int16_t)(k >> 3);
+  s->i_DCLinkR = (int16_t)(k >> 5);
+  s->errCodeL  = (uint8_t)(k & 0x0F);
+  s->errCodeR  = (uint8_t)(k >> 4);
+}
+
+static int exch_stateOk(const ExchState *s) {
+  ExchState ref;
+  exch_makeState(&ref, s->tick);
+  return s->n_motL    == ref.n_motL    && s->n_motR    == ref.n_motR &&
+         s->iqL       == ref.iqL       && s->iqR       == ref.iqR &&
+         s->i_DCLinkL == ref.i_DCLinkL && s->i_DCLinkR == ref.i_DCLinkR &&
+         s->errCodeL  == ref.errCodeL  && s->errCodeR  == ref.errCodeR;
+}
+
+// All fields follow from the left target
+static void exch_makeSetpoint(ExchSetpoint *s, uint32_t k) {
+  s->pwml       = (int16_t)(k & 0x7FFF);
+  s->pwmr       = (int16_t)~s->pwml;
+  s->enable     = (uint8_t)(k & 1U);
+  s->ctrlModReq = (uint8_t)((k >> 1) & 3U);
+}
+
+static int exch_setpointOk(const ExchSetpoint *s) {
+  return s->pwml >= 0 &&
+         s->pwmr       == (int16_t)~s->pwml &&
+         s->enable     == (uint8_t)(s->pwml & 1) &&
+         s->ctrlModReq == (uint8_t)((s->pwml >> 1) & 3);
+}
+
+static void exch_count(ExchCheck *c, uint16_t n, int ok) {
+  c->reads++;
+  c->retries += n;
+  if (n > c->retryMax) c->retryMax = n;
+  c->torn += !ok;
+}
+
+/* =========================== Threads =========================== */
+
+// PWM interrupt side: publish the state, consume the setpoint
+static void *exch_isr(void *arg) {
+  ExchCheck   *c = (ExchCheck *)arg;
+  ExchState    st;
+  ExchSetpoint sp;
+  double       t0;
+
+  for (uint32_t k = 1; k <= nPub; k++) {
+    exch_makeState(&st, k);
+    t0 = exch_now();
+    Exch_Publish(&exchState, &st);
+    c->tPub += exch_now() - t0;
+
+    plainState.tick      = st.tick;             // field by field, as the globals are written
+    plainState.n_motL    = st.n_motL;
+    plainState.n_motR    = st.n_motR;
+    plainState.iqL       = st.iqL;
+    plainState.iqR       = st.iqR;
+    plainState.i_DCLinkL = st.i_DCLinkL;
+    plainState.i_DCLinkR = st.i_DCLinkR;
+    plainState.errCodeL  = st.errCodeL;
+    plainState.errCodeR  = st.errCodeR;
+
+    t0 = exch_now();
+    uint16_t n = Exch_Read(&exchSetpoint, &sp);
+    c->tRead += exch_now() - t0;
+    exch_count(c, n, exch_setpointOk(&sp));
+
+    ExchSetpoint p;
+    p.pwml       = plainSetpoint.pwml;
+    p.pwmr       = plainSetpoint.pwmr;
+    p.enable     = plainSetpoint.enable;
+    p.ctrlModReq = plainSetpoint.ctrlModReq;
+    c->plainReads++;
+    c->plainTorn += !exch_setpointOk(&p);
+
+    exch_pause(nPause);
+  }
+  stop = 1;
+  return NULL;
+}
+
+// Main loop side: publish the setpoint, consume the state
+static void *exch_main(void *arg) {
+  ExchCheck   *c = (ExchCheck *)arg;
+  ExchState    st;
+  ExchSetpoint sp;
+  uint32_t     tickPrev = 0;
+  double       t0;
+
+  for (uint32_t k = 1; !stop; k++) {
+    exch_makeSetpoint(&sp, k);
+    t0 = exch_now();
+    Exch_Publish(&exchSetpoint, &sp);
+    c->tPub += exch_now() - t0;
+
+    plainSetpoint.pwml       = sp.pwml;
+    plainSetpoint.pwmr       = sp.pwmr;
+    plainSetpoint.enable     = sp.enable;
+    plainSetpoint.ctrlModReq = sp.ctrlModReq;
+
+    t0 = exch_now();
+    uint16_t n = Exch_Read(&exchState, &st);
+    c->tRead += exch_now() - t0;
+    exch_count(c, n, exch_stateOk(&st));
+    c->stale += st.tick < tickPrev;
+    tickPrev  = st.tick;
+
+    ExchState p;
+    p.tick      = plainState.tick;
+    p.n_motL    = plainState.n_motL;
+    p.n_motR    = plainState.n_motR;
+    p.iqL       = plainState.iqL;
+    p.iqR       = plainState.iqR;
+    p.i_DCLinkL = plainState.i_DCLinkL;
+    p.i_DCLinkR = plainState.i_DCLinkR;
+    p.errCodeL  = plainState.errCodeL;
+    p.errCodeR  = plainState.errCodeR;
+    c->plainReads++;
+    c->plainTorn += !exch_stateOk(&p);
+
+    exch_pause(nPause);
+  }
+  return NULL;
+}
+
+static void exch_report(const char *name, const char *dir, const ExchCheck *c) {
+  printf("%-5s reads %-9s: %llu reads, %llu torn, %llu stale, %llu retries (%.3f per read, max %u), plain globals: %llu of %llu torn\n",
+         name, dir, (unsigned long long)c->reads, (unsigned long long)c->torn, (unsigned long long)c->stale,
+         (unsigned long long)c->retries, (double)c->retries / (c->reads ? c->reads : 1), c->retryMax,
+         (unsigned long long)c->plainTorn, (unsigned long long)c->plainReads);
+}
+
+static void usage(const char *prog) {
+  printf("Usage: %s [options]\n"
+         "  -n <count>       state snapshots published by the isr thread (default 2000000)\n"
+         "  -p <loops>       busy loop iterations between two publishes, both threads (default 0)\n",
+         prog);
+}
+
+/* =========================== Main =========================== */
+
+int main(int argc, char **argv) {
+  int        opt;
+  pthread_t  thIsr, thMain;
+  ExchCheck  cIsr = { 0 }, cMain = { 0 };
+
+  while ((opt = getopt(argc, argv, "n:p:")) != -1) {
+    switch (opt) {
+      case 'n': nPub  = (uint32_t)atoi(optarg); break;
+      case 'p': nPause = (uint32_t)atoi(optarg); break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  // Valid initial snapshots, as after the first publish on the board
+  ExchState    st0;
+  ExchSetpoint sp0;
+  exch_makeState(&st0, 0);
+  exch_makeSetpoint(&sp0, 0);
+  Exch_Publish(&exchState, &st0);
+  Exch_Publish(&exchSetpoint, &sp0);
+  memcpy((void *)&plainState, &st0, sizeof(st0));
+  memcpy((void *)&plainSetpoint, &sp0, sizeof(sp0));
+
+  pthread_create(&thMain, NULL, exch_main, &cMain);
+  pthread_create(&thIsr,  NULL, exch_isr,  &cIsr);
+  pthread_join(thIsr,  NULL);
+  pthread_join(thMain, NULL);
+
+  exch_report("isr",  "setpoint", &cIsr);
+  exch_report("main", "state",    &cMain);
+  printf("cost: publish %.0f ns, read %.0f ns (host, including the clock reads)\n",
+         1e9 * (cIsr.tPub + cMain.tPub) / (nPub + cMain.reads),
+         1e9 * (cIsr.tRead + cMain.tRead) / (cIsr.reads + cMain.reads));
+
+  return (cIsr.torn || cMain.torn || cMain.stale) ? 2 : 0;
+}
@@ -0,0 +1,151 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * NOR flash model behind HAL_FLASH_Program / HAL_FLASHEx_Erase for the host build of eeprom.c,
+ * with program / erase rules, wear counters and power cuts, see flash_host.h.
+ * Only the two EEPROM emulation pages exist; an access anywhere else is a bug in eeprom.c and
+ * stops the program.
+ */
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stm32f1xx_hal.h"
+#include "eeprom.h"
+#include "flash_host.h"
+
+/* =========================== Variable Definitions =========================== */
+
+static uint16_t       flashMem[FLASH_HOST_PAGES][PAGE_SIZE / 2];
+static FlashHostStat  flashStat;
+static uint64_t       flashOps;         // [-] program and erase operations
+static uint64_t       flashCutAt;       // [-] operation interrupted by the power cut, 0 = none
+static jmp_buf       *flashCutEnv;
+
+/* =========================== Helpers =========================== */
+
+static uint16_t *flash_cell(uint32_t Address, const char *op) {
+  uint32_t page;
+
+  if (Address - PAGE0_BASE_ADDRESS < PAGE_SIZE) {
+    page = 0;
+  } else if (Address - PAGE1_BASE_ADDRESS < PAGE_SIZE) {
+    page = 1;
+  } else {
+    fprintf(stderr, "flash: %s outside the EEPROM pages at 0x%08lX\n", op, (unsigned long)Address);
+    abort();
+  }
+  if (Address & 1U) {
+    fprintf(stderr, "flash: unaligned %s at 0x%08lX\n", op, (unsigned long)Address);
+    abort();
+  }
+  return &flashMem[page][(Address - (page ? PAGE1_BASE_ADDRESS : PAGE0_BASE_ADDRESS)) / 2];
+}
+
+// Counts the operation, true if the power is cut during it
+static int flash_cut(void) {
+  flashOps++;
+  if (flashCutAt && flashOps == flashCutAt) {
+    flashCutAt = 0;
+    return 1;
+  }
+  return 0;
+}
+
+static uint16_t flash_rand16(void) {
+  return (uint16_t)(rand() ^ (rand() << 8));
+}
+
+/* =========================== Model =========================== */
+
+void FlashHost_Erase(void) {
+  memset(flashMem, 0xFF, sizeof(flashMem));
+  FlashHost_ClearStat();
+}
+
+void FlashHost_Stat(FlashHostStat *out) {
+  *out = flashStat;
+}
+
+void FlashHost_ClearStat(void) {
+  memset(&flashStat, 0, sizeof(flashStat));
+}
+
+uint64_t FlashHost_Ops(void) {
+  return flashOps;
+}
+
+void FlashHost_ArmCut(uint64_t n, jmp_buf *env) {
+  flashCutAt  = n ? flashOps + n : 0;
+  flashCutEnv = env;
+}
+
+uint16_t EE_HostRead16(uint32_t Address) {
+  flashStat.reads++;
+  return *flash_cell(Address, "read");
+}
+
+/* =========================== HAL =========================== */
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void) { return HAL_OK; }
+HAL_StatusTypeDef HAL_FLASH_Lock(void)   { return HAL_OK; }
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data) {
+  uint16_t *cell = flash_cell(Address, "program");
+  uint16_t  data = (uint16_t)Data;
+
+  if (TypeProgram != FLASH_TYPEPROGRAM_HALFWORD) {
+    return HAL_ERROR;
+  }
+  if (*cell != 0xFFFF && data != 0x0000) {      // PGERR: only erased half-words, or zero
+    flashStat.pgErr++;
+    return HAL_ERROR;
+  }
+  flashStat.programs++;
+  flashStat.busyNs += FLASH_HOST_PROG_NS;
+  if (flash_cut()) {
+    *cell &= (uint16_t)~(~data & flash_rand16());    // some of the bits to clear are cleared
+    longjmp(*flashCutEnv, 1);
+  }
+  *cell &= data;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError) {
+  uint16_t *cell = flash_cell(pEraseInit->PageAddress, "erase");
+  uint32_t  page = (pEraseInit->PageAddress == PAGE1_BASE_ADDRESS);
+
+  if (pEraseInit->NbPages != 1 || cell != flashMem[page]) {
+    *PageError = pEraseInit->PageAddress;
+    return HAL_ERROR;
+  }
+  flashStat.erases[page]++;
+  flashStat.busyNs += FLASH_HOST_ERASE_NS;
+  if (flash_cut()) {
+    for (uint32_t i = 0; i < PAGE_SIZE / 2; i++) {
+      if (rand() & 1) {
+        flashMem[page][i] = 0xFFFF;
+      }
+    }
+    longjmp(*flashCutEnv, 1);
+  }
+  memset(flashMem[page], 0xFF, sizeof(flashMem[page]));
+  *PageError = 0xFFFFFFFFU;
+  return HAL_OK;
+}
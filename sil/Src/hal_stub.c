@@ -0,0 +1,192 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Includes
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "stm32f1xx_hal.h"
+#include "defines.h"
+#include "config.h"
+#include "eeprom.h"
+#include "profiler.h"
+
+/* =========================== Peripherals =========================== */
+GPIO_TypeDef  sil_GPIOA, sil_GPIOB, sil_GPIOC;
+TIM_TypeDef   sil_TIM1, sil_TIM8;
+USART_TypeDef sil_USART2, sil_USART3;
+DMA_TypeDef   sil_DMA1;
+
+static DMA_Channel_TypeDef sil_DMA1_Channel6;  // USART2 Rx
+static DMA_Channel_TypeDef sil_DMA1_Channel3;  // USART3 Rx
+static DMA_HandleTypeDef   hdma_usart2_rx = { &sil_DMA1_Channel6 };
+static DMA_HandleTypeDef   hdma_usart3_rx = { &sil_DMA1_Channel3 };
+
+uint32_t SystemCoreClock = 64000000U;
+
+//------------------------------------------------------------------------
+// Firmware globals normally owned by main.c, bldc.c and setup.c
+//------------------------------------------------------------------------
+UART_HandleTypeDef huart2 = { USART2, NULL, &hdma_usart2_rx };
+UART_HandleTypeDef huart3 = { USART3, NULL, &hdma_usart3_rx };
+I2C_HandleTypeDef  hi2c2;
+
+volatile adc_buf_t adc_buffer;
+uint8_t  enable;
+int16_t  batVoltage = (400 * BAT_CELLS * BAT_CALIB_ADC) / BAT_CALIB_REAL_VOLTAGE;
+int16_t  dc_curr;
+volatile uint16_t ocTripCntL, ocTripCntR, ocTripPerL, ocTripPerR;
+uint8_t  buzzerFreq;
+uint8_t  buzzerPattern;
+uint8_t  buzzerCount;
+volatile uint32_t buzzerTimer;
+volatile uint32_t timeoutCntGen = TIMEOUT;
+volatile uint8_t  timeoutFlgGen;
+volatile uint32_t main_loop_counter;
+#if defined(ISR_DEGRADE_DIAG) && !defined(BLDC_MULTIRATE)
+uint8_t  bldcDiagDiv = 1;                       // no degraded mode on the host
+#endif
+
+void bldcOffsetLoad(const adc_offset_t *stored) { (void)stored; }
+uint8_t bldcOffsetGet(adc_offset_t *out) {
+  memset(out, 0, sizeof(*out));
+  return OFFSET_NONE;                           // no PWM interrupt on the host, nothing to save
+}
+
+int _printf_float;                              // satisfies asm(".global _printf_float") in defines.h
+
+// printf of the firmware sources (built with -Dprintf=sil_printf, see Makefile): the debug serial on the board,
+// stdout here. A host tool sets sil_printfMute to keep the firmware messages out of its own report.
+int sil_printfMute;
+
+int sil_printf(const char *format, ...) {
+  va_list ap;
+  int     n;
+
+  if (sil_printfMute) {
+    return 0;
+  }
+  va_start(ap, format);
+  n = vprintf(format, ap);
+  va_end(ap);
+  return n;
+}
+
+/* =========================== HAL =========================== */
+static uint32_t sil_tick;
+
+uint32_t HAL_GetTick(void) {
+  return sil_tick;
+}
+
+void HAL_Delay(uint32_t Delay) {
+  sil_tick += Delay;                            // time only advances, nothing to wait for on the host
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+  return (GPIOx->IDR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+  if (PinState != GPIO_PIN_RESET) {
+    GPIOx->ODR |= GPIO_Pin;
+  } else {
+    GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+  }
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+  GPIOx->ODR ^= GPIO_Pin;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+  (void)huart; (void)Timeout;
+  fwrite(pData, 1, Size, stdout);
+  return HAL_OK;
+}
+
+// Without a hook the transfer completes at once and the completion callback runs before the call returns.
+// A hook takes over the transfer and calls HAL_UART_TxCpltCallback() itself when the line is done.
+HAL_StatusTypeDef (*sil_uartTxHook)(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size) {
+  if (sil_uartTxHook != NULL) {
+    return sil_uartTxHook(huart, pData, Size);
+  }
+  HAL_UART_Transmit(huart, pData, Size, 0);
+  HAL_UART_TxCpltCallback(huart);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size) {
+  huart->pRxBuffPtr = pData;
+  huart->RxXferSize = Size;
+  huart->hdmarx->Instance->CNDTR = Size;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void) { return HAL_OK; }
+HAL_StatusTypeDef HAL_FLASH_Lock(void)   { return HAL_OK; }
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data) {
+  (void)TypeProgram; (void)Address; (void)Data;
+  return HAL_ERROR;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError) {
+  (void)pEraseInit; (void)PageError;
+  return HAL_ERROR;
+}
+
+/* =========================== Profiler time base =========================== */
+// Host monotonic clock expressed in SystemCoreClock cycles, replaces DWT->CYCCNT.
+// A hook replaces the clock, e.g. by scripted cycle counts (sil/Src/prof_host.c).
+uint32_t (*sil_profCyclesHook)(void);
+
+uint32_t Prof_HostCycles(void) {
+  struct timespec ts;
+  if (sil_profCyclesHook != NULL) {
+    return sil_profCyclesHook();
+  }
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec) * (SystemCoreClock / 1000000U) / 1000U);
+}
+
+/* =========================== Setup / EEPROM =========================== */
+void UART2_Init(void) { }
+void UART3_Init(void) { }
+
+uint16_t EE_Init(void) {
+  return HAL_OK;
+}
+
+uint16_t EE_ReadVariable(uint16_t VirtAddress, uint16_t *Data) {
+  (void)VirtAddress; (void)Data;
+  return 1;                                     // variable not found, callers keep their defaults
+}
+
+uint16_t EE_WriteVariable(uint16_t VirtAddress, uint16_t Data) {
+  (void)VirtAddress; (void)Data;
+  return HAL_OK;
+}
+
+void EE_WriteBegin(void) { }
+
+uint16_t EE_WriteCommit(void) {
+  return HAL_OK;
+}
@@ -0,0 +1,129 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Surface PMSM hub motor driven by an ideal three-phase inverter, modelled in the
+ * stationary alpha/beta frame (amplitude invariant Clarke), plus a rigid wheel.
+ * The inverter applies the period-averaged phase voltages; dead time and switching
+ * ripple are not modelled.
+ */
+
+// Includes
+#include <math.h>
+#include "plant.h"
+
+#define TWO_PI   (2.0 * M_PI)
+#define SQRT3    (1.7320508075688772)
+
+// Hall code {A,B,C} for each 60 deg sector, in the order the controller expects (see vec_hallToPos)
+static const uint8_t hallSeq[6] = { 2, 3, 1, 5, 4, 6 };
+
+/* =========================== Functions =========================== */
+
+void Plant_Init(Plant *p) {
+  // Typical 6.5" hoverboard hub motor on a 10s battery
+  p->Rs         = 0.16;
+  p->Ls         = 0.35e-3;
+  p->psi        = 0.0235;
+  p->polePairs  = 15;
+  p->J          = 0.012;
+  p->bVisc      = 0.002;
+  p->tCoul      = 0.10;
+  p->tLoad      = 0.0;
+  p->Vdc        = 36.0;
+  p->aHallOfs   = M_PI / 6.0;             // first hall edge 30 deg after the d-axis, matches r_sin_M1_Table
+
+  p->iAlpha     = 0.0;
+  p->iBeta      = 0.0;
+  p->wMech      = 0.0;
+  p->aElec      = 0.0;
+  p->iPha[0]    = p->iPha[1] = p->iPha[2] = 0.0;
+  p->iDC        = 0.0;
+  p->tElec      = 0.0;
+}
+
+/*
+ * Advance the plant by dt seconds, holding the inverter duty cycles constant.
+ * Inputs:       duty[3] = high side on-time ratio of phase A, B, C in [0, 1]
+ * Parameters:   nSub    = number of explicit Euler sub-steps
+ */
+void Plant_Step(Plant *p, const double duty[3], double dt, int nSub) {
+  double h      = dt / nSub;
+  double dMean  = (duty[0] + duty[1] + duty[2]) / 3.0;
+  double vA     = p->Vdc * (duty[0] - dMean);
+  double vB     = p->Vdc * (duty[1] - dMean);
+  double vC     = p->Vdc * (duty[2] - dMean);
+  double vAlpha = vA;
+  double vBeta  = (vB - vC) / SQRT3;
+
+  for (int k = 0; k < nSub; k++) {
+    double wElec  = p->wMech * p->polePairs;
+    double sinE   = sin(p->aElec);
+    double cosE   = cos(p->aElec);
+    double eAlpha = -wElec * p->psi * sinE;
+    double eBeta  =  wElec * p->psi * cosE;
+    double iq     =  p->iBeta * cosE - p->iAlpha * sinE;
+    double tFric  =  p->bVisc * p->wMech;
+
+    if (p->wMech > 1e-3) {
+      tFric += p->tCoul;
+    } else if (p->wMech < -1e-3) {
+      tFric -= p->tCoul;
+    }
+
+    p->tElec   = 1.5 * p->polePairs * p->psi * iq;
+    p->iAlpha += h * (vAlpha - p->Rs * p->iAlpha - eAlpha) / p->Ls;
+    p->iBeta  += h * (vBeta  - p->Rs * p->iBeta  - eBeta ) / p->Ls;
+
+    // Coulomb friction holds the wheel while the driving torque is below it
+    double tNet = p->tElec - p->tLoad - tFric;
+    if (fabs(p->wMech) <= 1e-3 && fabs(p->tElec - p->tLoad) <= p->tCoul) {
+      tNet = 0.0;
+      p->wMech = 0.0;
+    }
+    p->wMech  += h * tNet / p->J;
+    p->aElec  += h * p->wMech * p->polePairs;
+    p->aElec   = fmod(p->aElec, TWO_PI);
+    if (p->aElec < 0.0) {
+      p->aElec += TWO_PI;
+    }
+  }
+
+  p->iPha[0] = p->iAlpha;
+  p->iPha[1] = -0.5 * p->iAlpha + 0.5 * SQRT3 * p->iBeta;
+  p->iPha[2] = -0.5 * p->iAlpha - 0.5 * SQRT3 * p->iBeta;
+  p->iDC     = duty[0] * p->iPha[0] + duty[1] * p->iPha[1] + duty[2] * p->iPha[2];
+}
+
+/*
+ * Hall sensor code as read by the firmware: (hallA << 2) | (hallB << 1) | hallC
+ */
+uint8_t Plant_Hall(const Plant *p) {
+  double a = fmod(p->aElec - p->aHallOfs, TWO_PI);
+  if (a < 0.0) {
+    a += TWO_PI;
+  }
+  int sector = (int)(a / (TWO_PI / 6.0));
+  if (sector > 5) {
+    sector = 5;
+  }
+  return hallSeq[sector];
+}
+
+double Plant_Rpm(const Plant *p) {
+  return p->wMech * 60.0 / TWO_PI;
+}
@@ -0,0 +1,126 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Host check of the profiler statistics (Src/profiler.c). The profiler clock is
+ * replaced by scripted cycle counts (sil_profCyclesHook in hal_stub.c), so known
+ * execution times go through PROF_START() / PROF_STOP() and Prof_Record(). Checked:
+ * count, min, max, sum / average and the histogram bins incl. the overflow bin, a
+ * section time across the wrap of the 32-bit counter, independent sections and the
+ * window restart by Prof_Reset() and Prof_PrintNext(). Prints PASS or FAIL, exit code 2 = FAIL.
+ * Usage: 'build/sil/hover_prof'.
+ */
+
+// Includes
+#include <stdio.h>
+#include <stdint.h>
+#include "stm32f1xx_hal.h"
+#include "config.h"
+#include "profiler.h"
+
+/* =========================== Variable Definitions =========================== */
+
+static uint32_t clockSeq[2];            // [cycles] the next two readings of the profiler clock
+static uint8_t  clockIdx;
+static uint32_t nFail;
+
+/* =========================== Helpers =========================== */
+
+static uint32_t prof_clock(void) {
+  return clockSeq[clockIdx++ & 1];
+}
+
+// One section execution of cyc cycles, started at the clock reading t0
+static void prof_sample(ProfSection s, uint32_t t0, uint32_t cyc) {
+  clockSeq[0] = t0;
+  clockSeq[1] = t0 + cyc;
+  clockIdx    = 0;
+  PROF_START(s);
+  PROF_STOP(s);
+}
+
+static void prof_check(const char *what, uint64_t got, uint64_t expect) {
+  if (got != expect) {
+    printf("%-24s %llu, expected %llu\n", what, (unsigned long long)got, (unsigned long long)expect);
+    nFail++;
+  }
+}
+
+/* =========================== Main =========================== */
+
+int main(void) {
+  const uint32_t bin = PROF_BIN_CYC;
+  const uint32_t cyc[] = { 0, bin - 1, bin, bin + 50, 4 * bin, PROF_BUDGET_CYC - 1, 25 * PROF_BUDGET_CYC };
+  const uint32_t n     = sizeof(cyc) / sizeof(cyc[0]);
+  uint32_t       hist[PROF_HIST_BINS] = { 0 };
+  uint64_t       sum = 0;
+  ProfStat       st;
+  char           name[24];
+
+  sil_profCyclesHook = prof_clock;
+  Prof_Init();
+
+  for (uint32_t i = 0; i < n; i++) {
+    uint32_t t0 = (i == 3) ? UINT32_MAX - 20 : 1000 * i;     // one execution across the counter wrap
+    prof_sample(PROF_LEFT, t0, cyc[i]);
+    sum += cyc[i];
+  }
+  hist[0] = 2;                          // 0, bin - 1
+  hist[1] = 2;                          // bin, bin + 50
+  hist[4] = 1;
+  hist[(PROF_BUDGET_CYC - 1) / bin] += 1;
+  hist[PROF_HIST_BINS - 1] += 1;        // above the budget: last bin
+  prof_sample(PROF_RIGHT, 0, 3 * bin);
+
+  Prof_Snapshot(PROF_LEFT, &st);
+  prof_check("left cnt", st.cnt, n);
+  prof_check("left min", st.min, 0);
+  prof_check("left max", st.max, 25 * PROF_BUDGET_CYC);
+  prof_check("left sum", st.sum, sum);
+  prof_check("left avg", st.sum / st.cnt, sum / n);
+  for (int k = 0; k < PROF_HIST_BINS; k++) {
+    snprintf(name, sizeof(name), "left hist[%d]", k);
+    prof_check(name, st.hist[k], hist[k]);
+  }
+
+  Prof_Snapshot(PROF_RIGHT, &st);       // sections are independent
+  prof_check("right cnt", st.cnt, 1);
+  prof_check("right min", st.min, 3 * bin);
+  prof_check("right max", st.max, 3 * bin);
+  prof_check("right hist[3]", st.hist[3], 1);
+
+  Prof_Snapshot(PROF_ISR, &st);         // untouched section: empty window
+  prof_check("isr cnt", st.cnt, 0);
+  prof_check("isr min", st.min, UINT32_MAX);
+
+  prof_sample(PROF_ISR, 0, 7);
+  Prof_PrintNext();                     // prints the "isr" section and restarts its window
+  Prof_Snapshot(PROF_ISR, &st);
+  prof_check("isr cnt after print", st.cnt, 0);
+  prof_check("isr min after print", st.min, UINT32_MAX);
+  Prof_Snapshot(PROF_LEFT, &st);
+  prof_check("left cnt after print", st.cnt, n);
+
+  Prof_Reset();
+  Prof_Snapshot(PROF_LEFT, &st);
+  prof_check("left cnt after reset", st.cnt, 0);
+  prof_check("left sum after reset", st.sum, 0);
+  prof_check("left hist[0] after reset", st.hist[0], 0);
+
+  printf("%s\n", nFail ? "FAIL" : "PASS");
+  return nFail ? 2 : 0;
+}
@@ -0,0 +1,275 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Host side of the register map (Src/regmap.c).
+ *  - Encoder:  'hover_reg -w iqKp=1300,nKi=200 -r nL,iqL > request.bin' writes the
+ *              request frames, to be sent to USART3.
+ *  - Decoder:  'hover_reg -d < capture.bin' prints the response frames found in a
+ *              USART3 capture (responses interleaved with debug text and telemetry).
+ *  - Loopback: 'hover_reg -l -w ... -r ...' runs the requests through the firmware
+ *              Reg_Command() and prints its responses, no board needed.
+ * Usage: see usage() or run 'build/sil/hover_reg -?'.
+ */
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "stm32f1xx_hal.h"
+#include "defines.h"
+#include "config.h"
+#include "util.h"
+#include "logger.h"
+#include "regmap.h"
+
+/* =========================== Variable Definitions =========================== */
+
+typedef struct {
+  uint8_t   op;
+  uint8_t   n;
+  uint8_t   id[REG_BATCH_MAX];
+  uint16_t  value[REG_BATCH_MAX];
+} RegRequest;
+
+static const char *const statusName[] = { "ok", "unknown register", "read only", "out of range", "bad operation",
+                                          "busy, motors enabled", "EEPROM error" };
+
+static uint8_t loopBuf[4096];                   // USART3 output of the firmware in loopback mode
+static size_t  loopLen;
+
+/* =========================== Frames =========================== */
+
+static int reg_find(const char *name) {
+  char *end;
+  long  id = strtol(name, &end, 0);
+
+  if (*end == '\0' && end != name) {
+    return (id >= 0 && id < REGS) ? (int)id : -1;
+  }
+  for (int i = 0; i < REGS; i++) {
+    if (strcmp(name, regName[i]) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Parameters up to cf_currFilt are unsigned, everything else is int16 (or fits in it)
+static int32_t reg_signed(uint8_t id, uint16_t value) {
+  return (id > REG_CURR_FILT) ? (int16_t)value : value;
+}
+
+/*
+ * Parse "a,b,c" (read) or "a=1,b=-2" (write) into a request. Returns 0 on a syntax error.
+ */
+static int reg_parse(RegRequest *req, uint8_t op, char *list) {
+  req->op = op;
+  req->n  = 0;
+  for (char *tok = strtok(list, ","); tok != NULL; tok = strtok(NULL, ",")) {
+    char *eq = strchr(tok, '=');
+    int   id;
+    if (req->n >= REG_BATCH_MAX || (op == REG_OP_WRITE) != (eq != NULL)) {
+      return 0;
+    }
+    if (eq != NULL) {
+      *eq = '\0';
+      req->value[req->n] = (uint16_t)strtol(eq + 1, NULL, 0);
+    }
+    if ((id = reg_find(tok)) < 0) {
+      fprintf(stderr, "unknown register '%s'\n", tok);
+      return 0;
+    }
+    req->id[req->n++] = (uint8_t)id;
+  }
+  return 1;
+}
+
+static uint16_t reg_encode(const RegRequest *req, uint8_t *buf) {
+  uint16_t len = 0, crc;
+
+  buf[len++] = (uint8_t)REG_START_FRAME;
+  buf[len++] = (uint8_t)(REG_START_FRAME >> 8);
+  buf[len++] = req->op;
+  buf[len++] = req->n;
+  for (int k = 0; k < req->n; k++) {
+    buf[len++] = req->id[k];
+    if ((req->op & ~REG_OP_SAVE) == REG_OP_WRITE) {
+      buf[len++] = (uint8_t)req->value[k];
+      buf[len++] = (uint8_t)(req->value[k] >> 8);
+    }
+  }
+  crc        = calcCRC16(0xFFFF, buf, len);
+  buf[len++] = (uint8_t)crc;
+  buf[len++] = (uint8_t)(crc >> 8);
+  return len;
+}
+
+static void reg_print(const uint8_t *f) {
+  uint8_t op = f[2], n = f[3], status = f[4], index = f[5];
+
+  printf("%s%s", (op & ~REG_OP_SAVE) == REG_OP_WRITE ? "write" : "read", (op & REG_OP_SAVE) ? "+save" : "");
+  if (status != REG_OK) {
+    printf(" error: %s, item %u of %u\n", status < ARRAY_LEN(statusName) ? statusName[status] : "?", index, n);
+    return;
+  }
+  printf(" ok:");
+  for (int k = 0; k < n; k++) {
+    const uint8_t *it = &f[REG_RESP_HDR_SIZE + k * REG_ITEM_SIZE];
+    uint16_t       v  = (uint16_t)(it[1] | (it[2] << 8));
+    printf(" %s=%ld", it[0] < REGS ? regName[it[0]] : "?", (long)reg_signed(it[0], v));
+  }
+  printf("\n");
+}
+
+/*
+ * Print the response frames in a byte stream. Returns the number of valid responses.
+ */
+static int reg_decode(const uint8_t *buf, size_t len, uint32_t *crcErrors) {
+  int frames = 0;
+
+  for (size_t i = 0; i + REG_RESP_HDR_SIZE + 2 <= len; i++) {
+    if (buf[i] != (uint8_t)REG_RESP_FRAME || buf[i + 1] != (uint8_t)(REG_RESP_FRAME >> 8) || buf[i + 3] > REG_BATCH_MAX) {
+      continue;
+    }
+    size_t   flen = REG_RESP_HDR_SIZE + (buf[i + 4] == REG_OK ? buf[i + 3] * REG_ITEM_SIZE : 0) + 2;
+    uint16_t crc;
+    if (i + flen > len) {
+      break;
+    }
+    memcpy(&crc, &buf[i + flen - 2], 2);
+    if (crc != calcCRC16(0xFFFF, &buf[i], (uint32_t)(flen - 2))) {
+      (*crcErrors)++;
+      continue;
+    }
+    reg_print(&buf[i]);
+    frames++;
+    i += flen - 1;
+  }
+  return frames;
+}
+
+/* =========================== Loopback =========================== */
+
+static HAL_StatusTypeDef reg_uartCapture(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size) {
+  if (loopLen + Size <= sizeof(loopBuf)) {
+    memcpy(&loopBuf[loopLen], pData, Size);
+    loopLen += Size;
+  }
+  HAL_UART_TxCpltCallback(huart);
+  return HAL_OK;
+}
+
+static void reg_loopback(const uint8_t *frame, uint16_t len) {
+  uint32_t crcErrors = 0;
+
+  loopLen = 0;
+  Reg_Command(frame, len);
+  if (reg_decode(loopBuf, loopLen, &crcErrors) == 0) {
+    printf("no response%s\n", crcErrors ? " (CRC error)" : "");
+  }
+}
+
+/* =========================== Main =========================== */
+
+static void usage(const char *prog) {
+  printf("Usage: %s [-w list] [-s] [-r list] > request.bin\n"
+         "       %s -d < capture.bin\n"
+         "       %s -l [-w list] [-s] [-r list]\n"
+         "  -w <reg=val,...> write request, up to %d registers\n"
+         "  -s               save the parameters to EEPROM after the write (alone: save only)\n"
+         "  -r <reg,...>     read request, up to %d registers\n"
+         "  -d               decode the responses in a USART3 capture on stdin\n"
+         "  -l               loopback: run the requests through the firmware and print the responses\n"
+         "  -L               list the registers\n"
+         "Registers by name or id:",
+         prog, prog, prog, REG_BATCH_MAX, REG_BATCH_MAX);
+  for (int i = 0; i < REGS; i++) {
+    printf(" %s", regName[i]);
+  }
+  printf("\n");
+}
+
+int main(int argc, char **argv) {
+  RegRequest req[2];
+  uint8_t    frame[REG_HDR_SIZE + REG_BATCH_MAX * REG_ITEM_SIZE + 2];
+  int        opt, nReq = 0, save = 0, loop = 0, decode = 0;
+  char      *wr = NULL, *rd = NULL;
+
+  while ((opt = getopt(argc, argv, "w:sr:dlL")) != -1) {
+    switch (opt) {
+      case 'w': wr     = optarg; break;
+      case 's': save   = 1;      break;
+      case 'r': rd     = optarg; break;
+      case 'd': decode = 1;      break;
+      case 'l': loop   = 1;      break;
+      case 'L':
+        for (int i = 0; i < REGS; i++) {
+          printf("%2d %-10s %s\n", i, regName[i], i < REG_PARAMS ? "rw" : "ro");
+        }
+        return 0;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if (decode) {
+    static uint8_t buf[1 << 20];
+    size_t         len = fread(buf, 1, sizeof(buf), stdin);
+    uint32_t       crcErrors = 0;
+    int            frames = reg_decode(buf, len, &crcErrors);
+    fprintf(stderr, "%d responses, %u CRC errors\n", frames, crcErrors);
+    return 0;
+  }
+
+  if (wr != NULL || save) {
+    RegRequest *r = &req[nReq++];
+    if (wr == NULL) {
+      r->op = REG_OP_WRITE;
+      r->n  = 0;
+    } else if (!reg_parse(r, REG_OP_WRITE, wr)) {
+      usage(argv[0]);
+      return 1;
+    }
+    r->op |= save ? REG_OP_SAVE : 0;
+  }
+  if (rd != NULL && !reg_parse(&req[nReq++], REG_OP_READ, rd)) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (nReq == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if (loop) {
+    sil_uartTxHook = reg_uartCapture;
+    Log_Init();
+    BLDC_Init();
+  }
+  for (int k = 0; k < nReq; k++) {
+    uint16_t len = reg_encode(&req[k], frame);
+    if (loop) {
+      reg_loopback(frame, len);
+    } else {
+      fwrite(frame, 1, len, stdout);
+    }
+  }
+  return 0;
+}
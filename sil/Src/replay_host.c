@@ -0,0 +1,441 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Recorded test vectors for BLDC_controller_step().
+ * -w runs both controllers closed loop against the plant model (sil/Src/plant.c) through
+ * a fixed scenario: all control modes, both directions, load, disable / re-enable, OPEN
+ * mode while spinning and a hall sensor fault. Every step's inputs (ExtU) and outputs
+ * (ExtY) are written to a file.
+ * -r replays the inputs open loop through the controller this binary is linked with and
+ * compares every output field with the recording, then times the replay.
+ * The Makefile links the tool twice: hover_replay with the generic step and
+ * hover_replay_spec with the BLDC_SPECIALISE step, so
+ *   build/sil/hover_replay -w vec.bin && build/sil/hover_replay_spec -r vec.bin
+ * proves the specialised step bit-exact against the generic one on the same vectors.
+ * The replay runs two BLDC_controller_step() calls per period as in the ISR.
+ * -r with -s replays single rate vectors through the multi-rate step (BLDC_MULTIRATE) and
+ * checks it against them within the REPLAY_TOL_* tolerances: the fast outputs bit-exact, the
+ * duty cycles close, every error code change within the hand-off delay. Exit code 2 = FAIL.
+ *   build/sil/hover_replay -w vec.bin && build/sil/hover_replay -r vec.bin -s 4
+ * -w with -s records through the multi-rate step instead, to check the closed loop and the
+ * error detection with the slow tasks deferred. Such a recording does not replay bit-exact.
+ * Usage: see usage() or run 'build/sil/hover_replay -?'.
+ */
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "stm32f1xx_hal.h"
+#include "defines.h"
+#include "config.h"
+#include "util.h"
+#include "BLDC_controller.h"
+#include "BLDC_controller_mr.h"
+#include "rtwtypes.h"
+#include "plant.h"
+
+/* =========================== Variable Definitions =========================== */
+
+extern RT_MODEL *const rtM_Left;
+extern RT_MODEL *const rtM_Right;
+
+extern P    rtP_Left;
+extern P    rtP_Right;
+extern DW   rtDW_Left;
+extern DW   rtDW_Right;
+extern ExtU rtU_Left;
+extern ExtU rtU_Right;
+extern ExtY rtY_Left;
+extern ExtY rtY_Right;
+
+#define REPLAY_MAGIC        0x31434556U       // "VEC1"
+#define REPLAY_PHASE_STEPS  (CTRL_FREQ * 4 / 10) // [control periods] 0.4 s per scenario phase
+
+// Tolerances of the multi-rate replay (-r with -s) against single rate vectors. The fast partition
+// has to match exactly. The slow results reach it up to 3 * div control periods later and the speed
+// PI runs every 3 * div periods, so the duty cycles deviate, most at the control mode changes.
+// Met for div 1 .. 4 by the recorded scenario, div 8 exceeds them.
+#define REPLAY_TOL_DC         50        // [-] DC_phaX deviation counted as large, 5 % of the +-1000 range
+#define REPLAY_TOL_DC_RMS     20        // [-] RMS deviation of DC_phaX over all steps, 2 % of the range
+#define REPLAY_TOL_DC_OVER    1         // [%] motor steps with a DC_phaX deviation over REPLAY_TOL_DC
+#define REPLAY_TOL_ERR_LAT(div) (3 * (div) + 3) // [control periods] delay of an error code change
+
+typedef struct {
+  uint32_t  magic;
+  uint32_t  nSteps;                     // [-] PWM periods, two records (left, right) each
+  uint8_t   ctrlTyp;                    // settings of the recording build, must match the replay
+  uint8_t   fieldWeak;
+  uint8_t   diag;
+  uint8_t   specialised;                // 1 = recorded with BLDC_SPECIALISE
+} ReplayHdr;
+
+typedef struct {
+  ExtU      u;
+  ExtY      y;
+} ReplayRec;
+
+// Scenario: one phase per line, both motors get the same request (right mirrored)
+typedef struct {
+  uint8_t   ctrlMod;
+  int16_t   cmd;                        // [-1000, 1000]
+  uint8_t   ena;
+  double    tLoad;                      // [Nm]
+  uint8_t   hallFault;                  // 1 = left hall sensors read 0 (broken cable)
+} ReplayPhase;
+
+static const ReplayPhase phases[] = {
+  { VLT_MODE,    300, 1, 0.0, 0 },
+  { VLT_MODE,   -600, 1, 0.0, 0 },
+  { SPD_MODE,    800, 1, 0.0, 0 },
+  { SPD_MODE,   -400, 1, 1.0, 0 },
+  { TRQ_MODE,    600, 1, 2.0, 0 },
+  { TRQ_MODE,   -300, 1, 0.0, 0 },
+  { OPEN_MODE,   500, 1, 0.0, 0 },      // coast down from speed
+  { SPD_MODE,    500, 0, 0.0, 0 },      // disabled
+  { SPD_MODE,   1000, 1, 0.0, 0 },
+  { VLT_MODE,    500, 1, 0.0, 1 },      // hall fault -> diagnostics error
+};
+
+#ifdef BLDC_SPECIALISE
+static const char buildName[] = "specialised (BLDC_SPECIALISE)";
+#else
+static const char buildName[] = "generic";
+#endif
+
+/* =========================== Helpers =========================== */
+
+static double replay_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void replay_reset(void) {
+  memset(&rtDW_Left,  0, sizeof(rtDW_Left));
+  memset(&rtDW_Right, 0, sizeof(rtDW_Right));
+  memset(&rtY_Left,   0, sizeof(rtY_Left));
+  memset(&rtY_Right,  0, sizeof(rtY_Right));
+  BLDC_Init();
+}
+
+static int replay_sameY(const ExtY *a, const ExtY *b) {
+  return a->DC_phaA == b->DC_phaA && a->DC_phaB == b->DC_phaB && a->DC_phaC == b->DC_phaC &&
+         a->z_errCode == b->z_errCode && a->n_mot == b->n_mot && a->a_elecAngle == b->a_elecAngle &&
+         a->iq == b->iq && a->id == b->id;
+}
+
+// Controller inputs from the plant, as sil_main.c and bldc.c do
+static void replay_inputs(ExtU *u, const Plant *p, uint8_t selABC, const ReplayPhase *ph, int16_t cmd, uint8_t hallFault) {
+  uint8_t hall = hallFault ? 0 : Plant_Hall(p);
+
+  u->b_motEna     = ph->ena;
+  u->z_ctrlModReq = ph->ctrlMod;
+  u->r_inpTgt     = cmd;
+  u->b_hallA      = (hall >> 2) & 1;
+  u->b_hallB      = (hall >> 1) & 1;
+  u->b_hallC      = hall & 1;
+  u->i_phaAB      = (int16_t)lround(p->iPha[selABC ? 1 : 0] * A2BIT_CONV);
+  u->i_phaBC      = (int16_t)lround(p->iPha[selABC ? 2 : 1] * A2BIT_CONV);
+  u->i_DCLink     = (int16_t)lround(p->iDC * A2BIT_CONV);
+  u->a_mechAngle  = 0;
+}
+
+static void replay_duty(const ExtY *y, uint8_t ena, double duty[3]) {
+  const int16_t pwm_res = 64000000 / 2 / PWM_FREQ, pwm_margin = 110;   // same as bldc.c at 64 MHz
+  const int32_t pwm_scale = ((int32_t)pwm_res << 16) / BLDC_GEN_PWM_RES;
+  int16_t dc[3] = { y->DC_phaA, y->DC_phaB, y->DC_phaC };
+  for (int k = 0; k < 3; k++) {
+    duty[k] = ena ? (double)CLAMP(((dc[k] * pwm_scale) >> 16) + pwm_res / 2, pwm_margin, pwm_res - pwm_margin) / pwm_res : 0.5;
+  }
+}
+
+// One replay of all vectors from the initial state, returns the number of steps that differ (check) or 0
+static uint32_t replay_pass(const ReplayRec *rec, uint32_t nSteps, int check, uint32_t *first) {
+  uint32_t mismatch = 0;
+
+  replay_reset();
+  for (uint32_t k = 0; k < nSteps; k++) {
+    rtU_Left  = rec[2 * k].u;
+    rtU_Right = rec[2 * k + 1].u;
+    BLDC_controller_step(rtM_Left);
+    BLDC_controller_step(rtM_Right);
+    if (check && (!replay_sameY(&rtY_Left, &rec[2 * k].y) || !replay_sameY(&rtY_Right, &rec[2 * k + 1].y))) {
+      if (mismatch++ == 0) {
+        *first = k;
+      }
+    }
+  }
+  return mismatch;
+}
+
+// Deviation of a multi-rate replay from the recorded single rate outputs
+typedef struct {
+  uint32_t  fastDiff;                   // [steps] n_mot, a_elecAngle, iq or id differ
+  uint32_t  dcOver;                     // [motor steps] a DC_phaX deviates by more than REPLAY_TOL_DC
+  int32_t   dcPeak;                     // [-] largest DC_phaX deviation
+  double    dcSq;                       // sum of the squared DC_phaX deviations
+  int32_t   errLat;                     // [control periods] largest delay of an error code change, -1 = missed
+} ReplayDev;
+
+static void replay_dev(ReplayDev *d, const ExtY *y, const ExtY *ref) {
+  int32_t dc[3] = { y->DC_phaA - ref->DC_phaA, y->DC_phaB - ref->DC_phaB, y->DC_phaC - ref->DC_phaC };
+  int32_t peak = 0;
+
+  if (y->n_mot != ref->n_mot || y->a_elecAngle != ref->a_elecAngle || y->iq != ref->iq || y->id != ref->id) {
+    d->fastDiff++;
+  }
+  for (int k = 0; k < 3; k++) {
+    peak = MAX(peak, ABS(dc[k]));
+    d->dcSq += (double)dc[k] * dc[k];
+  }
+  d->dcPeak = MAX(d->dcPeak, peak);
+  d->dcOver += (peak > REPLAY_TOL_DC);
+}
+
+// Replay of all vectors through the multi-rate step, the slow partition tail-chained as PendSV
+static void replay_pass_mr(const ReplayRec *rec, uint32_t nSteps, uint8_t slowDiv, ReplayDev *dev) {
+  SlowPart slow[2];
+  uint32_t tRef[2] = { 0, 0 }, tErr[2] = { 0, 0 };
+  uint8_t  errRef[2] = { 0, 0 }, err[2] = { 0, 0 };
+  P        pL = rtP_Left, pR = rtP_Right;
+
+  replay_reset();
+  BLDC_SlowScale(slowDiv);
+  BLDC_controller_slow_init(rtM_Left,  &slow[0], slowDiv);
+  BLDC_controller_slow_init(rtM_Right, &slow[1], slowDiv);
+  memset(dev, 0, sizeof(*dev));
+  for (uint32_t k = 0; k < nSteps; k++) {
+    const ExtY *y[2] = { &rtY_Left, &rtY_Right };
+    rtU_Left  = rec[2 * k].u;
+    rtU_Right = rec[2 * k + 1].u;
+    BLDC_controller_step_fast(rtM_Left,  &slow[0]);
+    BLDC_controller_step_fast(rtM_Right, &slow[1]);
+    BLDC_controller_step_slow(rtM_Left,  &slow[0]);
+    BLDC_controller_step_slow(rtM_Right, &slow[1]);
+    for (int i = 0; i < 2; i++) {
+      const ExtY *ref = &rec[2 * k + i].y;
+      replay_dev(dev, y[i], ref);
+      // error codes: every change of the reference has to follow within the latency
+      if (ref->z_errCode != errRef[i]) {
+        errRef[i] = ref->z_errCode;
+        tRef[i]   = k;
+      }
+      if (y[i]->z_errCode != err[i]) {
+        err[i]  = y[i]->z_errCode;
+        tErr[i] = k;
+        if (err[i] == errRef[i]) {
+          dev->errLat = (dev->errLat < 0) ? -1 : MAX(dev->errLat, (int32_t)(tErr[i] - tRef[i]));
+        }
+      }
+    }
+  }
+  for (int i = 0; i < 2; i++) {
+    if (err[i] != errRef[i]) {
+      dev->errLat = -1;
+    }
+  }
+  rtP_Left  = pL;                       // undo BLDC_SlowScale()
+  rtP_Right = pR;
+}
+
+/* =========================== Record / Replay =========================== */
+
+static int replay_record(const char *path, uint8_t slowDiv) {
+  uint32_t   nSteps = (uint32_t)(ARRAY_LEN(phases) * REPLAY_PHASE_STEPS);
+  ReplayHdr  hdr = { REPLAY_MAGIC, nSteps, CTRL_TYP_SEL, FIELD_WEAK_ENA, DIAG_ENA, 0 };
+  Plant      plant[2];
+  double     duty[2][3] = { { 0.5, 0.5, 0.5 }, { 0.5, 0.5, 0.5 } };
+  FILE      *f = fopen(path, "wb");
+  uint8_t    errSeen = 0;
+  SlowPart   slow[2];
+
+  if (f == NULL) {
+    perror(path);
+    return 1;
+  }
+  #ifdef BLDC_SPECIALISE
+  hdr.specialised = 1;
+  #endif
+  fwrite(&hdr, sizeof(hdr), 1, f);
+
+  replay_reset();
+  if (slowDiv) {
+    BLDC_SlowScale(slowDiv);
+    BLDC_controller_slow_init(rtM_Left,  &slow[0], slowDiv);
+    BLDC_controller_slow_init(rtM_Right, &slow[1], slowDiv);
+  }
+  for (int i = 0; i < 2; i++) {
+    Plant_Init(&plant[i]);
+  }
+  for (uint32_t k = 0; k < nSteps; k++) {
+    const ReplayPhase *ph = &phases[k / REPLAY_PHASE_STEPS];
+    ReplayRec rec[2];
+
+    plant[0].tLoad =  ph->tLoad;
+    plant[1].tLoad = -ph->tLoad;                          // right wheel is mirrored
+    replay_inputs(&rtU_Left,  &plant[0], 0, ph,  ph->cmd, ph->hallFault);
+    replay_inputs(&rtU_Right, &plant[1], 1, ph, (int16_t)-ph->cmd, 0);
+    if (slowDiv) {
+      BLDC_controller_step_fast(rtM_Left,  &slow[0]);
+      BLDC_controller_step_fast(rtM_Right, &slow[1]);
+      BLDC_controller_step_slow(rtM_Left,  &slow[0]);    // PendSV, tail-chained
+      BLDC_controller_step_slow(rtM_Right, &slow[1]);
+    } else {
+      BLDC_controller_step(rtM_Left);
+      BLDC_controller_step(rtM_Right);
+    }
+
+    rec[0].u = rtU_Left;  rec[0].y = rtY_Left;
+    rec[1].u = rtU_Right; rec[1].y = rtY_Right;
+    fwrite(rec, sizeof(rec), 1, f);
+    errSeen |= rtY_Left.z_errCode | rtY_Right.z_errCode;
+
+    replay_duty(&rtY_Left,  ph->ena, duty[0]);
+    replay_duty(&rtY_Right, ph->ena, duty[1]);
+    for (int i = 0; i < 2; i++) {
+      Plant_Step(&plant[i], duty[i], 1.0 / CTRL_FREQ, 8);
+    }
+  }
+  fclose(f);
+  printf("recorded %u steps x 2 motors (%s %s step, %u phases, error codes seen 0x%02X) to %s\n",
+         nSteps, buildName, slowDiv ? "multi-rate" : "single rate", (unsigned)ARRAY_LEN(phases), errSeen, path);
+  return 0;
+}
+
+// Multi-rate step against single rate vectors: pass / fail by the REPLAY_TOL_* tolerances
+static int replay_check_mr(ReplayRec *rec, const ReplayHdr *hdr, const char *path, uint8_t slowDiv) {
+  ReplayDev dev;
+  double    dcRms;
+  int       pass;
+
+  replay_pass_mr(rec, hdr->nSteps, slowDiv, &dev);
+  free(rec);
+  dcRms = sqrt(dev.dcSq / (6.0 * hdr->nSteps));
+  pass  = dev.fastDiff == 0 && dcRms <= REPLAY_TOL_DC_RMS && dev.dcOver <= 2 * hdr->nSteps * REPLAY_TOL_DC_OVER / 100 &&
+          dev.errLat >= 0 && dev.errLat <= REPLAY_TOL_ERR_LAT(slowDiv);
+
+  printf("replay   : %s multi-rate step, slow tasks every %u scheduler periods, against %s vectors from %s\n",
+         buildName, slowDiv, hdr->specialised ? "specialised" : "generic", path);
+  printf("fast out : %u steps differ in n_mot, a_elecAngle, iq or id (tolerance 0)\n", dev.fastDiff);
+  printf("DC_phaX  : RMS deviation %.1f (tolerance %d), peak %d, %.2f %% of the motor steps over %d (tolerance %d %%)\n",
+         dcRms, REPLAY_TOL_DC_RMS, dev.dcPeak, 100.0 * dev.dcOver / (2.0 * hdr->nSteps), REPLAY_TOL_DC, REPLAY_TOL_DC_OVER);
+  if (dev.errLat < 0) {
+    printf("errCode  : an error code change of the vectors is missing\n");
+  } else {
+    printf("errCode  : all changes, latency up to %d control periods (tolerance %d)\n", dev.errLat, REPLAY_TOL_ERR_LAT(slowDiv));
+  }
+  printf("%s\n", pass ? "PASS" : "FAIL");
+  return pass ? 0 : 2;
+}
+
+static int replay_check(const char *path, int passes, uint8_t slowDiv) {
+  ReplayHdr  hdr;
+  ReplayRec *rec;
+  FILE      *f = fopen(path, "rb");
+  uint32_t   mismatch, first = 0;
+  double     tBest = 1e9;
+
+  if (f == NULL) {
+    perror(path);
+    return 1;
+  }
+  if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != REPLAY_MAGIC) {
+    fprintf(stderr, "%s: not a vector file\n", path);
+    fclose(f);
+    return 1;
+  }
+  if (hdr.ctrlTyp != CTRL_TYP_SEL || hdr.fieldWeak != FIELD_WEAK_ENA || hdr.diag != DIAG_ENA) {
+    fprintf(stderr, "%s: recorded with CTRL_TYP_SEL %u, FIELD_WEAK_ENA %u, DIAG_ENA %u, this build differs\n",
+            path, hdr.ctrlTyp, hdr.fieldWeak, hdr.diag);
+    fclose(f);
+    return 1;
+  }
+  rec = malloc(sizeof(ReplayRec) * 2 * hdr.nSteps);
+  if (rec == NULL || fread(rec, sizeof(ReplayRec) * 2, hdr.nSteps, f) != hdr.nSteps) {
+    fprintf(stderr, "%s: truncated\n", path);
+    fclose(f);
+    free(rec);
+    return 1;
+  }
+  fclose(f);
+
+  if (slowDiv) {
+    return replay_check_mr(rec, &hdr, path, slowDiv);
+  }
+
+  // Bit-exact check, every output field of every step
+  mismatch = replay_pass(rec, hdr.nSteps, 1, &first);
+
+  // Timing: best of several passes, one clock read pair per pass
+  for (int p = 0; p < passes; p++) {
+    double t0 = replay_now();
+    replay_pass(rec, hdr.nSteps, 0, NULL);
+    tBest = MIN(tBest, replay_now() - t0);
+  }
+  free(rec);
+
+  printf("replay   : %s step against %s vectors from %s\n", buildName, hdr.specialised ? "specialised" : "generic", path);
+  if (mismatch) {
+    printf("2 x step : %u of %u steps differ, first at step %u (%.4f s)", mismatch, hdr.nSteps, first, (double)first / CTRL_FREQ);
+  } else {
+    printf("2 x step : bit-exact, %u steps x 2 motors, all ExtY fields", hdr.nSteps);
+  }
+  printf(", %.1f ns per PWM period (host, best of %d passes)\n", 1e9 * tBest / hdr.nSteps, passes);
+  return mismatch ? 2 : 0;
+}
+
+static void usage(const char *prog) {
+  printf("Usage: %s -w <file> | -r <file> [options]\n"
+         "  -w <file>        run the scenario closed loop and record the vectors\n"
+         "  -r <file>        replay the vectors, compare the outputs bit by bit and time the controller\n"
+         "  -n <passes>      timing passes for -r (default 20)\n"
+         "  -s <div>         multi-rate step, slow tasks every <div> scheduler periods: -w records with it,\n"
+         "                   -r checks it against single rate vectors within the REPLAY_TOL_* tolerances\n",
+         prog);
+}
+
+/* =========================== Main =========================== */
+
+int main(int argc, char **argv) {
+  int         opt, passes = 20, slowDiv = 0;
+  const char *wPath = NULL, *rPath = NULL;
+
+  while ((opt = getopt(argc, argv, "w:r:n:s:")) != -1) {
+    switch (opt) {
+      case 'w': wPath  = optarg;       break;
+      case 'r': rPath  = optarg;       break;
+      case 'n': passes = atoi(optarg); break;
+      case 's': slowDiv = atoi(optarg); break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+  if (wPath == NULL && rPath == NULL) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (wPath && replay_record(wPath, (uint8_t)slowDiv)) {
+    return 1;
+  }
+  return rPath ? replay_check(rPath, MAX(passes, 1), (uint8_t)(wPath ? 0 : slowDiv)) : 0;
+}
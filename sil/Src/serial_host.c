@@ -0,0 +1,242 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Host benchmark of the USART2 command parser (usart2_rx_check in Src/util.c).
+ * A stream of SerialCommand frames is pushed byte by byte through a model of the
+ * circular Rx DMA buffer. The frames are coalesced and split by random line gaps (IDLE
+ * events) and hit by bit errors, inserted and lost bytes. The firmware parser sees the
+ * IDLE and half/full transfer events as on the board. For comparison the former
+ * "exactly one frame per IDLE event" check runs on the same events (legacy frames).
+ * With -v 2 the stream is made of protocol v2 frames (SerialCommandV2, CRC16).
+ * Usage: see usage() or run 'build/sil/hover_serial -?'.
+ */
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "stm32f1xx_hal.h"
+#include "defines.h"
+#include "config.h"
+#include "util.h"
+
+/* =========================== Variable Definitions =========================== */
+
+extern UART_HandleTypeDef huart2;
+extern InputStruct        input1[];
+extern InputStruct        input2[];
+extern SerialRxStats      rxStatsL;
+extern SerialCmdState     cmdStateL;
+
+typedef struct {
+  uint32_t  frames;                     // [-] frames sent
+  uint32_t  intact;                     // [-] frames sent without any error
+  uint64_t  bytes;                      // [bytes] on the line, including noise
+  uint32_t  idle, half;                 // [-] IDLE and half/full transfer events
+} SilLine;
+
+// Former parser: accepts only exactly sizeof(SerialCommand) bytes between two IDLE events
+typedef struct {
+  uint32_t  oldPos;
+  uint32_t  frames;
+} LegacyRx;
+
+static uint8_t legacyBuf[SERIAL_BUFFER_SIZE];   // same content as the firmware Rx buffer
+
+/* =========================== Helpers =========================== */
+
+static double serial_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int serial_chance(uint32_t ppm) {
+  return ppm && (uint32_t)(rand() % 1000000) < ppm;
+}
+
+static void legacy_rx_check(LegacyRx *l) {
+  SerialCommand cmd;
+  uint8_t      *ptr = (uint8_t *)&cmd;
+  uint32_t      len = ARRAY_LEN(legacyBuf);
+  uint32_t      pos = len - __HAL_DMA_GET_COUNTER(huart2.hdmarx);
+
+  if (pos != l->oldPos) {
+    if (pos > l->oldPos && (pos - l->oldPos) == sizeof(cmd)) {
+      memcpy(ptr, &legacyBuf[l->oldPos], sizeof(cmd));
+    } else if ((len - l->oldPos + pos) == sizeof(cmd)) {
+      memcpy(ptr, &legacyBuf[l->oldPos], len - l->oldPos);
+      memcpy(ptr + len - l->oldPos, &legacyBuf[0], pos);
+    } else {
+      ptr = NULL;
+    }
+    if (ptr != NULL && cmd.start == SERIAL_START_FRAME &&
+        cmd.checksum == (uint16_t)(cmd.start ^ cmd.steer ^ cmd.speed)) {
+      l->frames++;
+    }
+  }
+  l->oldPos = (pos == len) ? 0 : pos;
+}
+
+/* =========================== Line model =========================== */
+
+// One byte into the circular DMA buffer, with the half/full transfer events of the DMA
+static double tParse;
+
+static void serial_dmaByte(SilLine *ln, uint8_t b) {
+  uint32_t size = huart2.RxXferSize;
+  uint32_t pos  = size - huart2.hdmarx->Instance->CNDTR;
+  double   t0;
+
+  huart2.pRxBuffPtr[pos] = b;
+  legacyBuf[pos]         = b;
+  ln->bytes++;
+  if (--huart2.hdmarx->Instance->CNDTR == 0) {
+    huart2.hdmarx->Instance->CNDTR = size;              // circular mode reload, the full transfer event follows
+    ln->half++;
+    t0 = serial_now();
+    HAL_UART_RxCpltCallback(&huart2);
+    tParse += serial_now() - t0;
+  } else if (pos + 1 == size / 2) {
+    ln->half++;
+    t0 = serial_now();
+    HAL_UART_RxHalfCpltCallback(&huart2);
+    tParse += serial_now() - t0;
+  }
+}
+
+static void serial_idle(SilLine *ln, LegacyRx *l) {
+  double t0 = serial_now();
+  usart2_rx_check();
+  tParse += serial_now() - t0;
+  legacy_rx_check(l);
+  ln->idle++;
+}
+
+static void usage(const char *prog) {
+  printf("Usage: %s [options]\n"
+         "  -n <frames>      frames to send (default 200000)\n"
+         "  -e <ppm>         bit error probability per byte (default 0)\n"
+         "  -i <ppm>         inserted byte probability per byte (default 0)\n"
+         "  -d <ppm>         lost byte probability per byte (default 0)\n"
+         "  -g <%%>           probability of a line gap (IDLE) after a frame (default 50)\n"
+         "  -s <%%>           probability of a line gap inside a frame (default 5)\n"
+         "  -v <1|2>         protocol: 1 = legacy SerialCommand, 2 = SerialCommandV2 (default 1)\n"
+         "  -V               show the debug output of the firmware (input configuration at Input_Init)\n",
+         prog);
+}
+
+/* =========================== Main =========================== */
+
+int main(int argc, char **argv) {
+  int       opt, verbose = 0;
+  uint32_t  nFrames = 200000, pBit = 0, pIns = 0, pDel = 0, pGap = 50, pSplit = 5, ver = 1;
+  SilLine   ln = { 0 };
+  LegacyRx  legacy = { 0 };
+  uint32_t  wrongCmd = 0;
+  int16_t   steerPrev;
+
+  while ((opt = getopt(argc, argv, "n:e:i:d:g:s:v:V")) != -1) {
+    switch (opt) {
+      case 'n': nFrames = (uint32_t)atoi(optarg); break;
+      case 'e': pBit    = (uint32_t)atoi(optarg); break;
+      case 'i': pIns    = (uint32_t)atoi(optarg); break;
+      case 'd': pDel    = (uint32_t)atoi(optarg); break;
+      case 'g': pGap    = (uint32_t)atoi(optarg); break;
+      case 's': pSplit  = (uint32_t)atoi(optarg); break;
+      case 'v': ver     = (uint32_t)atoi(optarg); break;
+      case 'V': verbose = 1; break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+  srand(1);
+
+  sil_printfMute = !verbose;                            // Input_Init() reports the input configuration
+  Input_Init();                                         // starts the circular Rx DMA on rx_buffer_L
+  sil_printfMute = 0;
+  steerPrev = input1[0].raw;
+
+  for (uint32_t n = 0; n < nFrames; n++) {
+    SerialCommand   cmd;
+    SerialCommandV2 cmd2 = { 0 };
+    uint8_t        *p    = (uint8_t *)&cmd;
+    uint32_t        len  = sizeof(cmd);
+    int             intact = 1;
+
+    cmd.start    = SERIAL_START_FRAME;
+    cmd.steer    = (int16_t)n;
+    cmd.speed    = (int16_t)(n ^ 0x5A5A);               // pattern to recognise a corrupted frame that passed the checksum
+    cmd.checksum = (uint16_t)(cmd.start ^ cmd.steer ^ cmd.speed);
+    if (ver == 2) {
+      cmd2.start   = SERIAL_START_FRAME_V2;
+      cmd2.version = SERIAL_PROTOCOL_V2;
+      cmd2.ctrlMod = CTRL_MOD_REQ;
+      cmd2.seq     = (uint16_t)n;
+      cmd2.stamp   = (uint16_t)(n * 10);
+      cmd2.cmd1    = cmd.steer;
+      cmd2.cmd2    = cmd.speed;
+      cmd2.crc     = calcCRC16(0xFFFF, (const uint8_t *)&cmd2, sizeof(cmd2) - 2);
+      p            = (uint8_t *)&cmd2;
+      len          = sizeof(cmd2);
+    }
+
+    for (uint32_t i = 0; i < len; i++) {
+      uint8_t b = p[i];
+      if (serial_chance(pDel)) { intact = 0; continue; }
+      if (serial_chance(pBit)) { intact = 0; b ^= (uint8_t)(1U << (rand() % 8)); }
+      serial_dmaByte(&ln, b);
+      if (serial_chance(pIns)) { intact = 0; serial_dmaByte(&ln, (uint8_t)rand()); }
+      if (i + 1 < len && (uint32_t)(rand() % 100) < pSplit) {
+        serial_idle(&ln, &legacy);
+      }
+    }
+    ln.frames++;
+    ln.intact += intact;
+    if ((uint32_t)(rand() % 100) < pGap) {
+      serial_idle(&ln, &legacy);
+    }
+
+    readInputRaw();                                     // last accepted command
+    if (input1[0].raw != steerPrev) {
+      steerPrev = input1[0].raw;
+      wrongCmd += input2[0].raw != (int16_t)(input1[0].raw ^ 0x5A5A);
+    }
+  }
+  serial_idle(&ln, &legacy);
+
+  printf("line     : %u frames, %u intact, %llu bytes, %u IDLE events, %u half/full transfer events\n",
+         ln.frames, ln.intact, (unsigned long long)ln.bytes, ln.idle, ln.half);
+  printf("parser   : %u accepted (%.2f %% of intact), %u checksum errors, %u framing errors, %u bytes skipped, %u corrupted commands accepted\n",
+         rxStatsL.frames, 100.0 * rxStatsL.frames / (ln.intact ? ln.intact : 1),
+         rxStatsL.crcErr, rxStatsL.frameErr, rxStatsL.skipped, wrongCmd);
+  if (ver == 2) {
+    printf("protocol v2: %u sequence numbers missed (%u frames sent, %u accepted)\n",
+           cmdStateL.seqGaps, ln.frames, rxStatsL.frames);
+  } else {
+    printf("legacy   : %u accepted (%.2f %% of intact)\n",
+           legacy.frames, 100.0 * legacy.frames / (ln.intact ? ln.intact : 1));
+  }
+  printf("throughput: %.1f MB/s, %.0f ns per event (host)\n",
+         ln.bytes / tParse / 1e6, 1e9 * tParse / (ln.idle + ln.half));
+
+  return 0;
+}
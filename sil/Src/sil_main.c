@@ -0,0 +1,490 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Software-in-the-loop runner: the unmodified BLDC_controller_step() of both motors
+ * runs at CTRL_FREQ against two hub motor plant models (sil/Src/plant.c). The command
+ * path of the main loop (rateLimiter16, filtLowPass32, mixerFcn) runs every
+ * DELAY_IN_MAIN_LOOP ms, as in main.c, unless a raw step is requested.
+ *
+ * Reported: controller throughput on this host and closed-loop step response metrics,
+ * with -R the DC link ripple current for several PWM_PHASE_SHIFT settings.
+ * Usage: see usage() or run 'build/sil/hover_sil -?'.
+ */
+
+// Includes
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "stm32f1xx_hal.h"
+#include "defines.h"
+#include "config.h"
+#include "util.h"
+#include "BLDC_controller.h"
+#include "BLDC_controller_mr.h"
+#include "rtwtypes.h"
+#include "profiler.h"
+#include "plant.h"
+
+/* =========================== Variable Definitions =========================== */
+
+extern RT_MODEL *const rtM_Left;
+extern RT_MODEL *const rtM_Right;
+
+extern P    rtP_Left;
+extern P    rtP_Right;
+extern ExtU rtU_Left;
+extern ExtU rtU_Right;
+extern ExtY rtY_Left;
+extern ExtY rtY_Right;
+
+#define SIL_DT          (1.0 / CTRL_FREQ)       // [s] controller period
+#define SIL_SUBSTEPS    8                       // [-] plant integration steps per PWM period
+#define SIL_LOOP_TICKS  ((CTRL_FREQ / 1000) * DELAY_IN_MAIN_LOOP) // control periods per main loop
+
+#define SIL_PWM_RES     (64000000 / 2 / PWM_FREQ)  // same as bldc.c at the 64 MHz clock profile (SystemCoreClock of the SIL)
+
+static const int16_t pwm_res    = SIL_PWM_RES;
+static const int16_t pwm_margin = 110;                       // same as bldc.c for FOC
+static const int32_t pwm_scale  = ((int32_t)SIL_PWM_RES << 16) / BLDC_GEN_PWM_RES;  // [Q16] same as bldc.c
+
+// Scalar controller parameters that can be overridden from the command line
+#define SIL_PARAM(name)  { #name, offsetof(P, name), sizeof(((P *)0)->name) }
+typedef struct {
+  const char *name;
+  size_t      ofs;
+  size_t      size;
+} SilParam;
+
+static const SilParam silParams[] = {
+  SIL_PARAM(dV_openRate),       SIL_PARAM(dz_cntTrnsDetHi),   SIL_PARAM(dz_cntTrnsDetLo),   SIL_PARAM(z_maxCntRst),
+  SIL_PARAM(cf_speedCoef),      SIL_PARAM(t_errDequal),       SIL_PARAM(t_errQual),         SIL_PARAM(Vd_max),
+  SIL_PARAM(a_phaAdvMax),       SIL_PARAM(i_max),             SIL_PARAM(id_fieldWeakMax),   SIL_PARAM(n_commAcvLo),
+  SIL_PARAM(n_commDeacvHi),     SIL_PARAM(n_fieldWeakAuthHi), SIL_PARAM(n_fieldWeakAuthLo), SIL_PARAM(n_max),
+  SIL_PARAM(n_stdStillDet),     SIL_PARAM(r_errInpTgtThres),  SIL_PARAM(r_fieldWeakHi),     SIL_PARAM(r_fieldWeakLo),
+  SIL_PARAM(cf_KbLimProt),      SIL_PARAM(cf_idKp),           SIL_PARAM(cf_iqKp),           SIL_PARAM(cf_nKp),
+  SIL_PARAM(cf_currFilt),       SIL_PARAM(cf_idKi),           SIL_PARAM(cf_iqKi),           SIL_PARAM(cf_iqKiLimProt),
+  SIL_PARAM(cf_nKi),            SIL_PARAM(cf_nKiLimProt),     SIL_PARAM(n_polePairs),       SIL_PARAM(z_ctrlTypSel),
+  SIL_PARAM(b_diagEna),         SIL_PARAM(b_fieldWeakEna),
+};
+
+// One motor: controller instance, plant and inverter state
+typedef struct {
+  const char  *name;
+  RT_MODEL    *rtM;
+  ExtU        *rtU;
+  ExtY        *rtY;
+  Plant        plant;
+  double       duty[3];      // [-] inverter duty cycles applied during the next period
+  SlowPart     slow;         // slow partition with -s (BLDC_controller_step_fast / _slow)
+} SilMotor;
+
+typedef struct {
+  uint8_t      ctrlMod;      // control mode request
+  int16_t      cmd;          // [-1000, 1000] step amplitude
+  double       tStep;        // [s] step instant
+  double       tEnd;         // [s] simulated time
+  uint8_t      shape;        // run the main loop command shaping (default)
+  uint8_t      slowDiv;      // 0 = single rate step, else multi-rate with the slow tasks every slowDiv Task_Scheduler periods
+  uint8_t      ripple;       // DC link ripple benchmark over the last 10% of the run
+  const char  *csvPath;
+} SilConfig;
+
+typedef struct {
+  double tRise;              // [s] 10% -> 90%
+  double overshoot;          // [%]
+  double tSettle;            // [s] last entry into the 2% band
+  double ssErr;              // [rpm] mean error over the last 10% of the run
+  double iPeak;              // [A]   peak phase current
+} SilMetrics;
+
+// DC link ripple benchmark: phase lead of the left bridge PWM, as PWM_PHASE_SHIFT
+static const int16_t silShift[] = { 0, 45, 90, 135, 180 };   // [deg]
+#define SIL_SHIFTS      ARRAY_LEN(silShift)
+
+typedef struct {
+  double sumMean[SIL_SHIFTS];  // [A]   sum of the PWM period means (battery current)
+  double sumVar[SIL_SHIFTS];   // [A^2] sum of the PWM period variances (capacitor current)
+  double peak[SIL_SHIFTS];     // [A]   peak DC link current of both bridges
+  long   n;                    // [-]   PWM periods
+} SilRipple;
+
+
+/* =========================== Helper Functions =========================== */
+
+static double sil_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+// Cost of one sil_now() call pair around BLDC_controller_step()
+static double sil_timerOverhead(void) {
+  double t0 = sil_now(), t1 = t0;
+  for (int i = 0; i < 100000; i++) {
+    t1 = sil_now();
+  }
+  return (t1 - t0) / 100000;
+}
+
+static int sil_setParam(const char *arg) {
+  const char *eq = strchr(arg, '=');
+  if (eq == NULL) {
+    return -1;
+  }
+  for (size_t i = 0; i < ARRAY_LEN(silParams); i++) {
+    const SilParam *sp = &silParams[i];
+    if (strlen(sp->name) != (size_t)(eq - arg) || strncmp(sp->name, arg, (size_t)(eq - arg)) != 0) {
+      continue;
+    }
+    long val = strtol(eq + 1, NULL, 0);
+    for (int side = 0; side < 2; side++) {
+      uint8_t *base = (uint8_t *)(side ? &rtP_Right : &rtP_Left) + sp->ofs;
+      if (sp->size == 4) {
+        int32_t  v = (int32_t)val;  memcpy(base, &v, 4);
+      } else if (sp->size == 2) {
+        uint16_t v = (uint16_t)val; memcpy(base, &v, 2);
+      } else {
+        uint8_t  v = (uint8_t)val;  memcpy(base, &v, 1);
+      }
+    }
+    return 0;
+  }
+  return -1;
+}
+
+static uint8_t sil_parseMode(const char *s) {
+  if (!strcmp(s, "open")) return OPEN_MODE;
+  if (!strcmp(s, "vlt"))  return VLT_MODE;
+  if (!strcmp(s, "spd"))  return SPD_MODE;
+  if (!strcmp(s, "trq"))  return TRQ_MODE;
+  return (uint8_t)atoi(s);
+}
+
+static void usage(const char *prog) {
+  printf("Usage: %s [options]\n"
+         "  -m <mode>        control mode: open | vlt | spd | trq (default spd)\n"
+         "  -c <cmd>         step amplitude in input units [-1000, 1000] (default 500)\n"
+         "  -t <s>           step instant (default 0.2)\n"
+         "  -T <s>           simulated time (default 2.0)\n"
+         "  -r               raw step, skip the main loop command shaping (rateLimiter16, filtLowPass32, mixerFcn)\n"
+         "  -V <volt>        battery voltage (default 36)\n"
+         "  -L <Nm>          load torque on each wheel (default 0)\n"
+         "  -J <kgm2>        wheel + load inertia (default 0.012)\n"
+         "  -H <deg>         hall sensor misalignment in electrical degrees (default 0)\n"
+         "  -p <name=value>  override a controller parameter (rtP_Left and rtP_Right, fixed-point units)\n"
+         "  -o <file>        write a CSV trace decimated to 1 kHz\n"
+         "  -s <div>         multi-rate step (BLDC_MULTIRATE): slow tasks after the PWM interrupt, every <div> scheduler periods\n"
+         "  -R               DC link ripple current of both bridges for several PWM_PHASE_SHIFT settings (last 10%% of the run)\n",
+         prog);
+}
+
+/*
+ * Feed the measurements of one motor to its controller, run the step and convert
+ * the DC outputs to duty cycles exactly like the PWM update in bldc.c.
+ * Returns the host time spent in BLDC_controller_step() or BLDC_controller_step_fast().
+ */
+static double sil_stepMotor(SilMotor *m, uint8_t ctrlMod, int16_t cmd, uint8_t ena, uint8_t slowDiv) {
+  uint8_t hall = Plant_Hall(&m->plant);
+  double  t0, t1;
+
+  m->rtU->b_motEna      = ena;
+  m->rtU->z_ctrlModReq  = ctrlMod;
+  m->rtU->r_inpTgt      = cmd;
+  m->rtU->b_hallA       = (hall >> 2) & 1;
+  m->rtU->b_hallB       = (hall >> 1) & 1;
+  m->rtU->b_hallC       = hall & 1;
+  if (m->rtM->defaultParam->z_selPhaCurMeasABC == 0) {
+    m->rtU->i_phaAB     = (int16_t)lround(m->plant.iPha[0] * A2BIT_CONV);
+    m->rtU->i_phaBC     = (int16_t)lround(m->plant.iPha[1] * A2BIT_CONV);
+  } else {
+    m->rtU->i_phaAB     = (int16_t)lround(m->plant.iPha[1] * A2BIT_CONV);
+    m->rtU->i_phaBC     = (int16_t)lround(m->plant.iPha[2] * A2BIT_CONV);
+  }
+  m->rtU->i_DCLink      = (int16_t)lround(m->plant.iDC * A2BIT_CONV);
+
+  t0 = sil_now();
+  if (slowDiv) {
+    BLDC_controller_step_fast(m->rtM, &m->slow);
+  } else {
+    BLDC_controller_step(m->rtM);
+  }
+  t1 = sil_now();
+
+  int16_t dc[3] = { m->rtY->DC_phaA, m->rtY->DC_phaB, m->rtY->DC_phaC };
+  for (int k = 0; k < 3; k++) {
+    int16_t ccr = (int16_t)CLAMP(((dc[k] * pwm_scale) >> 16) + pwm_res / 2, pwm_margin, pwm_res - pwm_margin);
+    m->duty[k]  = ena ? (double)ccr / pwm_res : 0.5;
+  }
+  return t1 - t0;
+}
+
+/*
+ * DC link current of both bridges over one PWM period, timer tick by tick: a phase draws its current from the
+ * DC link while its high side is on, i.e. while the center-aligned counter is below the compare value (PWM mode 1
+ * of TIM1/TIM8). The phase currents are held at the plant values of the period, the left bridge runs
+ * PWM_LEFT_LEAD() ahead of the right one. The battery supplies the period mean, the capacitors the rest.
+ */
+static void sil_rippleStep(SilRipple *r, const SilMotor *mot) {
+  static double iBr[2][2 * SIL_PWM_RES];
+
+  for (int i = 0; i < 2; i++) {
+    double ccr[3];
+    for (int k = 0; k < 3; k++) {
+      ccr[k] = mot[i].duty[k] * SIL_PWM_RES;
+    }
+    for (int t = 0; t < 2 * SIL_PWM_RES; t++) {
+      int cnt = (t <= SIL_PWM_RES) ? t : 2 * SIL_PWM_RES - t;
+      iBr[i][t] = 0.0;
+      for (int k = 0; k < 3; k++) {
+        iBr[i][t] += (cnt < ccr[k]) ? mot[i].plant.iPha[k] : 0.0;
+      }
+    }
+  }
+
+  for (uint32_t s = 0; s < SIL_SHIFTS; s++) {
+    int    lead = PWM_LEFT_LEAD(SIL_PWM_RES, silShift[s]);
+    double sum = 0.0, sumSq = 0.0;
+    for (int t = 0; t < 2 * SIL_PWM_RES; t++) {
+      double iDc = iBr[0][(t + lead) % (2 * SIL_PWM_RES)] + iBr[1][t];
+      sum       += iDc;
+      sumSq     += iDc * iDc;
+      r->peak[s] = MAX(r->peak[s], fabs(iDc));
+    }
+    double mean = sum / (2 * SIL_PWM_RES);
+    r->sumMean[s] += mean;
+    r->sumVar[s]  += MAX(sumSq / (2 * SIL_PWM_RES) - mean * mean, 0.0);
+  }
+  r->n++;
+}
+
+static void sil_metrics(const float *spd, long n, long iStep, double ref, double iPeak, SilMetrics *r) {
+  double dt = SIL_DT;
+  double lo = 0.1 * ref, hi = 0.9 * ref, band = fabs(0.02 * ref);
+  long   k10 = -1, k90 = -1, kSet = iStep;
+  double peak = 0.0, sum = 0.0;
+  long   nTail = n / 10;
+
+  for (long k = iStep; k < n; k++) {
+    double y = spd[k] * (ref < 0 ? -1.0 : 1.0);
+    if (k10 < 0 && y >= fabs(lo)) k10 = k;
+    if (k90 < 0 && y >= fabs(hi)) k90 = k;
+    if (y > peak) peak = y;
+    if (fabs(spd[k] - ref) > band) kSet = k + 1;
+  }
+  for (long k = n - nTail; k < n; k++) {
+    sum += ref - spd[k];
+  }
+
+  r->tRise     = (k10 >= 0 && k90 >= 0) ? (k90 - k10) * dt : NAN;
+  r->overshoot = (ref != 0.0) ? MAX(0.0, 100.0 * (peak - fabs(ref)) / fabs(ref)) : 0.0;
+  r->tSettle   = (kSet < n) ? (kSet - iStep) * dt : NAN;
+  r->ssErr     = nTail ? sum / nTail : 0.0;
+  r->iPeak     = iPeak;
+}
+
+
+/* =========================== Main =========================== */
+
+int main(int argc, char **argv) {
+  SilConfig cfg = { SPD_MODE, 500, 0.2, 2.0, 1, 0, 0, NULL };
+  SilMotor  mot[2] = {
+    { "left",  rtM_Left,  &rtU_Left,  &rtY_Left  },
+    { "right", rtM_Right, &rtU_Right, &rtY_Right },
+  };
+  double    vdc = 36.0, tLoad = 0.0, inertia = 0.012, hallOfs = 0.0;
+  int       opt;
+
+  BLDC_Init();
+  Input_Lim_Init();
+  Prof_Init();
+
+  while ((opt = getopt(argc, argv, "m:c:t:T:rV:L:J:H:p:o:s:R")) != -1) {
+    switch (opt) {
+      case 'm': cfg.ctrlMod = sil_parseMode(optarg);  break;
+      case 'c': cfg.cmd     = (int16_t)atoi(optarg);   break;
+      case 't': cfg.tStep   = atof(optarg);            break;
+      case 'T': cfg.tEnd    = atof(optarg);            break;
+      case 'r': cfg.shape   = 0;                       break;
+      case 'V': vdc         = atof(optarg);            break;
+      case 'L': tLoad       = atof(optarg);            break;
+      case 'J': inertia     = atof(optarg);            break;
+      case 'H': hallOfs     = atof(optarg);            break;
+      case 'o': cfg.csvPath = optarg;                  break;
+      case 's': cfg.slowDiv = (uint8_t)atoi(optarg);   break;
+      case 'R': cfg.ripple  = 1;                       break;
+      case 'p':
+        if (sil_setParam(optarg)) {
+          fprintf(stderr, "unknown parameter '%s'\n", optarg);
+          return 1;
+        }
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  // Multi-rate: same rescaling and hand-off setup as BLDC_Init() with BLDC_MULTIRATE
+  if (cfg.slowDiv) {
+    BLDC_SlowScale(cfg.slowDiv);
+    for (int i = 0; i < 2; i++) {
+      BLDC_controller_slow_init(mot[i].rtM, &mot[i].slow, cfg.slowDiv);
+    }
+  }
+
+  for (int i = 0; i < 2; i++) {
+    Plant_Init(&mot[i].plant);
+    mot[i].plant.Vdc      = vdc;
+    mot[i].plant.tLoad    = (i ? -tLoad : tLoad);   // right wheel is mirrored
+    mot[i].plant.J        = inertia;
+    mot[i].plant.aHallOfs += hallOfs * M_PI / 180.0;
+    mot[i].duty[0] = mot[i].duty[1] = mot[i].duty[2] = 0.5;
+  }
+
+  long    nSteps  = (long)(cfg.tEnd / SIL_DT);
+  long    iStep   = (long)(cfg.tStep / SIL_DT);
+  float  *spd     = malloc(sizeof(float) * (size_t)nSteps);
+  FILE   *csv     = cfg.csvPath ? fopen(cfg.csvPath, "w") : NULL;
+  double  tCtrl   = 0.0, iPeak = 0.0;
+  SilRipple ripple = { { 0 } };
+  long    nCtrl   = 0;
+  int16_t cmdIn   = 0, cmdL = 0, cmdR = 0;
+  int16_t speedRateFixdt = 0, steerRateFixdt = 0;
+  int32_t speedFixdt = 0, steerFixdt = 0;
+  double  tWall0  = sil_now();
+
+  if (spd == NULL) {
+    return 1;
+  }
+  if (csv) {
+    fprintf(csv, "t,cmdL,n_mot_L,rpm_L,iq_L,id_L,iA_L,iB_L,iDC_L,err_L,a_elec_L,a_plant_L,n_mot_R,rpm_R\n");
+  }
+
+  for (long k = 0; k < nSteps; k++) {
+    // Main loop: command shaping at DELAY_IN_MAIN_LOOP
+    if (k % SIL_LOOP_TICKS == 0) {
+      cmdIn = (k >= iStep) ? cfg.cmd : 0;
+      if (cfg.shape) {
+        int16_t speed, steer;
+        rateLimiter16(0, RATE, &steerRateFixdt);
+        rateLimiter16(cmdIn, RATE, &speedRateFixdt);
+        filtLowPass32(steerRateFixdt >> 4, FILTER, &steerFixdt);
+        filtLowPass32(speedRateFixdt >> 4, FILTER, &speedFixdt);
+        steer = (int16_t)(steerFixdt >> 16);
+        speed = (int16_t)(speedFixdt >> 16);
+        mixerFcn(speed << 4, steer << 4, &cmdR, &cmdL);
+      } else {
+        cmdL = cmdR = cmdIn;
+      }
+    }
+
+    // PWM ISR: both controllers, then the new duty cycles act during the next period
+    PROF_START(PROF_ISR);
+    PROF_START(PROF_CTRL);
+    PROF_START(PROF_LEFT);
+    tCtrl += sil_stepMotor(&mot[0], cfg.ctrlMod,  cmdL, 1, cfg.slowDiv);
+    PROF_STOP(PROF_LEFT);
+    PROF_START(PROF_RIGHT);
+    tCtrl += sil_stepMotor(&mot[1], cfg.ctrlMod, -cmdR, 1, cfg.slowDiv);
+    PROF_STOP(PROF_RIGHT);
+    PROF_STOP(PROF_CTRL);
+    PROF_STOP(PROF_ISR);
+    nCtrl += 2;
+
+    // PendSV: tail-chained after the interrupt, the results are committed by the next fast step
+    if (cfg.slowDiv && (mot[0].slow.z_state == SLOW_PENDING || mot[1].slow.z_state == SLOW_PENDING)) {
+      PROF_START(PROF_SLOW);
+      BLDC_controller_step_slow(mot[0].rtM, &mot[0].slow);
+      BLDC_controller_step_slow(mot[1].rtM, &mot[1].slow);
+      PROF_STOP(PROF_SLOW);
+    }
+
+    for (int i = 0; i < 2; i++) {
+      Plant_Step(&mot[i].plant, mot[i].duty, SIL_DT, SIL_SUBSTEPS);
+      for (int p = 0; p < 3; p++) {
+        iPeak = MAX(iPeak, fabs(mot[i].plant.iPha[p]));
+      }
+    }
+    if (cfg.ripple && k >= nSteps - nSteps / 10) {
+      sil_rippleStep(&ripple, mot);
+    }
+
+    spd[k] = (float)Plant_Rpm(&mot[0].plant);
+    if (csv && (k % (CTRL_FREQ / 1000)) == 0) {
+      fprintf(csv, "%.4f,%d,%d,%.2f,%d,%d,%.3f,%.3f,%.3f,%d,%d,%.1f,%d,%.2f\n", k * SIL_DT, cmdL,
+              rtY_Left.n_mot, spd[k], rtY_Left.iq, rtY_Left.id, mot[0].plant.iPha[0], mot[0].plant.iPha[1],
+              mot[0].plant.iDC, rtY_Left.z_errCode, rtY_Left.a_elecAngle,
+              mot[0].plant.aElec * 180.0 / M_PI, rtY_Right.n_mot, Plant_Rpm(&mot[1].plant));
+    }
+  }
+  double  tWall  = sil_now() - tWall0;
+
+  tCtrl = MAX(tCtrl - nCtrl * sil_timerOverhead(), 1e-9);   // remove the clock_gettime() cost
+
+  if (csv) {
+    fclose(csv);
+  }
+
+  printf("SIL: %.2f s simulated at %d Hz, mode %d, cmd %d, Vdc %.1f V, load %.2f Nm%s\n",
+         cfg.tEnd, CTRL_FREQ, cfg.ctrlMod, cfg.cmd, vdc, tLoad, cfg.shape ? "" : ", raw step");
+  if (cfg.slowDiv) {
+    printf("Multi-rate: slow tasks every %d control periods, controller time below is the fast partition only\n",
+           3 * cfg.slowDiv);
+  }
+  printf("Controller: %ld steps, %.1f ns/step, %.2f Msteps/s (host), real-time factor %.1fx\n",
+         nCtrl, 1e9 * tCtrl / nCtrl, 1e-6 * nCtrl / tCtrl, cfg.tEnd / tWall);
+  printf("Final: left n_mot %d rpm (plant %.1f rpm), right n_mot %d rpm (plant %.1f rpm), errCode L/R %d/%d\n",
+         rtY_Left.n_mot, Plant_Rpm(&mot[0].plant), rtY_Right.n_mot, Plant_Rpm(&mot[1].plant),
+         rtY_Left.z_errCode, rtY_Right.z_errCode);
+
+  if (cfg.ctrlMod == SPD_MODE) {
+    SilMetrics r;
+    double     ref = (double)cfg.cmd * (rtP_Left.n_max >> 4) / 1000.0;
+    sil_metrics(spd, nSteps, iStep, ref, iPeak, &r);
+    printf("Step response (left, target %.0f rpm): rise %.1f ms, overshoot %.1f %%, settling(2%%) %.1f ms, "
+           "steady-state error %.2f rpm, peak phase current %.1f A\n",
+           ref, 1e3 * r.tRise, r.overshoot, 1e3 * r.tSettle, r.ssErr, r.iPeak);
+  } else {
+    printf("Peak phase current %.1f A\n", iPeak);
+  }
+
+  if (ripple.n) {
+    double rms0 = sqrt(ripple.sumVar[0] / ripple.n);
+    printf("DC link ripple (both bridges, last %ld PWM periods): battery current %.2f A\n",
+           ripple.n, ripple.sumMean[0] / ripple.n);
+    for (uint32_t s = 0; s < SIL_SHIFTS; s++) {
+      double rms = sqrt(ripple.sumVar[s] / ripple.n);
+      printf("  shift %3d deg (lead %4d ticks): capacitor RMS %6.2f A (%5.1f %%), peak %6.2f A\n",
+             silShift[s], (int)PWM_LEFT_LEAD(SIL_PWM_RES, silShift[s]), rms, rms0 > 0.0 ? 100.0 * rms / rms0 : 100.0,
+             ripple.peak[s]);
+    }
+  }
+
+  // Profiler report in SystemCoreClock cycles of the host, same format as on USART3
+  for (int i = 0; i < PROF_SECTIONS; i++) {
+    Prof_PrintNext();
+  }
+
+  free(spd);
+  return 0;
+}
@@ -0,0 +1,415 @@
+/*
+* This file is part of the hoverboard-firmware-hack project.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Host side of the binary telemetry stream (Src/telemetry.c).
+ *  - Decoder:   'hover_telem < capture.bin > trace.csv' turns a raw USART3 capture
+ *               (frames interleaved with debug text) into CSV, one row per sample.
+ *  - Benchmark: 'hover_telem -b' runs the firmware encoder in a simulated PWM
+ *               interrupt against a UART model with the configured baud rate, injects
+ *               line noise and debug text, decodes the result, checks every sample and
+ *               reports link usage, losses and decode throughput.
+ * Usage: see usage() or run 'build/sil/hover_telem -?'.
+ */
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "stm32f1xx_hal.h"
+#include "defines.h"
+#include "config.h"
+#include "util.h"
+#include "logger.h"
+#include "telemetry.h"
+#include "BLDC_controller.h"
+#include "rtwtypes.h"
+
+/* =========================== Variable Definitions =========================== */
+
+extern UART_HandleTypeDef huart3;
+extern ExtY    rtY_Left;
+extern ExtY    rtY_Right;
+extern int16_t dc_curr;
+extern int16_t batVoltage;
+extern volatile uint16_t ocTripCntL;
+extern volatile uint16_t ocTripCntR;
+extern volatile uint16_t ocTripPerL;
+extern volatile uint16_t ocTripPerR;
+
+// Streaming decoder
+typedef struct {
+  uint8_t   buf[sizeof(TelemFrame)];
+  uint32_t  len;                        // [bytes] in buf
+  uint32_t  frames;                     // [-] valid frames
+  uint32_t  crcErrors;                  // [-] complete frames with a wrong CRC
+  uint32_t  seqGaps;                    // [-] frames missing according to seq
+  uint64_t  skipped;                    // [bytes] discarded while searching a start frame (text, noise)
+  uint8_t   seqNext;
+  uint8_t   synced;
+  uint32_t  tickExt;                    // [control periods] tick of the last frame, unwrapped
+  void    (*onFrame)(const TelemFrame *f, uint32_t tick, void *ctx);
+  void     *ctx;
+} TelemDecoder;
+
+// UART model for the benchmark
+typedef struct {
+  uint8_t  *pend;                       // transfer in progress
+  uint16_t  pendLen;
+  double    pos;                        // [bytes] sent of the transfer in progress
+  double    bytesPerTick;               // [bytes] per control period
+  uint8_t  *cap;                        // captured line
+  size_t    capLen, capSize;
+  uint32_t  noisePpm;                   // [ppm] per byte probability of a flipped bit and of an inserted byte
+  uint64_t  busyTicks;                  // [control periods] with the line busy
+} SilUart;
+
+static SilUart silUart;
+
+/* =========================== Decoder =========================== */
+
+static uint8_t telem_popcount(uint16_t m) {
+  uint8_t n = 0;
+  for (; m; m &= m - 1) n++;
+  return n;
+}
+
+// Drop the first n bytes of the decoder buffer
+static void telem_discard(TelemDecoder *d, uint32_t n) {
+  memmove(d->buf, d->buf + n, d->len - n);
+  d->len -= n;
+}
+
+// Expected length of the frame at the start of the buffer, 0 = header not plausible
+static uint32_t telem_frameLen(const TelemFrame *f) {
+  uint8_t nSig = telem_popcount(f->mask);
+  if (f->mask == 0 || (f->mask & ~TELEM_MASK_ALL) || f->nSamp == 0 || f->div == 0 ||
+      (uint32_t)f->nSamp * nSig > TELEM_PAYLOAD_WORDS) {
+    return 0;
+  }
+  return Telem_FrameSize(f->mask, f->nSamp);
+}
+
+static void TelemDec_Feed(TelemDecoder *d, const uint8_t *data, size_t len) {
+  while (len || d->len >= TELEM_HDR_SIZE) {
+    // top up the buffer
+    size_t n = MIN(len, sizeof(d->buf) - d->len);
+    memcpy(d->buf + d->len, data, n);
+    d->len += n; data += n; len -= n;
+
+    // hunt for the start frame (0xA55A little endian)
+    uint32_t i = 0;
+    while (i + 1 < d->len && !(d->buf[i] == (TELEM_START_FRAME & 0xFF) && d->buf[i + 1] == (TELEM_START_FRAME >> 8))) {
+      i++;
+    }
+    if (i + 1 >= d->len && !(d->len && d->buf[d->len - 1] == (TELEM_START_FRAME & 0xFF))) {
+      i = d->len;                                       // no candidate and no half start byte at the end
+    }
+    d->skipped += i;
+    telem_discard(d, i);
+    if (d->len < TELEM_HDR_SIZE) {
+      if (len == 0) return;
+      continue;
+    }
+
+    TelemFrame *f   = (TelemFrame *)d->buf;
+    uint32_t    flen = telem_frameLen(f);
+    if (flen == 0) {                                    // implausible header: resync one byte further
+      d->skipped++;
+      telem_discard(d, 1);
+      continue;
+    }
+    if (d->len < flen) {
+      if (len == 0) return;
+      continue;
+    }
+
+    uint16_t crc;
+    memcpy(&crc, d->buf + flen - 2, 2);
+    if (crc != calcCRC16(0xFFFF, d->buf, flen - 2)) {
+      d->crcErrors++;
+      d->skipped++;
+      telem_discard(d, 1);
+      continue;
+    }
+
+    if (d->synced) {
+      d->seqGaps += (uint8_t)(f->seq - d->seqNext);
+      d->tickExt += (uint16_t)(f->tick - (uint16_t)d->tickExt);
+    } else {
+      d->tickExt = f->tick;
+    }
+    d->synced  = 1;
+    d->seqNext = f->seq + 1;
+    d->frames++;
+    if (d->onFrame) {
+      d->onFrame(f, d->tickExt, d->ctx);
+    }
+    telem_discard(d, flen);
+  }
+}
+
+/* =========================== CSV output =========================== */
+
+static void telem_csvFrame(const TelemFrame *f, uint32_t tick, void *ctx) {
+  uint16_t *maskPrev = ctx;
+  uint8_t   nSig     = telem_popcount(f->mask);
+
+  if (f->mask != *maskPrev) {                           // new column set
+    *maskPrev = f->mask;
+    printf("t");
+    for (int s = 0; s < TELEM_SIGNALS; s++) {
+      if (f->mask & TELEM_SIG(s)) printf(",%s", telemSigName[s]);
+    }
+    printf("\n");
+  }
+  for (int k = 0; k < f->nSamp; k++) {
+    printf("%.5f", (double)(tick + (uint32_t)k * f->div) / CTRL_FREQ);
+    for (int i = 0; i < nSig; i++) {
+      printf(",%d", f->data[k * nSig + i]);
+    }
+    printf("\n");
+  }
+}
+
+static int telem_decodeStdin(void) {
+  static uint8_t chunk[4096];
+  uint16_t     maskPrev = 0;
+  TelemDecoder d = { .onFrame = telem_csvFrame, .ctx = &maskPrev };
+  size_t       n;
+
+  while ((n = fread(chunk, 1, sizeof(chunk), stdin)) > 0) {
+    TelemDec_Feed(&d, chunk, n);
+  }
+  fprintf(stderr, "frames:%u crcErrors:%u seqGaps:%u skippedBytes:%llu\n",
+          d.frames, d.crcErrors, d.seqGaps, (unsigned long long)d.skipped);
+  return 0;
+}
+
+/* =========================== Benchmark =========================== */
+
+// Deterministic test pattern, a function of the control period counter only
+static int16_t telem_pattern(int sig, uint32_t tick) {
+  if (sig == TELEM_ERR_L || sig == TELEM_ERR_R) {
+    return (uint8_t)(tick + sig);
+  }
+  return (int16_t)(tick * (uint32_t)(2 * sig + 1) + 1000U * sig);
+}
+
+static void telem_setSignals(uint32_t tick) {
+  rtY_Left.iq           = telem_pattern(TELEM_IQ_L,  tick);
+  rtY_Left.id           = telem_pattern(TELEM_ID_L,  tick);
+  rtY_Left.n_mot        = telem_pattern(TELEM_N_L,   tick);
+  rtY_Left.a_elecAngle  = telem_pattern(TELEM_ANG_L, tick);
+  rtY_Left.z_errCode    = (uint8_t)telem_pattern(TELEM_ERR_L, tick);
+  rtY_Right.iq          = telem_pattern(TELEM_IQ_R,  tick);
+  rtY_Right.id          = telem_pattern(TELEM_ID_R,  tick);
+  rtY_Right.n_mot       = telem_pattern(TELEM_N_R,   tick);
+  rtY_Right.a_elecAngle = telem_pattern(TELEM_ANG_R, tick);
+  rtY_Right.z_errCode   = (uint8_t)telem_pattern(TELEM_ERR_R, tick);
+  dc_curr               = telem_pattern(TELEM_DC_CURR, tick);
+  batVoltage            = telem_pattern(TELEM_BAT_V,   tick);
+  ocTripCntL            = (uint16_t)telem_pattern(TELEM_OC_L, tick);
+  ocTripCntR            = (uint16_t)telem_pattern(TELEM_OC_R, tick);
+  ocTripPerL            = (uint16_t)telem_pattern(TELEM_OCP_L, tick);
+  ocTripPerR            = (uint16_t)telem_pattern(TELEM_OCP_R, tick);
+}
+
+static HAL_StatusTypeDef sil_uartStart(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size) {
+  (void)huart;
+  if (silUart.pend != NULL) {
+    return HAL_BUSY;
+  }
+  silUart.pend    = pData;
+  silUart.pendLen = Size;
+  return HAL_OK;
+}
+
+static void sil_uartPut(uint8_t b) {
+  if (silUart.capLen + 2 > silUart.capSize) {
+    silUart.capSize = silUart.capSize ? 2 * silUart.capSize : 1 << 16;
+    silUart.cap     = realloc(silUart.cap, silUart.capSize);
+  }
+  if (silUart.noisePpm && (uint32_t)(rand() % 1000000) < silUart.noisePpm) {
+    b ^= (uint8_t)(1U << (rand() % 8));                 // bit error
+  }
+  silUart.cap[silUart.capLen++] = b;
+  if (silUart.noisePpm && (uint32_t)(rand() % 1000000) < silUart.noisePpm) {
+    silUart.cap[silUart.capLen++] = (uint8_t)rand();    // glitch byte
+  }
+}
+
+// Advance the line by one control period; the DMA memory is read as the bytes leave
+static void sil_uartTick(void) {
+  if (silUart.pend == NULL) {
+    return;
+  }
+  silUart.busyTicks++;
+  double   pos0 = silUart.pos;
+  silUart.pos  += silUart.bytesPerTick;
+  for (uint32_t i = (uint32_t)pos0; i < (uint32_t)silUart.pos && i < silUart.pendLen; i++) {
+    sil_uartPut(silUart.pend[i]);
+  }
+  if (silUart.pos >= silUart.pendLen) {
+    silUart.pos  = 0;                                   // the next transfer starts with the next period
+    silUart.pend = NULL;
+    HAL_UART_TxCpltCallback(&huart3);                   // may start the next transfer at once
+  }
+}
+
+typedef struct {
+  uint64_t samples;
+  uint64_t mismatches;
+} TelemCheck;
+
+static void telem_checkFrame(const TelemFrame *f, uint32_t tick, void *ctx) {
+  TelemCheck *c    = ctx;
+  uint8_t     nSig = telem_popcount(f->mask);
+
+  for (int k = 0; k < f->nSamp; k++) {
+    int i = 0;
+    for (int s = 0; s < TELEM_SIGNALS; s++) {
+      if (f->mask & TELEM_SIG(s)) {
+        // the signals are set before the sample of period 'tick', whose count Telem_Sample() has just incremented
+        c->mismatches += f->data[k * nSig + i++] != telem_pattern(s, tick + (uint32_t)k * f->div - 1);
+      }
+    }
+    c->samples++;
+  }
+}
+
+static double telem_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int telem_bench(double tEnd, uint16_t mask, uint16_t div, uint32_t baud, uint32_t noisePpm, int text, const char *capPath) {
+  uint32_t   ticks = (uint32_t)(tEnd * CTRL_FREQ);
+  TelemStats ts;
+  LogStats   ls;
+  TelemCheck chk = { 0 };
+  TelemDecoder d = { .onFrame = telem_checkFrame, .ctx = &chk };
+  char       line[96];
+  double     t0, tEnc = 0;
+
+  silUart.bytesPerTick = baud / 10.0 / CTRL_FREQ;       // 8N1: 10 bits per byte
+  silUart.noisePpm     = noisePpm;
+  sil_uartTxHook       = sil_uartStart;
+  srand(1);
+
+  Log_Init();
+  Telem_Init();
+  if (!Telem_Config(mask, div)) {
+    fprintf(stderr, "invalid signal mask 0x%04x\n", mask);
+    return 1;
+  }
+
+  for (uint32_t tick = 0; tick < ticks; tick++) {
+    telem_setSignals(tick);
+    t0    = telem_now();
+    Telem_Sample();
+    tEnc += telem_now() - t0;
+    sil_uartTick();
+    if (text && tick % (CTRL_FREQ / 8) == 0) {          // the 125 ms debug line of main.c
+      int n = snprintf(line, sizeof(line), "in1:%i in2:%i cmdL:%i cmdR:%i BatADC:%i BatV:%i TempADC:%i Temp:%i \r\n",
+                       0, 0, 0, 0, 1000, 3600, 1500, 25);
+      Log_Write(line, n);
+    }
+  }
+  Telem_GetStats(&ts);
+  Log_GetStats(&ls);
+
+  TelemDec_Feed(&d, silUart.cap, silUart.capLen);
+  if (capPath != NULL) {
+    FILE *fp = fopen(capPath, "wb");
+    if (fp == NULL || fwrite(silUart.cap, 1, silUart.capLen, fp) != silUart.capLen) {
+      fprintf(stderr, "cannot write %s\n", capPath);
+    }
+    if (fp != NULL) fclose(fp);
+  }
+
+  // decode throughput: repeat the captured stream for at least 0.5 s
+  TelemDecoder dt = { 0 };
+  uint64_t     bytes = 0;
+  t0 = telem_now();
+  do {
+    TelemDec_Feed(&dt, silUart.cap, silUart.capLen);
+    bytes += silUart.capLen;
+  } while (telem_now() - t0 < 0.5 && silUart.capLen);
+  double tDec = telem_now() - t0;
+
+  uint8_t nSig = telem_popcount(mask);
+  printf("stream   : %u signals every %u control periods (%.0f Hz), %u baud, %.1f s\n",
+         nSig, MAX(div, TELEM_DIV_MIN), (double)CTRL_FREQ / MAX(div, TELEM_DIV_MIN), baud, tEnd);
+  printf("link     : %zu bytes, %.1f %% busy, text %lu bytes sent, %lu dropped\n",
+         silUart.capLen, 100.0 * silUart.busyTicks / ticks, (unsigned long)ls.txBytes, (unsigned long)ls.dropBytes);
+  printf("encoder  : %lu frames, %lu samples dropped, %.0f ns per control period (host)\n",
+         (unsigned long)ts.frames, (unsigned long)ts.dropSamples, 1e9 * tEnc / ticks);
+  printf("decoder  : %u frames, %llu samples, %u CRC errors, %u lost frames, %llu bytes skipped, %llu value mismatches\n",
+         d.frames, (unsigned long long)chk.samples, d.crcErrors, d.seqGaps, (unsigned long long)d.skipped,
+         (unsigned long long)chk.mismatches);
+  printf("throughput: %.1f MB/s, %.2f Mframes/s\n", bytes / tDec / 1e6, dt.frames / tDec / 1e6);
+
+  return chk.mismatches != 0;
+}
+
+/* =========================== Main =========================== */
+
+static void usage(const char *prog) {
+  printf("Usage: %s [options] < capture.bin > trace.csv\n"
+         "       %s -b [options]\n"
+         "  -b               benchmark: simulated stream -> UART model -> decoder\n"
+         "  -m <mask>        signal mask, bit 0..15 = iqL idL nL angL errL iqR idR nR angR errR dcCurr batV ocL ocR ocPerL ocPerR (default TELEM_MASK)\n"
+         "  -d <div>         sample period in control periods (default TELEM_DIV, minimum %d)\n"
+         "  -B <baud>        USART3 baud rate (default USART3_BAUD)\n"
+         "  -e <ppm>         line noise: bit error and glitch byte probability per byte (default 0)\n"
+         "  -x               no debug text on the line\n"
+         "  -T <s>           simulated time (default 10)\n"
+         "  -o <file>        write the simulated line (raw bytes) for the decoder\n",
+         prog, prog, TELEM_DIV_MIN);
+}
+
+int main(int argc, char **argv) {
+  int      opt, bench = 0, text = 1;
+  uint16_t mask  = TELEM_MASK;
+  uint16_t div   = TELEM_DIV;
+  uint32_t baud  = USART3_BAUD;
+  uint32_t noise = 0;
+  double   tEnd  = 10.0;
+  const char *capPath = NULL;
+
+  while ((opt = getopt(argc, argv, "bm:d:B:e:xT:o:")) != -1) {
+    switch (opt) {
+      case 'b': bench = 1;                                   break;
+      case 'm': mask  = (uint16_t)strtoul(optarg, NULL, 0);  break;
+      case 'd': div   = (uint16_t)atoi(optarg);              break;
+      case 'B': baud  = (uint32_t)atoi(optarg);              break;
+      case 'e': noise = (uint32_t)atoi(optarg);              break;
+      case 'x': text  = 0;                                   break;
+      case 'T': tEnd  = atof(optarg);                        break;
+      case 'o': capPath = optarg;                            break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  return bench ? telem_bench(tEnd, mask, div, baud, noise, text, capPath) : telem_decodeStdin();
+}
@@ -64,6 +64,14 @@ defined in linker script */
 .word _sbss
 /* end address for the .bss section. defined in linker script */
 .word _ebss
+/* start addresses of the load image, start and end addresses of the .ramfunc
+and .ramdata sections. defined in linker script */
+.word _siramfunc
+.word _sramfunc
+.word _eramfunc
+.word _siramdata
+.word _sramdata
+.word _eramdata
 
 .equ  BootRAM,        0xF1E0F85F
 /**
@@ -80,6 +88,34 @@ defined in linker script */
   .type Reset_Handler, %function
 Reset_Handler:
 
+/* Copy the code executed from RAM from flash to SRAM */
+  ldr r0, =_sramfunc
+  ldr r1, =_eramfunc
+  ldr r2, =_siramfunc
+  b LoopCopyRamFunc
+
+CopyRamFunc:
+  ldr r3, [r2], #4
+  str r3, [r0], #4
+
+LoopCopyRamFunc:
+  cmp r0, r1
+  bcc CopyRamFunc
+
+/* Copy the tables read from RAM from flash to SRAM */
+  ldr r0, =_sramdata
+  ldr r1, =_eramdata
+  ldr r2, =_siramdata
+  b LoopCopyRamData
+
+CopyRamData:
+  ldr r3, [r2], #4
+  str r3, [r0], #4
+
+LoopCopyRamData:
+  cmp r0, r1
+  bcc CopyRamData
+
 /* Copy the data segment initializers from flash to SRAM */
   movs r1, #0
   b LoopCopyDataInit